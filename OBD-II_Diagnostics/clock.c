@@ -0,0 +1,68 @@
+/******************************************************************************
+ *
+ * Module: Clock
+ *
+ * File Name: clock.c
+ *
+ * Description: Source file for the PLL system clock
+ *
+ *******************************************************************************/
+
+#include "clock.h"
+#include "tm4c123gh6pm_registers.h"
+
+static uint32 clockHz = CLOCK_RESET_HZ;
+
+uint8 Clock_Init(uint32 hz)
+{
+    uint32 div, polls;
+
+    if(hz == 0 || hz > CLOCK_MAX_HZ) return CLOCK_STATUS_ERROR;
+
+    div = (CLOCK_PLL_HZ + hz / 2) / hz;
+    if(hz != CLOCK_16MHZ && (div < 5 || div > 128)) return CLOCK_STATUS_ERROR;
+
+    /* 1. Start the crystal (off after reset) and wait for it to settle */
+    SYSCTL_RCC2_REG |= SYSCTL_RCC2_USERCC2 | SYSCTL_RCC2_BYPASS2;
+    SYSCTL_RCC_REG = (SYSCTL_RCC_REG & ~(SYSCTL_RCC_XTAL_M | SYSCTL_RCC_MOSCDIS)) | SYSCTL_RCC_XTAL_16MHZ;
+    for(polls = 0; (SYSCTL_RIS_REG & SYSCTL_RIS_MOSCPUPRIS) == 0; polls++)
+    {
+        if(polls >= CLOCK_PLL_LOCK_POLLS) return CLOCK_STATUS_TIMEOUT;
+    }
+
+    /* 2. Run from the raw crystal while the PLL is reconfigured */
+    SYSCTL_RCC_REG &= ~SYSCTL_RCC_USESYSDIV;
+    SYSCTL_RCC2_REG &= ~SYSCTL_RCC2_OSCSRC2_M;
+    clockHz = CLOCK_XTAL_HZ;
+
+    if(hz == CLOCK_16MHZ)
+    {
+        SYSCTL_RCC2_REG |= SYSCTL_RCC2_PWRDN2;
+        return CLOCK_STATUS_OK;
+    }
+
+    /* 3. Power the PLL up and select 400 MHz / div */
+    SYSCTL_RCC2_REG &= ~SYSCTL_RCC2_PWRDN2;
+    SYSCTL_RCC2_REG |= SYSCTL_RCC2_DIV400;
+    SYSCTL_RCC2_REG = (SYSCTL_RCC2_REG & ~SYSCTL_RCC2_SYSDIV2_M) |
+                      ((div - 1) << SYSCTL_RCC2_SYSDIV2_S);
+    SYSCTL_RCC_REG |= SYSCTL_RCC_USESYSDIV;
+
+    /* 4. Switch over once locked */
+    for(polls = 0; (SYSCTL_PLLSTAT_REG & SYSCTL_PLLSTAT_LOCK) == 0; polls++)
+    {
+        if(polls >= CLOCK_PLL_LOCK_POLLS)
+        {
+            SYSCTL_RCC_REG &= ~SYSCTL_RCC_USESYSDIV;
+            return CLOCK_STATUS_TIMEOUT;
+        }
+    }
+    SYSCTL_RCC2_REG &= ~SYSCTL_RCC2_BYPASS2;
+    clockHz = CLOCK_PLL_HZ / div;
+    return CLOCK_STATUS_OK;
+}
+
+uint32 Clock_GetHz(void)
+{
+    return clockHz;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ *
+ * Module: Clock
+ *
+ * File Name: clock.h
+ *
+ * Description: Header file for the system clock. Clock_Init runs the core
+ * from the PLL (400 MHz / SYSDIV, 16 MHz LaunchPad crystal) and Clock_GetHz
+ * reports the result, so drivers compute their dividers at init instead of
+ * assuming 16 MHz. Call it first in main: Time_Init, I2C1_Init, UART0_Init
+ * and the sniffer timer read the frequency once, when they start.
+ *
+ *******************************************************************************/
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define CLOCK_XTAL_HZ               16000000
+#define CLOCK_PLL_HZ                400000000
+#define CLOCK_MAX_HZ                80000000
+#define CLOCK_RESET_HZ              16000000    /* PIOSC, before Clock_Init */
+
+/* Frequencies with a whole number of cycles per us (exact time base) */
+#define CLOCK_80MHZ                 80000000
+#define CLOCK_50MHZ                 50000000
+#define CLOCK_40MHZ                 40000000
+#define CLOCK_16MHZ                 16000000    /* Crystal, PLL off */
+
+/* RCC / RCC2 Fields */
+#define SYSCTL_RCC_MOSCDIS          0x00000001
+#define SYSCTL_RCC_XTAL_M           0x000007C0
+#define SYSCTL_RCC_XTAL_16MHZ       0x00000540
+#define SYSCTL_RCC_USESYSDIV        0x00400000
+#define SYSCTL_RCC2_USERCC2         0x80000000
+#define SYSCTL_RCC2_DIV400          0x40000000
+#define SYSCTL_RCC2_SYSDIV2_M       0x1FC00000  /* With DIV400: SYSDIV2:SYSDIV2LSB */
+#define SYSCTL_RCC2_SYSDIV2_S       22
+#define SYSCTL_RCC2_PWRDN2          0x00002000
+#define SYSCTL_RCC2_BYPASS2         0x00000800
+#define SYSCTL_RCC2_OSCSRC2_M       0x00000070  /* 0 = main oscillator */
+#define SYSCTL_PLLSTAT_LOCK         0x00000001
+#define SYSCTL_RIS_MOSCPUPRIS       0x00000100
+
+/* No time base yet while the clock starts: bounded poll counts instead */
+#define CLOCK_PLL_LOCK_POLLS        100000
+
+/* Status Codes */
+#define CLOCK_STATUS_OK             0
+#define CLOCK_STATUS_ERROR          1       /* Frequency out of range */
+#define CLOCK_STATUS_TIMEOUT        2       /* PLL did not lock: left on the crystal */
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Run the core at hz: CLOCK_16MHZ uses the crystal directly, anything else
+ * the PLL with the nearest divisor (400 MHz / n, n = 5..128) */
+uint8 Clock_Init(uint32 hz);
+
+/* Actual core clock in Hz */
+uint32 Clock_GetHz(void);
+
+#endif /* CLOCK_H_ */
@@ -0,0 +1,209 @@
+/******************************************************************************
+ *
+ * Module: Codec
+ *
+ * File Name: codec.c
+ *
+ * Description: Source file for the per-signal sample compression
+ * Deltas and values are zigzag coded (small magnitudes of either sign stay
+ * small) and written as LEB128 varints, 7 bits a byte.
+ *
+ *******************************************************************************/
+
+#include "codec.h"
+
+/* 32-bit arithmetic whatever the width of long: the masks cost nothing on
+ * the target and keep the host tools (64-bit long) decoding the same */
+#define CODEC_U32(x)        ((uint32)(x) & 0xFFFFFFFFu)
+#define CODEC_S32(u)        ((((u) & 0x80000000u) != 0u) ? -(sint32)(0xFFFFFFFFu - CODEC_U32(u)) - 1 \
+                                                         : (sint32)CODEC_U32(u))
+#define CODEC_ZIGZAG(u)     CODEC_U32(((u) << 1) ^ (0u - ((u) >> 31)))
+#define CODEC_UNZIGZAG(z)   CODEC_U32(((z) >> 1) ^ (0u - ((z) & 1u)))
+
+/* |t - expected| <= tolerance, with wrap-around */
+#define CODEC_ON_TIME(t, expected) \
+    ((uint32)((t) - (expected) + CODEC_TIME_TOLERANCE_MS) <= 2u * CODEC_TIME_TOLERANCE_MS)
+
+static uint8 Codec_PutVarint(uint8 *p, uint32 v)
+{
+    uint8 n = 0;
+
+    while(v >= 0x80u)
+    {
+        p[n++] = (uint8)(v | 0x80u);
+        v >>= 7;
+    }
+    p[n++] = (uint8)v;
+    return n;
+}
+
+/* FALSE for a varint that runs past 'avail' or longer than 5 bytes */
+static boolean Codec_GetVarint(const uint8 *in, uint16 avail, uint16 *pos, uint32 *v)
+{
+    uint32 result = 0;
+    uint8 shift, b;
+
+    for(shift = 0; shift < 35u; shift += 7u)
+    {
+        if(*pos >= avail) return FALSE;
+        b = in[(*pos)++];
+        result |= (uint32)(b & 0x7Fu) << shift;
+        if((b & 0x80u) == 0u)
+        {
+            *v = result;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void Codec_Reset(Codec_Channel *ch)
+{
+    ch->last = 0;
+    ch->timeMs = 0;
+    ch->periodMs = 0;
+    ch->run = 0;
+    ch->sinceKey = 0;
+    ch->synced = FALSE;
+}
+
+uint8 Codec_Encode(Codec_Channel *ch, sint32 value, uint32 timeMs, uint32 baseMs, uint8 *out)
+{
+    uint32 next = ch->timeMs + ch->periodMs;
+    uint32 delta = CODEC_U32((uint32)value - (uint32)ch->last);    /* Modulo 2^32 */
+    uint32 zz = CODEC_ZIGZAG(delta);
+    uint32 dt;
+    boolean keyDue = (!ch->synced || ch->sinceKey >= CODEC_KEY_INTERVAL) ? TRUE : FALSE;
+    boolean onTime = (ch->periodMs != 0u && CODEC_ON_TIME(timeMs, next)) ? TRUE : FALSE;
+    uint8 n = 0;
+
+    if(onTime && !keyDue && delta == 0u && ch->run < CODEC_RUN_MAX)
+    {
+        ch->run++;
+        ch->sinceKey++;
+        ch->timeMs = next;
+        return 0;
+    }
+
+    if(ch->run > 0u)
+    {
+        out[n++] = (uint8)(CODEC_TAG_RUN | (ch->run - 1u));
+        ch->run = 0;
+    }
+
+    if(keyDue)
+    {
+        if((sint32)(timeMs - baseMs) < 0) timeMs = baseMs;
+        out[n++] = CODEC_TAG_KEY;
+        n += Codec_PutVarint(&out[n], timeMs - baseMs);
+        n += Codec_PutVarint(&out[n], ch->periodMs);
+        n += Codec_PutVarint(&out[n], CODEC_ZIGZAG(CODEC_U32(value)));
+        ch->timeMs = timeMs;
+        ch->sinceKey = 0;
+        ch->synced = TRUE;
+    }
+    else if(onTime)
+    {
+        if(zz < 0x80u)
+        {
+            out[n++] = (uint8)zz;
+        }
+        else
+        {
+            out[n++] = (uint8)(CODEC_TAG_DELTA | (zz & 0x1Fu));
+            n += Codec_PutVarint(&out[n], zz >> 5);
+        }
+        ch->timeMs = next;
+    }
+    else
+    {
+        /* Up to the tolerance early: clamp rather than go back in time */
+        if((sint32)(timeMs - ch->timeMs) < 0) timeMs = ch->timeMs;
+        dt = timeMs - ch->timeMs;
+        out[n++] = CODEC_TAG_TIMED;
+        n += Codec_PutVarint(&out[n], dt);
+        n += Codec_PutVarint(&out[n], zz);
+        ch->periodMs = (dt > 0xFFFFu) ? 0u : (uint16)dt;
+        ch->timeMs = timeMs;
+    }
+
+    ch->last = value;
+    ch->sinceKey++;
+    return n;
+}
+
+uint8 Codec_Flush(Codec_Channel *ch, uint8 *out)
+{
+    uint8 n = 0;
+
+    if(ch->run == 0u) return 0;
+
+    /* The last repeat goes out as a zero delta, the others as its prefix;
+     * their times were already advanced when they joined the run */
+    if(ch->run > 1u) out[n++] = (uint8)(CODEC_TAG_RUN | (ch->run - 2u));
+    out[n++] = 0u;
+    ch->run = 0;
+    return n;
+}
+
+uint8 Codec_Decode(Codec_Channel *ch, const uint8 *in, uint16 avail, uint32 baseMs, Codec_Group *group)
+{
+    uint16 pos = 0;
+    uint32 zz = 0, dt, period;
+    boolean wasSynced = ch->synced;
+    uint8 tag;
+
+    if(avail == 0u) return 0;
+    tag = in[pos++];
+
+    group->run = 0;
+    if((tag & 0xC0u) == CODEC_TAG_RUN)
+    {
+        group->run = (uint8)((tag & 0x3Fu) + 1u);
+        group->runValue = ch->last;
+        group->periodMs = ch->periodMs;
+        group->runStartMs = ch->timeMs + ch->periodMs;
+        ch->timeMs += (uint32)group->run * ch->periodMs;
+
+        if(pos >= avail) return 0;
+        tag = in[pos++];
+        if((tag & 0xC0u) == CODEC_TAG_RUN) return 0;
+    }
+
+    if((tag & 0x80u) == 0u)
+    {
+        zz = tag;
+        ch->timeMs += ch->periodMs;
+    }
+    else if((tag & 0xE0u) == CODEC_TAG_DELTA)
+    {
+        if(!Codec_GetVarint(in, avail, &pos, &zz)) return 0;
+        zz = (zz << 5) | (tag & 0x1Fu);
+        ch->timeMs += ch->periodMs;
+    }
+    else if(tag == CODEC_TAG_TIMED)
+    {
+        if(!Codec_GetVarint(in, avail, &pos, &dt) || !Codec_GetVarint(in, avail, &pos, &zz)) return 0;
+        ch->periodMs = (dt > 0xFFFFu) ? 0u : (uint16)dt;
+        ch->timeMs += dt;
+    }
+    else if(tag == CODEC_TAG_KEY)
+    {
+        if(!Codec_GetVarint(in, avail, &pos, &dt) || !Codec_GetVarint(in, avail, &pos, &period) ||
+           !Codec_GetVarint(in, avail, &pos, &zz)) return 0;
+        ch->timeMs = baseMs + dt;
+        ch->periodMs = (uint16)period;
+        ch->last = 0;
+        ch->synced = TRUE;
+    }
+    else
+    {
+        return 0;
+    }
+
+    ch->last = CODEC_S32(CODEC_U32((uint32)ch->last + CODEC_UNZIGZAG(zz)));
+    if(!wasSynced) group->run = 0;     /* Repeats of a value never seen */
+    group->timeMs = ch->timeMs;
+    group->value = ch->last;
+    return (uint8)pos;
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ * Module: Codec
+ *
+ * File Name: codec.h
+ *
+ * Description: Header file for the per-signal sample compression used by
+ * the flash log (log.c) and the UART stream (stream.c), and by the host
+ * decoders in Tools/. A signal polled at a steady rate mostly repeats its
+ * value or changes it a little, at the same interval each time:
+ *
+ *   0ddddddd                 delta < 128 (zigzag), one period after the last
+ *   110ddddd varint          larger delta: low 5 bits here, the rest after
+ *   11100000 varint varint   dt, delta: off-period sample, dt is the new period
+ *   11110000 varint x3       key frame: ms from the container's base time,
+ *                            period, value (zigzag), so a decoder can start here
+ *   10cccccc                 c+1 more samples of the same value, one period
+ *                            apart, followed by one of the tokens above
+ *
+ * Repeats are held back and sent as the RUN prefix of the next token, so a
+ * steady coolant temperature costs 2 bytes per 65 samples. Sample times
+ * within CODEC_TIME_TOLERANCE_MS of the period are stored as on time: the
+ * decoded time can differ by that much, but never drifts. Values are exact.
+ *
+ *******************************************************************************/
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define CODEC_KEY_INTERVAL          100u    /* Samples between key frames */
+#define CODEC_RUN_MAX               64u
+#define CODEC_TIME_TOLERANCE_MS     4u
+#define CODEC_GROUP_MAX             17u     /* RUN + KEY with three 5-byte varints */
+#define CODEC_FLUSH_MAX             2u      /* RUN + 1-byte delta */
+
+/* Tokens */
+#define CODEC_TAG_RUN               0x80u
+#define CODEC_TAG_DELTA             0xC0u
+#define CODEC_TAG_TIMED             0xE0u
+#define CODEC_TAG_KEY               0xF0u
+
+/*******************************************************************************
+ * Types                                   *
+ *******************************************************************************/
+
+/* One signal's state, kept alike on both ends */
+typedef struct {
+    sint32 last;
+    uint32 timeMs;          /* Time of the last sample as decoded */
+    uint16 periodMs;        /* 0: the next sample needs an explicit time */
+    uint8 run;              /* Encoder: repeats not sent yet */
+    uint8 sinceKey;
+    boolean synced;         /* Encoder: FALSE sends a key; decoder: waiting for one */
+} Codec_Channel;
+
+/* One decoded token: 'run' repeats of runValue, the first at runStartMs and
+ * then every periodMs, followed by the sample value at timeMs */
+typedef struct {
+    uint32 runStartMs;
+    sint32 runValue;
+    uint16 periodMs;
+    uint8 run;
+    uint32 timeMs;
+    sint32 value;
+} Codec_Group;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Forget the signal: the encoder's next sample is a key frame, the
+ * decoder skips everything until one */
+void Codec_Reset(Codec_Channel *ch);
+
+/* Encode one sample; returns the bytes written to out (up to
+ * CODEC_GROUP_MAX), 0 if the sample was added to a run. The key frame
+ * offset is timeMs - baseMs, so baseMs must not be later than timeMs */
+uint8 Codec_Encode(Codec_Channel *ch, sint32 value, uint32 timeMs, uint32 baseMs, uint8 *out);
+
+/* Write out a pending run (0 bytes if none) */
+uint8 Codec_Flush(Codec_Channel *ch, uint8 *out);
+
+/* Decode one token from in[0..avail-1]; returns the bytes used, 0 if the
+ * token is malformed or cut short. Nothing is valid to output while
+ * ch->synced is FALSE after the call */
+uint8 Codec_Decode(Codec_Channel *ch, const uint8 *in, uint16 avail, uint32 baseMs, Codec_Group *group);
+
+#endif /* CODEC_H_ */
@@ -0,0 +1,28 @@
+/******************************************************************************
+ *
+ * Module: CRC16
+ *
+ * File Name: crc16.c
+ *
+ * Description: CRC-16/CCITT-FALSE using a 16-entry table (32 bytes of flash,
+ * two lookups per byte)
+ *
+ *******************************************************************************/
+
+#include "crc16.h"
+
+static const uint16 crc16Nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16 CRC16_Update(uint16 crc, const uint8 *data, uint16 length)
+{
+    while(length--)
+    {
+        crc = (uint16)((crc << 4) ^ crc16Nibble[((crc >> 12) ^ (*data >> 4)) & 0x0F]);
+        crc = (uint16)((crc << 4) ^ crc16Nibble[((crc >> 12) ^ (*data & 0x0F)) & 0x0F]);
+        data++;
+    }
+    return crc;
+}
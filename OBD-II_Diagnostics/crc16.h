@@ -0,0 +1,20 @@
+/******************************************************************************
+ *
+ * Module: CRC16
+ *
+ * File Name: crc16.h
+ *
+ * Description: CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), nibble table
+ *
+ *******************************************************************************/
+
+#ifndef CRC16_H_
+#define CRC16_H_
+
+#include "std_types.h"
+
+#define CRC16_INIT      0xFFFF
+
+uint16 CRC16_Update(uint16 crc, const uint8 *data, uint16 length);
+
+#endif /* CRC16_H_ */
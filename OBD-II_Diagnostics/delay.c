@@ -6,10 +6,15 @@
  */
 
 #include "delay.h"
+#include "timebase.h"
 
 void Delay_MS(unsigned long long n)
 {
-    volatile unsigned long long count = 0;
-    while (count++ < (NUMBER_OF_ITERATIONS_PER_ONE_MILI_SECOND * n));
-}
+    uint32 start = Time_NowMs();
 
+    /* The first tick is partial, so wait for n full ticks after it */
+    while((uint32)(Time_NowMs() - start) <= (uint32)n)
+    {
+        Time_Sleep();
+    }
+}
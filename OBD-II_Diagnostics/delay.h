@@ -8,8 +8,7 @@
 #ifndef DELAY_H_
 #define DELAY_H_
 
-#define NUMBER_OF_ITERATIONS_PER_ONE_MILI_SECOND 364
-
+/* Sleeps (WFI) for at least n ms on the SysTick time base; Time_Init first */
 void Delay_MS(unsigned long long n);
 
 #endif /* DELAY_H_ */
@@ -0,0 +1,117 @@
+/******************************************************************************
+ *
+ * Module: Fmt
+ *
+ * File Name: fmt.c
+ *
+ * Description: Source file for integer and fixed-point text formatting
+ *
+ *******************************************************************************/
+
+#include "fmt.h"
+
+static const char fmtPairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* n / 100 for every 32-bit n: 0x51EB851F = ceil(2^37 / 100), one UMULL */
+#define FMT_DIV100(n)   ((uint32)(((uint64)(n) * 0x51EB851FUL) >> 37))
+
+/* Digits of value ending just before 'end', at least minDigits of them
+ * (leading zeros); returns the count */
+static uint8 Fmt_Digits(char *end, uint32 value, uint8 minDigits)
+{
+    char *p = end;
+    const char *pair;
+    uint32 q;
+
+    while(value >= 100)
+    {
+        q = FMT_DIV100(value);
+        pair = &fmtPairs[(value - q * 100) * 2];
+        *--p = pair[1];
+        *--p = pair[0];
+        value = q;
+    }
+    if(value >= 10)
+    {
+        pair = &fmtPairs[value * 2];
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    else
+    {
+        *--p = (char)('0' + value);
+    }
+    while((uint8)(end - p) < minDigits) *--p = '0';
+
+    return (uint8)(end - p);
+}
+
+static uint8 Fmt_Put(char *buf, boolean negative, uint32 magnitude, uint8 decimals, uint8 width, uint8 flags)
+{
+    char digits[10];
+    const char *src;
+    char *p = buf;
+    uint8 count, len, pad, i;
+
+    if(decimals > FMT_MAX_DECIMALS) decimals = FMT_MAX_DECIMALS;
+
+    count = Fmt_Digits(digits + sizeof(digits), magnitude, decimals + 1);
+    src = digits + sizeof(digits) - count;
+    len = count + (decimals > 0 ? 1 : 0) + (negative ? 1 : 0);
+
+    if(width == 0) width = len;
+    if(len > width)
+    {
+        for(i = 0; i < width; i++) *p++ = FMT_OVERFLOW_CHAR;
+        *p = '\0';
+        return width;
+    }
+    pad = width - len;
+
+    if((flags & (FMT_LEFT | FMT_ZERO_PAD)) == 0)
+    {
+        for(i = 0; i < pad; i++) *p++ = ' ';
+    }
+    if(negative) *p++ = '-';
+    if((flags & (FMT_LEFT | FMT_ZERO_PAD)) == FMT_ZERO_PAD)
+    {
+        for(i = 0; i < pad; i++) *p++ = '0';
+    }
+
+    for(i = decimals; i < count; i++) *p++ = *src++;
+    if(decimals > 0)
+    {
+        *p++ = '.';
+        for(i = 0; i < decimals; i++) *p++ = *src++;
+    }
+
+    if(flags & FMT_LEFT)
+    {
+        for(i = 0; i < pad; i++) *p++ = ' ';
+    }
+    *p = '\0';
+
+    return width;
+}
+
+uint8 Fmt_Fixed(char *buf, sint32 value, uint8 decimals, uint8 width, uint8 flags)
+{
+    /* 0 - value in unsigned arithmetic also covers the most negative value */
+    if(value < 0) return Fmt_Put(buf, TRUE, 0u - (uint32)value, decimals, width, flags);
+    return Fmt_Put(buf, FALSE, (uint32)value, decimals, width, flags);
+}
+
+uint8 Fmt_UInt(char *buf, uint32 value, uint8 width, uint8 flags)
+{
+    return Fmt_Put(buf, FALSE, value, 0, width, flags);
+}
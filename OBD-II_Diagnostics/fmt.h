@@ -0,0 +1,51 @@
+/******************************************************************************
+ *
+ * Module: Fmt
+ *
+ * File Name: fmt.h
+ *
+ * Description: Header file for integer and fixed-point text formatting.
+ * Numbers are written into a caller buffer, right-aligned (or left) in a
+ * fixed width with blank or zero fill, so a value always occupies the same
+ * cells and overwrites the previous one without padding strings. Digits
+ * come out two at a time from a "00".."99" table, and the divide by 100
+ * is a reciprocal multiply: no division or modulo on the way.
+ *
+ *******************************************************************************/
+
+#ifndef FMT_H_
+#define FMT_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* Flags */
+#define FMT_ZERO_PAD            0x01    /* Fill with '0' after the sign */
+#define FMT_LEFT                0x02    /* Left-aligned, blanks on the right */
+
+#define FMT_MAX_DECIMALS        9
+#define FMT_OVERFLOW_CHAR       '-'     /* Fills a field the value does not fit */
+
+/* Longest natural output, "-0.000000001" / "-2147483648", plus the NUL */
+#define FMT_BUFFER_SIZE         13
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Write value / 10^decimals with exactly 'decimals' digits after the point
+ * (value 1234, decimals 1 -> "123.4"). Exactly 'width' characters plus a
+ * NUL, or the natural length when width is 0; a value wider than 'width'
+ * fills it with FMT_OVERFLOW_CHAR. buf holds at least width + 1 and
+ * FMT_BUFFER_SIZE characters. Returns the length written */
+uint8 Fmt_Fixed(char *buf, sint32 value, uint8 decimals, uint8 width, uint8 flags);
+
+#define Fmt_Int(buf, value, width, flags)   Fmt_Fixed((buf), (value), 0, (width), (flags))
+
+/* Unsigned, the full 32-bit range */
+uint8 Fmt_UInt(char *buf, uint32 value, uint8 width, uint8 flags);
+
+#endif /* FMT_H_ */
@@ -0,0 +1,65 @@
+/******************************************************************************
+ *
+ * Module: Gauge
+ *
+ * File Name: gauge.c
+ *
+ * Description: Source file for LCD bar graphs built from CGRAM glyphs
+ *
+ *******************************************************************************/
+
+#include "gauge.h"
+#include "lcd.h"
+
+/* Glyph n fills the n + 1 leftmost of the 5 pixel columns, all 8 rows */
+static const uint8 gaugeGlyphs[GAUGE_LEVELS] = { 0x10, 0x18, 0x1C, 0x1E, 0x1F };
+
+#define GAUGE_CHAR(level)   LCD_GLYPH(GAUGE_FIRST_SLOT + (level) - 1)
+
+void Gauge_LoadGlyphs(void)
+{
+    uint8 rows[8];
+    uint8 level, i;
+
+    for(level = 0; level < GAUGE_LEVELS; level++)
+    {
+        for(i = 0; i < 8; i++) rows[i] = gaugeGlyphs[level];
+        LCD_LoadGlyph(GAUGE_FIRST_SLOT + level, rows);
+    }
+}
+
+void Gauge_DrawBar(uint8 row, uint8 col, uint8 width, sint32 value, sint32 min, sint32 max)
+{
+    uint32 span, units;
+    uint8 i;
+
+    if(value < min) value = min;
+    if(value > max) value = max;
+
+    /* Fill in pixel columns, rounded to the nearest */
+    span = (uint32)(max - min);
+    units = 0;
+    if(span > 0)
+    {
+        units = ((uint32)(value - min) * width * GAUGE_LEVELS + span / 2) / span;
+    }
+
+    LCD_FbSetCursor(row, col);
+    for(i = 0; i < width; i++)
+    {
+        if(units >= GAUGE_LEVELS)
+        {
+            LCD_FbPutChar(GAUGE_CHAR(GAUGE_LEVELS));
+            units -= GAUGE_LEVELS;
+        }
+        else if(units > 0)
+        {
+            LCD_FbPutChar(GAUGE_CHAR(units));
+            units = 0;
+        }
+        else
+        {
+            LCD_FbPutChar(' ');
+        }
+    }
+}
@@ -0,0 +1,38 @@
+/******************************************************************************
+ *
+ * Module: Gauge
+ *
+ * File Name: gauge.h
+ *
+ * Description: Header file for LCD bar graphs built from CGRAM glyphs.
+ * Each cell shows 0..5 filled pixel columns, so a bar of n cells has
+ * 5n + 1 levels. Bars are drawn into the LCD framebuffer: LCD_FbFlush
+ * then rewrites only the cells whose fill level changed.
+ *
+ *******************************************************************************/
+
+#ifndef GAUGE_H_
+#define GAUGE_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define GAUGE_LEVELS            5       /* Pixel columns per cell */
+#define GAUGE_FIRST_SLOT        0       /* CGRAM slots 0..4; 5..7 stay free */
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Load the partial-block glyphs into CGRAM. Once per screen that shows a
+ * bar, not per refresh; the glyphs persist until the LCD loses power */
+void Gauge_LoadGlyphs(void);
+
+/* Bar of 'width' cells at row/col, filled in proportion to value within
+ * min..max (clamped) */
+void Gauge_DrawBar(uint8 row, uint8 col, uint8 width, sint32 value, sint32 min, sint32 max);
+
+#endif /* GAUGE_H_ */
@@ -1,93 +1,78 @@
 #include "gpio.h"
 #include "tm4c123gh6pm_registers.h"
 
-/* Get the correct GPIO data register for a specific pin */
-static volatile uint32* getDataReg(GPIO_Port port) {
-    switch(port) {
-        case GPIO_PORTA: return &GPIO_PORTA_DATA_REG;
-        case GPIO_PORTB: return &GPIO_PORTB_DATA_REG;
-        case GPIO_PORTC: return &GPIO_PORTC_DATA_REG;
-        case GPIO_PORTD: return &GPIO_PORTD_DATA_REG;
-        case GPIO_PORTE: return &GPIO_PORTE_DATA_REG;
-        case GPIO_PORTF: return &GPIO_PORTF_DATA_REG;
-        default: return &GPIO_PORTA_DATA_REG;
-    }
-}
+/* Pins behind GPIOLOCK (PC3:0 are JTAG and deliberately left locked) */
+static const uint8 gpioLockedPins[] = { 0x00u, 0x00u, 0x00u, 0x80u, 0x00u, 0x01u };
+
+/* PCTL fields (4 bits per pin) of the pins in a mask */
+static uint32 pctlMask(uint8 pins) {
+    uint32 mask = 0u;
+    uint8 n;
 
-/* Get the correct GPIO direction register for a port */
-static volatile uint32* getDirReg(GPIO_Port port) {
-    switch(port) {
-        case GPIO_PORTA: return &GPIO_PORTA_DIR_REG;
-        case GPIO_PORTB: return &GPIO_PORTB_DIR_REG;
-        case GPIO_PORTC: return &GPIO_PORTC_DIR_REG;
-        case GPIO_PORTD: return &GPIO_PORTD_DIR_REG;
-        case GPIO_PORTE: return &GPIO_PORTE_DIR_REG;
-        case GPIO_PORTF: return &GPIO_PORTF_DIR_REG;
-        default: return &GPIO_PORTA_DIR_REG;
+    for(n = 0u; n < 8u; n++) {
+        if(pins & (1u << n)) mask |= GPIO_PCTL(n, 0xFu);
     }
+    return mask;
 }
 
-/* Get the correct GPIO DEN register for a port */
-static volatile uint32* getDenReg(GPIO_Port port) {
-    switch(port) {
-        case GPIO_PORTA: return &GPIO_PORTA_DEN_REG;
-        case GPIO_PORTB: return &GPIO_PORTB_DEN_REG;
-        case GPIO_PORTC: return &GPIO_PORTC_DEN_REG;
-        case GPIO_PORTD: return &GPIO_PORTD_DEN_REG;
-        case GPIO_PORTE: return &GPIO_PORTE_DEN_REG;
-        case GPIO_PORTF: return &GPIO_PORTF_DEN_REG;
-        default: return &GPIO_PORTA_DEN_REG;
+void GPIO_Configure(const GPIO_PortConfig *configs, uint8 count) {
+    const GPIO_PortConfig *c;
+    uint32 clocks = 0u;
+    uint32 base, mask;
+    uint8 pins, i;
+
+    /* 1. All port clocks in one write, one wait for those not yet ready */
+    for(i = 0u; i < count; i++) clocks |= (1u << configs[i].port);
+    clocks &= ~SYSCTL_PRGPIO_REG;
+    if(clocks != 0u) {
+        SYSCTL_RCGCGPIO_REG |= clocks;
+        while((SYSCTL_PRGPIO_REG & clocks) != clocks);
     }
-}
 
-/* Get the correct GPIO PUR register for a port */
-static volatile uint32* getPurReg(GPIO_Port port) {
-    switch(port) {
-        case GPIO_PORTA: return &GPIO_PORTA_PUR_REG;
-        case GPIO_PORTB: return &GPIO_PORTB_PUR_REG;
-        case GPIO_PORTC: return &GPIO_PORTC_PUR_REG;
-        case GPIO_PORTD: return &GPIO_PORTD_PUR_REG;
-        case GPIO_PORTE: return &GPIO_PORTE_PUR_REG;
-        case GPIO_PORTF: return &GPIO_PORTF_PUR_REG;
-        default: return &GPIO_PORTA_PUR_REG;
+    /* 2. Each register once per port */
+    for(i = 0u; i < count; i++) {
+        c = &configs[i];
+        base = gpioPortBase[c->port];
+        pins = c->outputs | c->inputs | c->alternate;
+
+        if(pins & gpioLockedPins[c->port]) {
+            GPIO_REG(base, GPIO_LOCK_OFFSET) = GPIO_LOCK_KEY;
+            GPIO_REG(base, GPIO_CR_OFFSET) |= pins;
+        }
+
+        GPIO_DATA_MASKED(base, c->outputs) = c->initHigh;
+        GPIO_REG(base, GPIO_DIR_OFFSET) = (GPIO_REG(base, GPIO_DIR_OFFSET) & ~(uint32)c->inputs) | c->outputs;
+        GPIO_REG(base, GPIO_AFSEL_OFFSET) = (GPIO_REG(base, GPIO_AFSEL_OFFSET) & ~(uint32)pins) | c->alternate;
+        mask = pctlMask(pins);
+        GPIO_REG(base, GPIO_PCTL_OFFSET) = (GPIO_REG(base, GPIO_PCTL_OFFSET) & ~mask) |
+                                           (c->pctl & pctlMask(c->alternate));
+        GPIO_REG(base, GPIO_ODR_OFFSET) = (GPIO_REG(base, GPIO_ODR_OFFSET) & ~(uint32)pins) | c->openDrain;
+        GPIO_REG(base, GPIO_PUR_OFFSET) = (GPIO_REG(base, GPIO_PUR_OFFSET) & ~(uint32)pins) | c->pullUps;
+        GPIO_REG(base, GPIO_AMSEL_OFFSET) &= ~(uint32)pins;
+        GPIO_REG(base, GPIO_DEN_OFFSET) |= pins;
+
+        if(pins & gpioLockedPins[c->port]) GPIO_REG(base, GPIO_LOCK_OFFSET) = 0u;
     }
 }
 
 void GPIO_InitPin(GPIO_Port port, uint8 pin, uint8 direction) {
-    /* Enable clock for the GPIO port */
-    SYSCTL_RCGCGPIO_REG |= (1u << port);
-    
-    /* Wait for clock to be ready */
-    while((SYSCTL_PRGPIO_REG & (1u << port)) == 0u);
-    
-    volatile uint32* dirReg = getDirReg(port);
-    volatile uint32* denReg = getDenReg(port);
-    
-    /* Configure direction */
+    GPIO_PortConfig config = { GPIO_PORTA, 0u, 0u, 0u, 0u, 0u, 0u, 0u };
+
+    config.port = port;
     if(direction == GPIO_OUTPUT) {
-        *dirReg |= pin;
+        config.outputs = pin;
     } else {
-        *dirReg &= ~pin;
+        config.inputs = pin;
     }
-    
-    /* Enable digital function */
-    *denReg |= pin;
+    GPIO_Configure(&config, 1u);
 }
 
 void GPIO_WritePin(GPIO_Port port, uint8 pin, uint8 level) {
-    volatile uint32* dataReg = getDataReg(port);
-    
-    if(level == GPIO_HIGH) {
-        *dataReg |= pin;
-    } else {
-        *dataReg &= ~pin;
-    }
+    GPIO_Write(port, pin, (level == GPIO_HIGH) ? pin : 0u);
 }
 
 uint8 GPIO_ReadPin(GPIO_Port port, uint8 pin) {
-    volatile uint32* dataReg = getDataReg(port);
-    
-    if((*dataReg & pin) != 0u) {
+    if(GPIO_Read(port, pin) != 0u) {
         return GPIO_HIGH;
     } else {
         return GPIO_LOW;
@@ -95,6 +80,5 @@ uint8 GPIO_ReadPin(GPIO_Port port, uint8 pin) {
 }
 
 void GPIO_TogglePin(GPIO_Port port, uint8 pin) {
-    volatile uint32* dataReg = getDataReg(port);
-    *dataReg ^= pin;
+    GPIO_Toggle(port, pin);
 }
@@ -31,6 +31,94 @@ typedef enum {
 #define GPIO_LOW    0u
 #define GPIO_HIGH   1u
 
+/* Port Base Addresses (APB aperture) */
+#define GPIO_PORTA_BASE  0x40004000u
+#define GPIO_PORTB_BASE  0x40005000u
+#define GPIO_PORTC_BASE  0x40006000u
+#define GPIO_PORTD_BASE  0x40007000u
+#define GPIO_PORTE_BASE  0x40024000u
+#define GPIO_PORTF_BASE  0x40025000u
+
+/*
+ * Masked data access: address bits 9:2 of GPIODATA select the pins a read
+ * or write touches. A write changes only those pins, so setting or
+ * clearing a pin is a single store, with no read-modify-write for an
+ * interrupt to race with; a read returns 0 for every other pin.
+ */
+#define GPIO_DATA_MASKED(base, pins)  (*((volatile uint32 *)((base) + ((uint32)(pins) << 2))))
+
+/* Indexed by GPIO_Port. A constant port reads a constant entry, so the
+ * inline accessors below compile to the address and one load or store */
+static const uint32 gpioPortBase[] = {
+    GPIO_PORTA_BASE, GPIO_PORTB_BASE, GPIO_PORTC_BASE,
+    GPIO_PORTD_BASE, GPIO_PORTE_BASE, GPIO_PORTF_BASE
+};
+
+static inline void GPIO_Set(GPIO_Port port, uint8 pins) {
+    GPIO_DATA_MASKED(gpioPortBase[port], pins) = pins;
+}
+
+static inline void GPIO_Clear(GPIO_Port port, uint8 pins) {
+    GPIO_DATA_MASKED(gpioPortBase[port], pins) = 0u;
+}
+
+/* Drive each of 'pins' to its bit in 'value' */
+static inline void GPIO_Write(GPIO_Port port, uint8 pins, uint8 value) {
+    GPIO_DATA_MASKED(gpioPortBase[port], pins) = value;
+}
+
+/* Levels of 'pins' only; other bits read as 0 */
+static inline uint8 GPIO_Read(GPIO_Port port, uint8 pins) {
+    return (uint8)GPIO_DATA_MASKED(gpioPortBase[port], pins);
+}
+
+/* Load and store of the selected pins only: other pins of the port may
+ * change in an interrupt meanwhile, these must not */
+static inline void GPIO_Toggle(GPIO_Port port, uint8 pins) {
+    volatile uint32 *data = &GPIO_DATA_MASKED(gpioPortBase[port], pins);
+    *data = ~*data;
+}
+
+/* Register Offsets from a port base */
+#define GPIO_DIR_OFFSET    0x400u
+#define GPIO_AFSEL_OFFSET  0x420u
+#define GPIO_ODR_OFFSET    0x50Cu
+#define GPIO_PUR_OFFSET    0x510u
+#define GPIO_DEN_OFFSET    0x51Cu
+#define GPIO_LOCK_OFFSET   0x520u
+#define GPIO_CR_OFFSET     0x524u
+#define GPIO_AMSEL_OFFSET  0x528u
+#define GPIO_PCTL_OFFSET   0x52Cu
+
+#define GPIO_REG(base, offset)  (*((volatile uint32 *)((base) + (offset))))
+
+#define GPIO_LOCK_KEY      0x4C4F434Bu
+
+/* PCTL field of pin number n (0..7) selecting peripheral function fn */
+#define GPIO_PCTL(n, fn)   ((uint32)(fn) << ((n) * 4u))
+
+/*
+ * Every pin a driver uses on one port, set up by one GPIO_Configure call.
+ * Pins in none of outputs / inputs / alternate are left as they are.
+ * Initializers are positional, in this field order.
+ */
+typedef struct {
+    GPIO_Port port;
+    uint8 outputs;      /* GPIO outputs */
+    uint8 inputs;       /* GPIO inputs */
+    uint8 alternate;    /* Peripheral function from 'pctl' */
+    uint8 pullUps;      /* Of the pins above; the others lose theirs */
+    uint8 openDrain;
+    uint8 initHigh;     /* Outputs that start high (set before DIR) */
+    uint32 pctl;        /* GPIO_PCTL() fields of the alternate pins */
+} GPIO_PortConfig;
+
+/* Batched configuration: the clocks of all listed ports are enabled
+ * together (waiting only for ports not yet running), then each
+ * register of a port is written once for all its pins. PD7 and PF0 are
+ * unlocked when listed */
+void GPIO_Configure(const GPIO_PortConfig *configs, uint8 count);
+
 /* Simple GPIO Functions */
 void GPIO_InitPin(GPIO_Port port, uint8 pin, uint8 direction);
 void GPIO_WritePin(GPIO_Port port, uint8 pin, uint8 level);
@@ -38,7 +126,7 @@ uint8 GPIO_ReadPin(GPIO_Port port, uint8 pin);
 void GPIO_TogglePin(GPIO_Port port, uint8 pin);
 
 /* Helper Macros */
-#define GPIO_SET(port, pin)    GPIO_WritePin(port, pin, GPIO_HIGH)
-#define GPIO_CLEAR(port, pin)  GPIO_WritePin(port, pin, GPIO_LOW)
+#define GPIO_SET(port, pin)    GPIO_Set(port, pin)
+#define GPIO_CLEAR(port, pin)  GPIO_Clear(port, pin)
 
 #endif /* GPIO_H */
@@ -6,110 +6,368 @@
  *
  * Description: Source file for I2C1 driver (PA6/PA7)
  * Fixed loop declaration for C89 compatibility
+ * Interrupt-driven: transactions wait in a FIFO of pointers and the master
+ * interrupt steps the one at the front through its bytes. Shared state is
+ * protected by masking the I2C1 IRQ only, never interrupts as a whole.
  *
  *******************************************************************************/
 
 #include "i2c.h"
 #include "tm4c123gh6pm_registers.h"
-#include "delay.h"
+#include "timebase.h"
+#include "clock.h"
+#include "gpio.h"
 
-/* System Clock Assumption: 16 MHz */
-#define SYS_CLOCK_HZ            16000000
+static I2C_Transaction *i2cQueue[I2C_QUEUE_SIZE];
+static volatile uint8 i2cHead = 0;
+static volatile uint8 i2cTail = 0;
 
-void I2C1_Init(uint32 baudRate)
+static I2C_Transaction * volatile i2cActive = NULL_PTR;   /* == i2cQueue[tail] while running */
+static uint8 i2cIndex;          /* Bytes of the active transaction done */
+static uint8 i2cAttempt;
+static uint32 i2cDeadline;
+
+static uint32 i2cTpr;           /* Default rate */
+static uint32 i2cByteUs;        /* 9 SCL periods at the active rate */
+static I2C_Stats i2cStats;
+
+static void I2C1_StartNext(void);
+
+/* Mask the I2C1 interrupt, returning whether it was enabled (nests) */
+static uint32 I2C1_Lock(void)
 {
-    volatile uint32 delay;
+    uint32 key = NVIC_EN1_REG & I2C1_IRQ_BIT;
+    NVIC_DIS1_REG = I2C1_IRQ_BIT;
+    return key;
+}
 
-    /* 1. Enable Clock for I2C1 and GPIO Port A */
-    SYSCTL_RCGCI2C_REG |= 0x02;   /* Enable I2C1 clock */
-    SYSCTL_RCGCGPIO_REG |= 0x01;  /* Enable Port A clock */
-    
-    /* Wait for stable clock */
-    delay = SYSCTL_RCGCGPIO_REG;
-    (void)delay;
+static void I2C1_Unlock(uint32 key)
+{
+    if(key) NVIC_EN1_REG = I2C1_IRQ_BIT;
+}
 
-    /* 2. Configure PA6 (SCL) and PA7 (SDA) */
-    GPIO_PORTA_AFSEL_REG |= 0xC0; /* Enable Alt Function on PA6, PA7 */
-    GPIO_PORTA_DEN_REG |= 0xC0;   /* Enable Digital on PA6, PA7 */
-    
-    /* Configure Open Drain for SDA (PA7) using def from i2c.h */
-    GPIO_PORTA_ODR_REG |= 0x80;
+static uint32 I2C1_ByteUs(uint32 tpr)
+{
+    uint32 hz = I2C_SCL_HZ(Clock_GetHz(), tpr);
+    return (9 * 1000000 + hz - 1) / hz;
+}
 
-    /* Configure PCTL for I2C1 (Value 3 for PA6, PA7) */
-    GPIO_PORTA_PCTL_REG = (GPIO_PORTA_PCTL_REG & 0x00FFFFFF) | 0x33000000;
+uint32 I2C1_ActualHz(uint32 sclHz)
+{
+    return I2C_SCL_HZ(Clock_GetHz(), I2C_TPR(Clock_GetHz(), sclHz));
+}
 
-    /* 3. Initialize I2C1 Master */
+/* Master setup, shared by init and bus recovery */
+static void I2C1_Configure(void)
+{
     I2C1_MCR_REG = 0x00000010; /* Init Master function */
-
-    /* 4. Set Timer Period for Baud Rate */
-    /* TPR = (System Clock / (20 * BaudRate)) - 1 */
-    I2C1_MTPR_REG = (SYS_CLOCK_HZ / (20 * baudRate)) - 1;
+    I2C1_MTPR_REG = i2cTpr;
+    i2cByteUs = I2C1_ByteUs(i2cTpr);
+    I2C1_MICR_REG = I2C_MIMR_IM;
+    I2C1_MIMR_REG = I2C_MIMR_IM;
 }
 
-static void I2C1_Wait(void)
+static const GPIO_PortConfig i2cPinConfig = {
+    GPIO_PORTA, 0u, 0u, I2C_SCL_PIN | I2C_SDA_PIN, 0u, I2C_SDA_PIN, 0u, GPIO_PCTL(6, 3) | GPIO_PCTL(7, 3)
+};
+
+void I2C1_Init(uint32 baudRate)
 {
-    /* Wait until the controller is not busy */
-    while(I2C1_MCS_REG & I2C_MCS_BUSY);
+    /* 1. Enable Clock for I2C1 */
+    SYSCTL_RCGCI2C_REG |= 0x02;
+    while((SYSCTL_PRI2C_REG & 0x02) == 0);
+
+    /* 2. PA6 (SCL) and PA7 (SDA, open drain) to I2C1 */
+    GPIO_Configure(&i2cPinConfig, 1u);
+
+    /* 3. Initialize I2C1 Master */
+    /* TPR = (System Clock / (20 * BaudRate)) - 1, rounded up */
+    i2cTpr = I2C_TPR(Clock_GetHz(), baudRate);
+    I2C1_Configure();
+
+    /* 4. Master interrupt in the NVIC */
+    NVIC_PRI9_REG = (NVIC_PRI9_REG & ~0x0000E000) | (I2C1_IRQ_PRIORITY << 13);
+    NVIC_EN1_REG = I2C1_IRQ_BIT;
 }
 
-void I2C1_WriteByte(uint8 slaveAddr, uint8 data)
+/* (Re)start the active transaction from its first byte */
+static void I2C1_Begin(void)
 {
-    /* Set Slave Address (Writes have LSB = 0) */
-    I2C1_MSA_REG = (slaveAddr << 1); 
-    
-    /* Set Data */
-    I2C1_MDR_REG = data;
+    I2C_Transaction *txn = i2cActive;
+    uint32 command = I2C_MCS_START | I2C_MCS_RUN;
+    uint32 tpr = (txn->sclHz != 0) ? I2C_TPR(Clock_GetHz(), txn->sclHz) : i2cTpr;
 
-    /* Send START, RUN, STOP */
-    I2C1_MCS_REG = (I2C_MCS_START | I2C_MCS_RUN | I2C_MCS_STOP);
+    /* Per-device rate: the controller is idle between transactions */
+    if(tpr != (I2C1_MTPR_REG & I2C_TPR_MAX))
+    {
+        I2C1_MTPR_REG = tpr;
+        i2cByteUs = I2C1_ByteUs(tpr);
+    }
+
+    i2cIndex = 0;
+    i2cDeadline = TIME_DEADLINE_MS(I2C_TIMEOUT_MS + ((uint32)(txn->length + 1) * i2cByteUs) / 1000);
 
-    I2C1_Wait();
+    if(txn->read)
+    {
+        I2C1_MSA_REG = (txn->slaveAddr << 1) | 1;   /* Reads have LSB = 1 */
+        command |= (txn->length == 1) ? I2C_MCS_STOP : I2C_MCS_ACK;
+    }
+    else
+    {
+        I2C1_MSA_REG = (txn->slaveAddr << 1);       /* Writes have LSB = 0 */
+        I2C1_MDR_REG = txn->data[0];
+        if(txn->length == 1) command |= I2C_MCS_STOP;
+    }
+    I2C1_MCS_REG = command;
 }
 
-uint8 I2C1_ReadByte(uint8 slaveAddr)
+/* Retire the active transaction and start the next one */
+static void I2C1_Finish(uint8 status)
 {
-    /* Set Slave Address (Reads have LSB = 1) */
-    I2C1_MSA_REG = (slaveAddr << 1) | 1;
+    I2C_Transaction *txn = i2cActive;
 
-    /* Send START, RUN, STOP, ACK */
-    I2C1_MCS_REG = (I2C_MCS_START | I2C_MCS_RUN | I2C_MCS_STOP | I2C_MCS_ACK);
+    i2cActive = NULL_PTR;
+    i2cTail++;
+    i2cStats.transactions++;
+    if(status != I2C_STATUS_OK) i2cStats.errors++;
 
-    I2C1_Wait();
+    txn->status = status;
+    if(txn->callback != NULL_PTR) txn->callback(status, txn->ctx);
 
-    return (uint8)I2C1_MDR_REG;
+    /* The callback may already have submitted (and started) more */
+    if(i2cActive == NULL_PTR) I2C1_StartNext();
 }
 
-void I2C1_WritePacket(uint8 slaveAddr, uint8 *data, uint8 length)
+static void I2C1_StartNext(void)
 {
-    uint8 i; /* Variable 'i' declared at the top for C89 compatibility */
+    if(i2cHead == i2cTail) return;
+    i2cActive = i2cQueue[i2cTail & (I2C_QUEUE_SIZE - 1)];
+    i2cAttempt = 0;
+    I2C1_Begin();
+}
+
+/* Retry only while no byte has reached the slave; otherwise fail */
+static void I2C1_RetryOrFinish(uint8 status, boolean safe)
+{
+    if(safe && i2cIndex == 0 && i2cAttempt < I2C_MAX_RETRIES)
+    {
+        i2cAttempt++;
+        i2cStats.retries++;
+        I2C1_Begin();
+    }
+    else
+    {
+        I2C1_Finish(status);
+    }
+}
 
-    if(length == 0) return;
+/* The STOP after a NAK takes about one bit time; a restart written before
+ * it completes would be ignored. Bounded: the watchdog handles the rest */
+static void I2C1_WaitStop(void)
+{
+    uint32 deadline = TIME_DEADLINE_US(i2cByteUs);
+    while((I2C1_MCS_REG & I2C_MCS_BUSBSY) && !TIME_EXPIRED_US(deadline));
+}
 
-    I2C1_MSA_REG = (slaveAddr << 1);
-    I2C1_MDR_REG = data[0];
+uint8 I2C1_Submit(I2C_Transaction *txn)
+{
+    uint32 key;
+    uint8 status = I2C_STATUS_OK;
 
-    if(length == 1)
+    if(txn == NULL_PTR || txn->data == NULL_PTR || txn->length == 0) return I2C_STATUS_ERROR;
+
+    key = I2C1_Lock();
+    if((uint8)(i2cHead - i2cTail) >= I2C_QUEUE_SIZE)
     {
-        I2C1_MCS_REG = (I2C_MCS_START | I2C_MCS_RUN | I2C_MCS_STOP);
-        I2C1_Wait();
+        status = I2C_STATUS_ERROR;
     }
     else
     {
-        /* First Byte: START, RUN */
-        I2C1_MCS_REG = (I2C_MCS_START | I2C_MCS_RUN);
-        I2C1_Wait();
+        txn->status = I2C_STATUS_PENDING;
+        i2cQueue[i2cHead & (I2C_QUEUE_SIZE - 1)] = txn;
+        i2cHead++;
+        if(i2cActive == NULL_PTR) I2C1_StartNext();
+    }
+    I2C1_Unlock(key);
+    return status;
+}
+
+boolean I2C1_IsIdle(void)
+{
+    return (i2cActive == NULL_PTR && i2cHead == i2cTail) ? TRUE : FALSE;
+}
+
+void I2C1_WaitIdle(void)
+{
+    while(!I2C1_IsIdle())
+    {
+        I2C1_Poll();
+        Time_Sleep();       /* Woken by the I2C1 interrupt or the next tick */
+    }
+}
+
+void I2C1_Poll(void)
+{
+    uint32 key = I2C1_Lock();
+
+    if(i2cActive != NULL_PTR && TIME_EXPIRED_MS(i2cDeadline))
+    {
+        /* SCL held low or a slave stuck mid-byte: free the bus first */
+        i2cStats.timeouts++;
+        I2C1_RecoverBus();
+        I2C1_RetryOrFinish(I2C_STATUS_TIMEOUT, TRUE);
+    }
+    I2C1_Unlock(key);
+}
+
+static void I2C1_HalfBit(void)
+{
+    uint32 deadline = TIME_DEADLINE_US(I2C_RECOVERY_HALF_US);
+    while(!TIME_EXPIRED_US(deadline));
+}
+
+uint8 I2C1_RecoverBus(void)
+{
+    uint8 i;
+    boolean released;
+
+    i2cStats.recoveries++;
+
+    /* 1. Take the pins as GPIO: SCL an open-drain output, SDA an input (the
+     * data register only reads back the pin level on inputs) */
+    I2C1_PINS_DATA_REG = I2C_SCL_PIN | I2C_SDA_PIN;
+    GPIO_PORTA_ODR_REG |= I2C_SCL_PIN | I2C_SDA_PIN;
+    GPIO_PORTA_DIR_REG = (GPIO_PORTA_DIR_REG & ~I2C_SDA_PIN) | I2C_SCL_PIN;
+    GPIO_PORTA_AFSEL_REG &= ~(I2C_SCL_PIN | I2C_SDA_PIN);
+    I2C1_HalfBit();
+
+    /* 2. Clock until the slave has shifted out its byte and lets SDA go */
+    for(i = 0; i < I2C_RECOVERY_CLOCKS && !(I2C1_PINS_DATA_REG & I2C_SDA_PIN); i++)
+    {
+        I2C1_PINS_DATA_REG = 0;                 /* SCL low */
+        I2C1_HalfBit();
+        I2C1_PINS_DATA_REG = I2C_SCL_PIN;       /* SCL released */
+        I2C1_HalfBit();
+    }
 
-        /* Middle Bytes */
-        for(i = 1; i < length - 1; i++)
+    /* 3. STOP: SDA driven low, then released while SCL is high */
+    I2C1_PINS_DATA_REG = 0;
+    I2C1_HalfBit();
+    GPIO_PORTA_DIR_REG |= I2C_SDA_PIN;
+    I2C1_HalfBit();
+    I2C1_PINS_DATA_REG = I2C_SCL_PIN;
+    I2C1_HalfBit();
+    GPIO_PORTA_DIR_REG &= ~I2C_SDA_PIN;
+    I2C1_HalfBit();
+    released = (I2C1_PINS_DATA_REG & I2C_SDA_PIN) ? TRUE : FALSE;
+
+    /* 4. Hand the pins back and reset the controller out of whatever state
+     * the aborted transfer left it in */
+    GPIO_PORTA_DIR_REG &= ~(I2C_SCL_PIN | I2C_SDA_PIN);
+    GPIO_PORTA_ODR_REG &= ~I2C_SCL_PIN;
+    GPIO_PORTA_AFSEL_REG |= I2C_SCL_PIN | I2C_SDA_PIN;
+
+    SYSCTL_SRI2C_REG |= 0x02;
+    SYSCTL_SRI2C_REG &= ~0x02;
+    while((SYSCTL_PRI2C_REG & 0x02) == 0);
+    I2C1_Configure();
+
+    return released ? I2C_STATUS_OK : I2C_STATUS_ERROR;
+}
+
+void I2C1_GetStats(I2C_Stats *stats)
+{
+    uint32 key = I2C1_Lock();
+    *stats = i2cStats;
+    I2C1_Unlock(key);
+}
+
+void I2C1_Handler(void)
+{
+    I2C_Transaction *txn = i2cActive;
+    uint32 mcs;
+
+    /* Stale request left pending by a recovery, or nothing running */
+    if((I2C1_MRIS_REG & I2C_MIMR_IM) == 0) return;
+    I2C1_MICR_REG = I2C_MIMR_IM;
+    if(txn == NULL_PTR) return;
+
+    mcs = I2C1_MCS_REG;
+    if(mcs & I2C_MCS_ERROR)
+    {
+        if(mcs & I2C_MCS_ARBLST)
+        {
+            /* The controller has already left the bus */
+            i2cStats.arbLost++;
+            I2C1_RetryOrFinish(I2C_STATUS_ARBLOST, TRUE);
+        }
+        else
         {
-            I2C1_MDR_REG = data[i];
-            I2C1_MCS_REG = I2C_MCS_RUN;
-            I2C1_Wait();
+            /* NAK: the controller holds the bus until told to stop. A data
+             * NAK means bytes were delivered, so that one is not retried */
+            i2cStats.nacks++;
+            I2C1_MCS_REG = I2C_MCS_STOP;
+            I2C1_WaitStop();
+            I2C1_RetryOrFinish(I2C_STATUS_NACK, (mcs & I2C_MCS_ADRACK) ? TRUE : FALSE);
         }
+        return;
+    }
 
-        /* Last Byte: RUN, STOP */
-        I2C1_MDR_REG = data[length - 1];
-        I2C1_MCS_REG = (I2C_MCS_RUN | I2C_MCS_STOP);
-        I2C1_Wait();
+    if(txn->read) txn->data[i2cIndex] = (uint8)I2C1_MDR_REG;
+    i2cIndex++;
+
+    if(i2cIndex >= txn->length)
+    {
+        I2C1_Finish(I2C_STATUS_OK);
+    }
+    else if(txn->read)
+    {
+        /* NAK the last byte so the slave releases SDA for the STOP */
+        I2C1_MCS_REG = I2C_MCS_RUN | ((i2cIndex == txn->length - 1) ? I2C_MCS_STOP : I2C_MCS_ACK);
+    }
+    else
+    {
+        I2C1_MDR_REG = txn->data[i2cIndex];
+        I2C1_MCS_REG = I2C_MCS_RUN | ((i2cIndex == txn->length - 1) ? I2C_MCS_STOP : 0);
     }
 }
+
+/* Blocking wrappers: submit, then sleep until the transaction finishes */
+static uint8 I2C1_Transfer(uint8 slaveAddr, boolean read, uint8 *data, uint8 length)
+{
+    I2C_Transaction txn;
+
+    txn.slaveAddr = slaveAddr;
+    txn.read = read;
+    txn.data = data;
+    txn.length = length;
+    txn.sclHz = 0;
+    txn.callback = NULL_PTR;
+    txn.ctx = NULL_PTR;
+
+    if(I2C1_Submit(&txn) != I2C_STATUS_OK) return I2C_STATUS_ERROR;
+    while(txn.status == I2C_STATUS_PENDING)
+    {
+        I2C1_Poll();
+        Time_Sleep();
+    }
+    return txn.status;
+}
+
+uint8 I2C1_WriteByte(uint8 slaveAddr, uint8 data)
+{
+    return I2C1_Transfer(slaveAddr, FALSE, &data, 1);
+}
+
+uint8 I2C1_ReadByte(uint8 slaveAddr)
+{
+    uint8 data = 0xFF;
+
+    if(I2C1_Transfer(slaveAddr, TRUE, &data, 1) != I2C_STATUS_OK) return 0xFF;
+    return data;
+}
+
+uint8 I2C1_WritePacket(uint8 slaveAddr, uint8 *data, uint8 length)
+{
+    return I2C1_Transfer(slaveAddr, FALSE, data, length);
+}
@@ -6,6 +6,10 @@
  *
  * Description: Header file for I2C1 driver (PA6/PA7)
  * Includes Register Definitions for I2C1 and Port A ODR
+ * Transfers are interrupt-driven: I2C1_Submit queues a caller-owned
+ * I2C_Transaction and returns at once; I2C1_Handler moves it byte by byte
+ * and calls its callback (in interrupt context) when it ends. The blocking
+ * calls below are thin wrappers that submit and wait.
  *
  *******************************************************************************/
 
@@ -28,8 +32,15 @@
 #define I2C1_MCS_REG            (*((volatile uint32 *)0x40021004))
 #define I2C1_MDR_REG            (*((volatile uint32 *)0x40021008))
 #define I2C1_MTPR_REG           (*((volatile uint32 *)0x4002100C))
+#define I2C1_MIMR_REG           (*((volatile uint32 *)0x40021010))
+#define I2C1_MRIS_REG           (*((volatile uint32 *)0x40021014))
+#define I2C1_MICR_REG           (*((volatile uint32 *)0x4002101C))
 #define I2C1_MCR_REG            (*((volatile uint32 *)0x40021020))
 
+/* PA6/PA7 through the masked data address: bus recovery touches only the
+ * I2C pins, never the bit-banged SPI lines the sniffer ISR drives */
+#define I2C1_PINS_DATA_REG      (*((volatile uint32 *)0x40004300))
+
 /* I2C Control Bits */
 #define I2C_MCS_RUN             0x00000001  /* I2C Master Enable */
 #define I2C_MCS_START           0x00000002  /* Generate START */
@@ -37,27 +48,124 @@
 #define I2C_MCS_ACK             0x00000008  /* Data Acknowledge Enable */
 #define I2C_MCS_BUSY            0x00000001  /* I2C Busy */
 #define I2C_MCS_ERROR           0x00000002  /* Error */
+#define I2C_MCS_ADRACK          0x00000004  /* Address not acknowledged */
+#define I2C_MCS_DATACK          0x00000008  /* Data not acknowledged */
+#define I2C_MCS_ARBLST          0x00000010  /* Arbitration lost */
+#define I2C_MCS_BUSBSY          0x00000040  /* Bus held by someone (SDA/SCL low) */
+#define I2C_MIMR_IM             0x00000001  /* Master interrupt */
 
 /*******************************************************************************
  * Definitions                                   *
  *******************************************************************************/
-#define I2C_BAUDRATE_100K    100000
-#define I2C_BAUDRATE_400K    400000
+#define I2C_BAUDRATE_100K    100000     /* Standard-mode */
+#define I2C_BAUDRATE_400K    400000     /* Fast-mode */
+#define I2C_BAUDRATE_1M      1000000    /* Fast-mode Plus */
+
+/* SCL period = 20 * (1 + TPR) system clocks (6 low + 4 high, doubled).
+ * TPR is rounded up so SCL never exceeds the requested rate, and limited
+ * to 1..127. Plain macros so the host check (Tools/i2c_timing.c) uses the
+ * exact arithmetic of the driver */
+#define I2C_TPR_MIN          1
+#define I2C_TPR_MAX          127
+#define I2C_TPR_CEIL(clk, scl)  (((uint32)(clk) + 20u * (uint32)(scl) - 1u) / (20u * (uint32)(scl)) - 1u)
+#define I2C_TPR(clk, scl)    (I2C_TPR_CEIL(clk, scl) < I2C_TPR_MIN ? I2C_TPR_MIN : \
+                              (I2C_TPR_CEIL(clk, scl) > I2C_TPR_MAX ? I2C_TPR_MAX : I2C_TPR_CEIL(clk, scl)))
+#define I2C_SCL_HZ(clk, tpr) ((uint32)(clk) / (20u * ((uint32)(tpr) + 1u)))
+#define I2C_SCL_LOW_CLOCKS(tpr)     (12u * ((uint32)(tpr) + 1u))
+#define I2C_SCL_HIGH_CLOCKS(tpr)    (8u * ((uint32)(tpr) + 1u))
+
+/* Transaction deadline: this much slack plus the time its bytes take */
+#define I2C_TIMEOUT_MS       5
+
+/* Retries after a lost arbitration or an address NAK. Once a data byte has
+ * gone out the transfer is not repeated (the slave would see it twice) */
+#define I2C_MAX_RETRIES      2
+
+#define I2C_QUEUE_SIZE       8      /* Power of two */
+
+/* I2C1 is IRQ 37: NVIC EN1/DIS1 bit 5, PRI9 bits 15:13. Below the CAN
+ * interrupt and SysTick: an LCD byte may wait, a CAN frame may not */
+#define I2C1_IRQ_BIT         (1u << 5)
+#define I2C1_IRQ_PRIORITY    2
+
+/* Recovery: SCL pulses to free a slave stuck mid-byte, half period in us */
+#define I2C_RECOVERY_CLOCKS  9
+#define I2C_RECOVERY_HALF_US 5
+#define I2C_SCL_PIN          (1u << 6)
+#define I2C_SDA_PIN          (1u << 7)
+
+/* Status Codes */
+#define I2C_STATUS_OK        0
+#define I2C_STATUS_ERROR     1      /* Not queued: invalid or queue full */
+#define I2C_STATUS_TIMEOUT   2      /* Deadline passed; the bus was recovered */
+#define I2C_STATUS_NACK      3      /* Address or data not acknowledged */
+#define I2C_STATUS_ARBLOST   4      /* Arbitration lost on every attempt */
+#define I2C_STATUS_PENDING   5      /* Queued or in progress */
+
+typedef void (*I2C_Callback)(uint8 status, void *ctx);
+
+/* Owned by the caller and must stay valid until the callback has run */
+typedef struct {
+    uint8 slaveAddr;
+    boolean read;
+    uint8 *data;
+    uint8 length;
+    uint32 sclHz;                   /* Device's rate; 0 = the I2C1_Init rate */
+    I2C_Callback callback;          /* Interrupt context; NULL_PTR for none */
+    void *ctx;
+    volatile uint8 status;          /* I2C_STATUS_PENDING until finished */
+} I2C_Transaction;
+
+typedef struct {
+    uint32 transactions;            /* Finished, successfully or not */
+    uint32 errors;
+    uint32 nacks;
+    uint32 arbLost;
+    uint32 timeouts;
+    uint32 retries;
+    uint32 recoveries;
+} I2C_Stats;
 
 /*******************************************************************************
  * Function Prototypes                               *
  *******************************************************************************/
 
-/* Initialize I2C1 module on PA6 (SCL) and PA7 (SDA) */
+/* Initialize I2C1 module on PA6 (SCL) and PA7 (SDA); baudRate is the
+ * default for transactions that do not set their own sclHz */
 void I2C1_Init(uint32 baudRate);
 
-/* Write a single byte to a specific slave address */
-void I2C1_WriteByte(uint8 slaveAddr, uint8 data);
+/* SCL rate actually produced for a requested one at the current clock */
+uint32 I2C1_ActualHz(uint32 sclHz);
+
+/* Queue a transaction; I2C_STATUS_OK if it was accepted */
+uint8 I2C1_Submit(I2C_Transaction *txn);
+
+/* TRUE when the queue is empty and the controller is idle */
+boolean I2C1_IsIdle(void);
+
+/* Sleep until everything queued has finished */
+void I2C1_WaitIdle(void);
+
+/* Deadline watchdog for the transfer in progress; called by the waits here
+ * and periodically by the application */
+void I2C1_Poll(void);
+
+/* Clock a stuck slave free and re-initialize the controller; I2C_STATUS_OK
+ * if SDA is released */
+uint8 I2C1_RecoverBus(void);
+
+void I2C1_GetStats(I2C_Stats *stats);
+
+/* I2C1 master interrupt */
+void I2C1_Handler(void);
+
+/* Write a single byte to a specific slave address (blocking) */
+uint8 I2C1_WriteByte(uint8 slaveAddr, uint8 data);
 
-/* Read a single byte from a specific slave address */
+/* Read a single byte from a specific slave address (blocking; 0xFF on error) */
 uint8 I2C1_ReadByte(uint8 slaveAddr);
 
-/* Write multiple bytes (used for LCD commands) */
-void I2C1_WritePacket(uint8 slaveAddr, uint8 *data, uint8 length);
+/* Write multiple bytes (blocking) */
+uint8 I2C1_WritePacket(uint8 slaveAddr, uint8 *data, uint8 length);
 
 #endif /* I2C_H_ */
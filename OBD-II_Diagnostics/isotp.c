@@ -0,0 +1,270 @@
+/******************************************************************************
+ *
+ * Module: ISO-TP (ISO 15765-2)
+ *
+ * File Name: isotp.c
+ *
+ * Description: Source file for the ISO-TP transport layer
+ * Normal 11-bit addressing, 8-byte padded frames, polled reception
+ *
+ *******************************************************************************/
+
+#include "isotp.h"
+#include "mcp2515.h"
+#include "delay.h"
+#include "timebase.h"
+
+void ISOTP_InitLink(ISOTP_Link *link, uint32 txId, uint32 rxIdMin, uint32 rxIdMax)
+{
+    link->txId = txId;
+    link->rxIdMin = rxIdMin;
+    link->rxIdMax = rxIdMax;
+    link->rxId = 0;
+}
+
+/* Queue one padded frame, retrying while TXB0 is still busy */
+static uint8 ISOTP_TransmitFrame(uint32 id, const uint8 *data, uint8 length)
+{
+    MCP2515_Message msg;
+    uint8 i;
+    uint32 deadline = TIME_DEADLINE_MS(ISOTP_TX_RETRY_MS);
+
+    msg.id = id;
+    msg.idType = MCP2515_FRAME_STD;
+    msg.dlc = 8;
+    for(i = 0; i < 8; i++)
+    {
+        msg.data[i] = (i < length) ? data[i] : ISOTP_PADDING_BYTE;
+    }
+
+    while(MCP2515_Transmit(&msg) != MCP2515_STATUS_OK)
+    {
+        if(TIME_EXPIRED_MS(deadline)) return ISOTP_STATUS_TIMEOUT;
+        Time_Sleep();
+    }
+    return ISOTP_STATUS_OK;
+}
+
+static boolean ISOTP_IsFromResponder(const ISOTP_Link *link, const MCP2515_Message *msg)
+{
+    if(msg->dlc == 0) return FALSE;
+    if(msg->id < link->rxIdMin || msg->id > link->rxIdMax) return FALSE;
+    if(link->rxId != 0 && msg->id != link->rxId) return FALSE;
+    return TRUE;
+}
+
+/* Wait for the next frame from the link's responder, draining foreign traffic */
+static uint8 ISOTP_WaitFrame(const ISOTP_Link *link, MCP2515_Message *msg, uint32 timeout_ms)
+{
+    uint32 deadline = TIME_DEADLINE_MS(timeout_ms);
+
+    for(;;)
+    {
+        while(MCP2515_Receive(msg) == MCP2515_STATUS_OK)
+        {
+            if(ISOTP_IsFromResponder(link, msg)) return ISOTP_STATUS_OK;
+        }
+        if(TIME_EXPIRED_MS(deadline)) return ISOTP_STATUS_TIMEOUT;
+        Time_Sleep();
+    }
+}
+
+static uint8 ISOTP_SendFlowControl(const ISOTP_RxSession *session, uint32 responderId, uint8 flowStatus)
+{
+    uint8 fc[3];
+    fc[0] = ISOTP_PCI_FLOW_CONTROL | flowStatus;
+    fc[1] = ISOTP_RX_BLOCK_SIZE;
+    fc[2] = ISOTP_RX_STMIN_MS;
+    if(session->txId != 0) return ISOTP_TransmitFrame(session->txId, fc, 3);
+    return ISOTP_TransmitFrame(responderId - ISOTP_FC_ID_OFFSET, fc, 3);
+}
+
+/* STmin encoding: 0-127 ms, 0xF1-0xF9 = 100-900 us (rounded up to 1 ms) */
+static uint8 ISOTP_DecodeStMin(uint8 stMin)
+{
+    if(stMin <= 0x7F) return stMin;
+    if(stMin >= 0xF1 && stMin <= 0xF9) return 1;
+    return 0x7F;
+}
+
+uint8 ISOTP_Send(ISOTP_Link *link, const uint8 *data, uint16 length)
+{
+    MCP2515_Message msg;
+    uint8 frame[8];
+    uint16 offset;
+    uint8 seq = 1;
+    uint8 blockSize = 0;
+    uint8 blockCount = 0;
+    uint8 stMin = 0;
+    uint8 waitCount = 0;
+    uint8 chunk, i;
+
+    if(length == 0 || length > 0x0FFF) return ISOTP_STATUS_ERROR;
+
+    /* 1. Single Frame */
+    if(length <= 7)
+    {
+        frame[0] = ISOTP_PCI_SINGLE | (uint8)length;
+        for(i = 0; i < length; i++) frame[1 + i] = data[i];
+        return ISOTP_TransmitFrame(link->txId, frame, (uint8)(length + 1));
+    }
+
+    /* 2. First Frame */
+    frame[0] = ISOTP_PCI_FIRST | (uint8)(length >> 8);
+    frame[1] = (uint8)length;
+    for(i = 0; i < 6; i++) frame[2 + i] = data[i];
+    if(ISOTP_TransmitFrame(link->txId, frame, 8) != ISOTP_STATUS_OK) return ISOTP_STATUS_TIMEOUT;
+    offset = 6;
+
+    /* 3. Consecutive Frames, paced by the receiver's Flow Control */
+    while(offset < length)
+    {
+        if(blockCount == 0)
+        {
+            if(ISOTP_WaitFrame(link, &msg, ISOTP_TIMEOUT_N_BS) != ISOTP_STATUS_OK) return ISOTP_STATUS_TIMEOUT;
+            if((msg.data[0] & 0xF0) != ISOTP_PCI_FLOW_CONTROL) continue;
+            link->rxId = msg.id;
+
+            switch(msg.data[0] & 0x0F)
+            {
+                case ISOTP_FS_CTS:
+                    blockSize = msg.data[1];
+                    stMin = ISOTP_DecodeStMin(msg.data[2]);
+                    blockCount = (blockSize == 0) ? 0xFF : blockSize;
+                    break;
+                case ISOTP_FS_WAIT:
+                    if(++waitCount > ISOTP_MAX_FC_WAIT) return ISOTP_STATUS_TIMEOUT;
+                    continue;
+                case ISOTP_FS_OVERFLOW:
+                    return ISOTP_STATUS_OVERFLOW;
+                default:
+                    return ISOTP_STATUS_ERROR;
+            }
+        }
+
+        chunk = (length - offset > 7) ? 7 : (uint8)(length - offset);
+        frame[0] = ISOTP_PCI_CONSECUTIVE | (seq & 0x0F);
+        for(i = 0; i < chunk; i++) frame[1 + i] = data[offset + i];
+        if(ISOTP_TransmitFrame(link->txId, frame, (uint8)(chunk + 1)) != ISOTP_STATUS_OK) return ISOTP_STATUS_TIMEOUT;
+
+        offset += chunk;
+        seq++;
+        if(blockSize != 0) blockCount--;
+        if(stMin != 0 && offset < length) Delay_MS(stMin);
+    }
+    return ISOTP_STATUS_OK;
+}
+
+void ISOTP_RxInit(ISOTP_RxSession *session, const ISOTP_Link *link, uint8 *buffer, uint16 bufferSize)
+{
+    session->buffer = buffer;
+    session->bufferSize = bufferSize;
+    session->txId = (link->rxIdMin == link->rxIdMax) ? link->txId : 0;
+    session->rxId = 0;
+}
+
+uint8 ISOTP_RxFrame(ISOTP_RxSession *session, const MCP2515_Message *msg, uint16 *length)
+{
+    uint16 total;
+    uint8 chunk, i;
+
+    if(msg->dlc == 0) return ISOTP_STATUS_PENDING;
+
+    /* 1. Single Frame. A new SF/FF aborts the message in progress (ISO 15765-2) */
+    if((msg->data[0] & 0xF0) == ISOTP_PCI_SINGLE)
+    {
+        session->rxId = 0;
+        total = msg->data[0] & 0x0F;
+        if(total == 0 || total > 7 || total >= msg->dlc) return ISOTP_STATUS_PENDING;
+        if(total > session->bufferSize) return ISOTP_STATUS_OVERFLOW;
+        for(i = 0; i < total; i++) session->buffer[i] = msg->data[1 + i];
+        *length = total;
+        return ISOTP_STATUS_OK;
+    }
+
+    /* 2. First Frame: lock onto the responder and grant the transfer */
+    if((msg->data[0] & 0xF0) == ISOTP_PCI_FIRST)
+    {
+        session->rxId = 0;
+        if(msg->dlc != 8) return ISOTP_STATUS_PENDING;
+        total = ((uint16)(msg->data[0] & 0x0F) << 8) | msg->data[1];
+        if(total <= 7) return ISOTP_STATUS_ERROR;
+        if(total > session->bufferSize)
+        {
+            ISOTP_SendFlowControl(session, msg->id, ISOTP_FS_OVERFLOW);
+            return ISOTP_STATUS_OVERFLOW;
+        }
+        for(i = 0; i < 6; i++) session->buffer[i] = msg->data[2 + i];
+        session->total = total;
+        session->offset = 6;
+        session->seq = 1;
+        session->blockCount = 0;
+        if(ISOTP_SendFlowControl(session, msg->id, ISOTP_FS_CTS) != ISOTP_STATUS_OK) return ISOTP_STATUS_TIMEOUT;
+        session->rxId = msg->id;
+        session->deadline = TIME_DEADLINE_MS(ISOTP_TIMEOUT_N_CR);
+        return ISOTP_STATUS_PENDING;
+    }
+
+    /* 3. Consecutive Frames. Stray CF/FC frames are ignored until a message starts */
+    if((msg->data[0] & 0xF0) != ISOTP_PCI_CONSECUTIVE) return ISOTP_STATUS_PENDING;
+    if(session->rxId == 0 || msg->id != session->rxId) return ISOTP_STATUS_PENDING;
+    if((msg->data[0] & 0x0F) != (session->seq & 0x0F))
+    {
+        session->rxId = 0;
+        return ISOTP_STATUS_ERROR;
+    }
+
+    chunk = (session->total - session->offset > 7) ? 7 : (uint8)(session->total - session->offset);
+    for(i = 0; i < chunk; i++) session->buffer[session->offset + i] = msg->data[1 + i];
+    session->offset += chunk;
+    session->seq++;
+
+    if(session->offset >= session->total)
+    {
+        session->rxId = 0;
+        *length = session->total;
+        return ISOTP_STATUS_OK;
+    }
+
+    session->deadline = TIME_DEADLINE_MS(ISOTP_TIMEOUT_N_CR);
+    if(ISOTP_RX_BLOCK_SIZE != 0 && ++session->blockCount == ISOTP_RX_BLOCK_SIZE)
+    {
+        session->blockCount = 0;
+        if(ISOTP_SendFlowControl(session, msg->id, ISOTP_FS_CTS) != ISOTP_STATUS_OK)
+        {
+            session->rxId = 0;
+            return ISOTP_STATUS_TIMEOUT;
+        }
+    }
+    return ISOTP_STATUS_PENDING;
+}
+
+boolean ISOTP_RxExpired(ISOTP_RxSession *session)
+{
+    if(session->rxId == 0 || !TIME_EXPIRED_MS(session->deadline)) return FALSE;
+    session->rxId = 0;
+    return TRUE;
+}
+
+uint8 ISOTP_Receive(ISOTP_Link *link, uint8 *buffer, uint16 bufferSize,
+                    uint16 *length, uint32 timeout_ms)
+{
+    ISOTP_RxSession session;
+    MCP2515_Message msg;
+    uint8 status;
+
+    ISOTP_RxInit(&session, link, buffer, bufferSize);
+    for(;;)
+    {
+        /* timeout_ms for a message to start, then N_Cr for each Consecutive Frame */
+        if(ISOTP_WaitFrame(link, &msg, (session.rxId != 0) ? ISOTP_TIMEOUT_N_CR : timeout_ms) != ISOTP_STATUS_OK)
+        {
+            return ISOTP_STATUS_TIMEOUT;
+        }
+
+        status = ISOTP_RxFrame(&session, &msg, length);
+        if(status == ISOTP_STATUS_OK) link->rxId = msg.id;
+        if(status != ISOTP_STATUS_PENDING) return status;
+        if(session.rxId != 0) link->rxId = session.rxId;
+    }
+}
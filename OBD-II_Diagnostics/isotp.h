@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * Module: ISO-TP (ISO 15765-2)
+ *
+ * File Name: isotp.h
+ *
+ * Description: Header file for the ISO-TP transport layer on top of the
+ * MCP2515 driver (single/multi-frame segmentation and flow control)
+ *
+ *******************************************************************************/
+
+#ifndef ISOTP_H_
+#define ISOTP_H_
+
+#include "std_types.h"
+#include "mcp2515.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* Protocol Control Information (upper nibble of the first data byte) */
+#define ISOTP_PCI_SINGLE            0x00
+#define ISOTP_PCI_FIRST             0x10
+#define ISOTP_PCI_CONSECUTIVE       0x20
+#define ISOTP_PCI_FLOW_CONTROL      0x30
+
+/* Flow Status values */
+#define ISOTP_FS_CTS                0x00
+#define ISOTP_FS_WAIT               0x01
+#define ISOTP_FS_OVERFLOW           0x02
+
+/* After a functional request, responses from ECU 0x7E8+n are flow-controlled
+ * on its physical request ID 0x7E0+n */
+#define ISOTP_FC_ID_OFFSET          8
+
+/* Flow Control parameters we advertise as receiver */
+#define ISOTP_RX_BLOCK_SIZE         0       /* Send all CFs without further FC */
+#define ISOTP_RX_STMIN_MS           1       /* Gives the polled RX path headroom */
+
+/* Timeouts (ms) */
+#define ISOTP_TIMEOUT_N_BS          1000    /* Wait for Flow Control */
+#define ISOTP_TIMEOUT_N_CR          1000    /* Wait for next Consecutive Frame */
+#define ISOTP_TX_RETRY_MS           10      /* Wait for a free TX buffer */
+#define ISOTP_MAX_FC_WAIT           10      /* Max FC.WAIT frames accepted */
+
+#define ISOTP_PADDING_BYTE          0x55
+
+/* Status Codes */
+#define ISOTP_STATUS_OK             0
+#define ISOTP_STATUS_ERROR          1
+#define ISOTP_STATUS_TIMEOUT        2
+#define ISOTP_STATUS_OVERFLOW       3
+#define ISOTP_STATUS_PENDING        4       /* ISOTP_RxFrame: message not complete yet */
+
+/* Addressing of one logical connection */
+typedef struct {
+    uint32 txId;        /* CAN ID used for our requests (functional or physical) */
+    uint32 rxIdMin;     /* Accepted response ID range */
+    uint32 rxIdMax;
+    uint32 rxId;        /* Responder locked in by the first accepted frame (0 = none) */
+} ISOTP_Link;
+
+/* Reception advanced one frame at a time by the caller, so nothing waits
+ * for the next Consecutive Frame */
+typedef struct {
+    uint8 *buffer;
+    uint16 bufferSize;
+    uint32 txId;        /* Flow Control ID: the physical request ID, 0 = responder - 8 */
+    uint32 rxId;        /* Responder of the multi-frame message in progress (0 = idle) */
+    uint16 total;
+    uint16 offset;
+    uint8 seq;
+    uint8 blockCount;
+    uint32 deadline;    /* N_Cr for the next Consecutive Frame */
+} ISOTP_RxSession;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Prepare a link; the responder lock is cleared */
+void ISOTP_InitLink(ISOTP_Link *link, uint32 txId, uint32 rxIdMin, uint32 rxIdMax);
+
+/* Send a complete message (SF, or FF + CFs honouring the receiver's FC) */
+uint8 ISOTP_Send(ISOTP_Link *link, const uint8 *data, uint16 length);
+
+/* Receive a complete message from the link's responder into buffer */
+uint8 ISOTP_Receive(ISOTP_Link *link, uint8 *buffer, uint16 bufferSize,
+                    uint16 *length, uint32 timeout_ms);
+
+/* Flow Control goes to the link's txId when it is physical (one responder
+ * ID), to the responder ID - 8 after a functional request */
+void ISOTP_RxInit(ISOTP_RxSession *session, const ISOTP_Link *link, uint8 *buffer, uint16 bufferSize);
+
+/* Feed one frame from a responder (the caller picks the IDs). Returns OK
+ * with *length set when the frame completes a message, PENDING when it
+ * was taken in or ignored. A First Frame gets its Flow Control at once.
+ * Any other status drops the message in progress */
+uint8 ISOTP_RxFrame(ISOTP_RxSession *session, const MCP2515_Message *msg, uint16 *length);
+
+/* TRUE, and the session idle again, if the message in progress missed N_Cr */
+boolean ISOTP_RxExpired(ISOTP_RxSession *session);
+
+#endif /* ISOTP_H_ */
@@ -5,13 +5,22 @@
  * File Name: lcd.c
  *
  * Description: Source file for 16x2 I2C LCD Driver
- * Uses I2C1 and Delay_MS
+ * Uses I2C1 (one packet per string or flush) and the us time base. Every
+ * write is mirrored in lcdScreen, so the framebuffer flush knows exactly
+ * what the display shows.
+ * Packets go out in the background from two alternating buffers: a send
+ * returns once the packet is queued, and only waits when the other buffer
+ * is still on the bus. A failed packet may have split a byte between its
+ * nibbles, so the next write re-initializes the controller first.
+ * Timing: each packet records how long the controller needs after its
+ * last write. A packet that would reach the controller sooner is held
+ * back until then; there are no fixed delays.
  *
  *******************************************************************************/
 
 #include "lcd.h"
 #include "i2c.h"
-#include "delay.h"
+#include "timebase.h"
 
 /* Internal Bit Masks for PCF8574 */
 #define LCD_RS         0x01
@@ -19,15 +28,145 @@
 #define LCD_EN         0x04
 #define LCD_BACKLIGHT  0x08
 
-static void LCD_WriteNibble(uint8 nibble, uint8 controlBits)
+/* HD44780 commands */
+#define LCD_CMD_CLEAR           0x01
+#define LCD_CMD_HOME            0x02
+#define LCD_CMD_SET_CGRAM       0x40
+#define LCD_CMD_SET_DDRAM       0x80
+
+/* DDRAM layout: row 0 at 0x00-0x27, row 1 at 0x40-0x67 */
+#define LCD_ROW_ADDRESS(row)    ((row) == 0 ? 0x00 : 0x40)
+#define LCD_ADDRESS_UNKNOWN     0xFF
+
+static uint8 backlight = LCD_BACKLIGHT;
+static uint8 lcdDisplayCmd = 0x0C;  /* Display ON, Cursor OFF, Blink OFF */
+
+/* PCF8574 output bytes, one I2C transaction per buffer: lcdTxIndex is
+ * being filled while the other may still be on the bus */
+static uint8 lcdTx[2][LCD_TX_BUFFER_SIZE];
+static I2C_Transaction lcdTxn[2];
+static uint8 lcdTxIndex = 0;
+static uint8 lcdTxLen = 0;
+static uint8 lcdBatch = 0;      /* > 0 while a string or flush is being queued */
+static uint8 lcdNibbleBytes = 2;    /* PCF8574 bytes per nibble, see LCD_Init */
+static uint16 lcdTxExecUs[2];       /* Execution time of each buffer's last write */
+static uint16 lcdLatchUs = 0;       /* Packet start to its first EN falling edge */
+static volatile uint32 lcdReadyUs;  /* Controller free after the last packet */
+static volatile boolean lcdResync = FALSE;   /* A packet failed: controller state unknown */
+static boolean lcdResetting = FALSE;
+
+static char lcdScreen[LCD_ROWS][LCD_COLS];    /* What the display shows */
+static char lcdShadow[LCD_ROWS][LCD_COLS];    /* What the application drew */
+static uint8 lcdAddress = LCD_ADDRESS_UNKNOWN; /* DDRAM address counter */
+static uint8 fbRow = 0;
+static uint8 fbCol = 0;
+
+static void LCD_Reset(void);
+
+/* I2C1 interrupt context; ctx is the buffer's execution time */
+static void LCD_TxDone(uint8 status, void *ctx)
+{
+    lcdReadyUs = Time_NowUs() + *(uint16 *)ctx;
+    if(status != I2C_STATUS_OK) lcdResync = TRUE;
+}
+
+/* Hold the next packet until its first nibble can no longer arrive while
+ * the controller is still executing. The I2C byte time already covers
+ * the usual 37 us; only the slow commands wait */
+static void LCD_WaitReady(void)
+{
+    uint8 prev = lcdTxIndex ^ 1;
+    uint32 readyUs, remainingUs;
+
+    if(lcdTxn[prev].status == I2C_STATUS_PENDING)
+    {
+        if(lcdTxExecUs[prev] <= lcdLatchUs) return;
+        while(lcdTxn[prev].status == I2C_STATUS_PENDING)
+        {
+            I2C1_Poll();
+            Time_Sleep();
+        }
+    }
+
+    /* No deadline is set more than LCD_POWER_UP_US ahead, so a longer wait
+     * is one already past: after an idle spell of over 2^31 us it would
+     * otherwise look up to 36 minutes in the future */
+    readyUs = lcdReadyUs - lcdLatchUs;
+    for(;;)
+    {
+        remainingUs = (uint32)(readyUs - Time_NowUs());
+        if(remainingUs == 0 || remainingUs > LCD_POWER_UP_US) return;
+
+        /* A tick is at most 1 ms away: sleep while that cannot overshoot */
+        if(remainingUs >= 1000) Time_Sleep();
+    }
+}
+
+static void LCD_TxSend(void)
+{
+    I2C_Transaction *txn = &lcdTxn[lcdTxIndex];
+
+    if(lcdTxLen == 0) return;
+    LCD_WaitReady();
+    txn->slaveAddr = LCD_SLAVE_ADDRESS;
+    txn->read = FALSE;
+    txn->data = lcdTx[lcdTxIndex];
+    txn->length = lcdTxLen;
+    txn->sclHz = LCD_I2C_BAUDRATE;
+    txn->callback = LCD_TxDone;
+    txn->ctx = &lcdTxExecUs[lcdTxIndex];
+    if(I2C1_Submit(txn) != I2C_STATUS_OK) lcdResync = TRUE;
+
+    /* Switch buffers; the other one is reused once its packet is out */
+    lcdTxIndex ^= 1;
+    lcdTxLen = 0;
+    while(lcdTxn[lcdTxIndex].status == I2C_STATUS_PENDING)
+    {
+        I2C1_Poll();
+        Time_Sleep();
+    }
+}
+
+/* Re-run the init sequence after a failed packet, between transfers only */
+static void LCD_CheckResync(void)
+{
+    if(!lcdResync || lcdResetting || lcdBatch != 0) return;
+    lcdResetting = TRUE;
+    lcdResync = FALSE;
+    LCD_Reset();
+    lcdResetting = FALSE;
+}
+
+/* Each PCF8574 byte holds its outputs for one I2C byte time (90 us at
+ * 100 kHz, 22.5 us at 400 kHz), which is the enable pulse width; the
+ * bytes of one character then span the HD44780's 37 us execution time.
+ * At 1 MHz they would not, so extra hold bytes pad each nibble */
+static void LCD_QueueNibble(uint8 nibble, uint8 controlBits)
+{
+    uint8 data = (nibble & 0xF0) | controlBits | backlight;
+    uint8 i;
+
+    if(lcdTxLen > LCD_TX_BUFFER_SIZE - lcdNibbleBytes) LCD_TxSend();
+    lcdTx[lcdTxIndex][lcdTxLen++] = data | LCD_EN;
+    for(i = 1; i < lcdNibbleBytes; i++)
+    {
+        lcdTx[lcdTxIndex][lcdTxLen++] = data & ~LCD_EN;     /* Falling edge latches the nibble */
+    }
+    lcdTxExecUs[lcdTxIndex] = LCD_EXEC_US;
+}
+
+/* End the packet after a slow write, so whatever follows is held back */
+static void LCD_EndSlowWrite(uint16 execUs)
+{
+    lcdTxExecUs[lcdTxIndex] = execUs;
+    LCD_TxSend();
+}
+
+/* Single nibble in its own packet (8-bit mode reset sequence) */
+static void LCD_WriteNibble(uint8 nibble, uint16 execUs)
 {
-    uint8 data = (nibble & 0xF0) | controlBits | LCD_BACKLIGHT;
-    
-    /* Enable Pulse */
-    I2C1_WriteByte(LCD_SLAVE_ADDRESS, data | LCD_EN);
-    Delay_MS(1); /* Small delay for Enable pulse */
-    I2C1_WriteByte(LCD_SLAVE_ADDRESS, data & ~LCD_EN);
-    Delay_MS(1);
+    LCD_QueueNibble(nibble, 0);
+    LCD_EndSlowWrite(execUs);
 }
 
 static void LCD_SendByte(uint8 value, uint8 mode)
@@ -35,68 +174,209 @@ static void LCD_SendByte(uint8 value, uint8 mode)
     uint8 highNibble = value & 0xF0;
     uint8 lowNibble  = (value << 4) & 0xF0;
 
-    LCD_WriteNibble(highNibble, mode);
-    LCD_WriteNibble(lowNibble, mode);
+    LCD_CheckResync();
+    LCD_QueueNibble(highNibble, mode);
+    LCD_QueueNibble(lowNibble, mode);
+    if(lcdBatch == 0) LCD_TxSend();
+}
+
+static void LCD_BatchBegin(void)
+{
+    LCD_CheckResync();
+    lcdBatch++;
+}
+
+static void LCD_BatchEnd(void)
+{
+    if(--lcdBatch == 0) LCD_TxSend();
+}
+
+static void LCD_FillScreen(char (*cells)[LCD_COLS], char c)
+{
+    uint8 row, col;
+    for(row = 0; row < LCD_ROWS; row++)
+    {
+        for(col = 0; col < LCD_COLS; col++) cells[row][col] = c;
+    }
 }
 
 void LCD_SendCommand(uint8 command)
 {
+    LCD_BatchBegin();
     LCD_SendByte(command, 0); /* RS = 0 for Command */
+
+    /* Follow the address counter so data writes can be mirrored */
+    if(command & LCD_CMD_SET_DDRAM)
+    {
+        lcdAddress = command & 0x7F;
+    }
+    else if(command & LCD_CMD_SET_CGRAM)
+    {
+        lcdAddress = LCD_ADDRESS_UNKNOWN;
+    }
+    else if(command == LCD_CMD_CLEAR || command == LCD_CMD_HOME)
+    {
+        if(command == LCD_CMD_CLEAR) LCD_FillScreen(lcdScreen, ' ');
+        lcdAddress = 0;
+
+        /* 1.52 ms execution: far longer than the following bytes */
+        LCD_EndSlowWrite(LCD_CLEAR_US);
+    }
+    LCD_BatchEnd();
 }
 
 void LCD_SendData(uint8 data)
 {
+    uint8 col;
+
     LCD_SendByte(data, LCD_RS); /* RS = 1 for Data */
+
+    if(lcdAddress == LCD_ADDRESS_UNKNOWN) return;
+    col = lcdAddress & 0x3F;
+    if(col < LCD_COLS) lcdScreen[(lcdAddress & 0x40) ? 1 : 0][col] = (char)data;
+
+    /* Line 1 continues into line 2 and back (2-line mode) */
+    lcdAddress++;
+    if(lcdAddress == 0x28) lcdAddress = 0x40;
+    else if(lcdAddress == 0x68) lcdAddress = 0x00;
 }
 
-void LCD_Init(void)
+/* Reset Sequence (Standard HD44780) into 4-bit mode; works from any state,
+ * including half way through a byte */
+static void LCD_Reset(void)
 {
-    /* 1. Initialize I2C1 */
-    I2C1_Init(I2C_BAUDRATE_100K);
-    
-    /* 2. Wait for LCD to power up */
-    Delay_MS(50);
-
-    /* 3. Reset Sequence (Standard HD44780) */
-    LCD_WriteNibble(0x30, 0);
-    Delay_MS(5);
-    LCD_WriteNibble(0x30, 0);
-    Delay_MS(1);
-    LCD_WriteNibble(0x30, 0);
-    Delay_MS(1);
-    
-    /* 4. Set to 4-bit mode */
-    LCD_WriteNibble(0x20, 0);
-    Delay_MS(1);
-
-    /* 5. Configuration */
+    LCD_WriteNibble(0x30, LCD_RESET1_US);
+    LCD_WriteNibble(0x30, LCD_RESET2_US);
+    LCD_WriteNibble(0x30, LCD_EXEC_US);
+
+    /* Set to 4-bit mode */
+    LCD_WriteNibble(0x20, LCD_EXEC_US);
+
+    /* Configuration */
     LCD_SendCommand(0x28); /* Function Set: 4-bit, 2 lines, 5x8 font */
-    LCD_SendCommand(0x0C); /* Display ON, Cursor OFF, Blink OFF */
+    LCD_SendCommand(lcdDisplayCmd);
     LCD_SendCommand(0x06); /* Entry Mode: Auto-increment */
-    LCD_Clear();
+    LCD_Clear();           /* Mirror back in step: the next flush redraws */
+}
+
+void LCD_Init(void)
+{
+    uint32 byteUs;
+
+    /* 1. Initialize I2C1 (other devices at 100 kHz; the LCD at its own rate) */
+    I2C1_Init(I2C_BAUDRATE_100K);
+    byteUs = (9 * 1000000 + I2C1_ActualHz(LCD_I2C_BAUDRATE) - 1) / I2C1_ActualHz(LCD_I2C_BAUDRATE);
+    lcdNibbleBytes = (uint8)((LCD_EXEC_US + 2 * byteUs - 1) / (2 * byteUs));
+    if(lcdNibbleBytes < 2) lcdNibbleBytes = 2;
+    lcdLatchUs = (uint16)(3 * byteUs);     /* Address, EN high, EN low */
+
+    /* 2. LCD power up: the first packet is held until then */
+    lcdReadyUs = TIME_DEADLINE_US(LCD_POWER_UP_US);
+
+    /* 3. Reset Sequence and configuration */
+    LCD_Reset();
+    LCD_FbClear();
 }
 
 void LCD_Clear(void)
 {
-    LCD_SendCommand(0x01); /* Clear Display */
-    Delay_MS(2);           /* This command is slow */
+    LCD_SendCommand(LCD_CMD_CLEAR); /* Clear Display (the next write is held for 1.52 ms) */
+}
+
+void LCD_SetPower(boolean on)
+{
+    backlight = on ? LCD_BACKLIGHT : 0;
+    lcdDisplayCmd = on ? 0x0C : 0x08;
+    LCD_SendCommand(lcdDisplayCmd); /* Display ON / OFF (DDRAM is kept) */
 }
 
 void LCD_SetCursor(uint8 row, uint8 col)
 {
-    uint8 address;
-    if(row == 0)
-        address = 0x80 + col;
-    else
-        address = 0xC0 + col;
-        
-    LCD_SendCommand(address);
+    LCD_SendCommand(LCD_CMD_SET_DDRAM | (LCD_ROW_ADDRESS(row) + col));
 }
 
 void LCD_WriteString(const char *str)
 {
+    LCD_BatchBegin();
     while(*str)
     {
         LCD_SendData(*str++);
     }
+    LCD_BatchEnd();
+}
+
+void LCD_LoadGlyph(uint8 slot, const uint8 *rows)
+{
+    uint8 i;
+
+    /* The address counter is left in CGRAM: the next DDRAM write sets it */
+    LCD_BatchBegin();
+    LCD_SendCommand(LCD_CMD_SET_CGRAM | ((slot & 0x07) << 3));
+    for(i = 0; i < 8; i++) LCD_SendData(rows[i] & 0x1F);
+    LCD_BatchEnd();
+}
+
+void LCD_FbClear(void)
+{
+    LCD_FillScreen(lcdShadow, ' ');
+    fbRow = 0;
+    fbCol = 0;
+}
+
+void LCD_FbSetCursor(uint8 row, uint8 col)
+{
+    fbRow = (row < LCD_ROWS) ? row : (LCD_ROWS - 1);
+    fbCol = col;
+}
+
+void LCD_FbPutChar(char c)
+{
+    /* Clipped at the end of the row; there is no wrap in the framebuffer */
+    if(fbCol >= LCD_COLS) return;
+    lcdShadow[fbRow][fbCol++] = c;
+}
+
+void LCD_FbWriteString(const char *str)
+{
+    while(*str) LCD_FbPutChar(*str++);
+}
+
+uint8 LCD_FbFlush(void)
+{
+    uint8 row, col, end, address;
+    uint8 sent = 0;
+
+    LCD_BatchBegin();
+    for(row = 0; row < LCD_ROWS; row++)
+    {
+        col = 0;
+        while(col < LCD_COLS)
+        {
+            if(lcdShadow[row][col] == lcdScreen[row][col])
+            {
+                col++;
+                continue;
+            }
+
+            /* A run of changed cells; rewriting one unchanged cell costs the
+             * same as the cursor command it saves, so bridge those gaps */
+            end = col + 1;
+            while(end < LCD_COLS)
+            {
+                if(lcdShadow[row][end] != lcdScreen[row][end]) end++;
+                else if(end + 1 < LCD_COLS && lcdShadow[row][end + 1] != lcdScreen[row][end + 1]) end += 2;
+                else break;
+            }
+
+            address = LCD_ROW_ADDRESS(row) + col;
+            if(address != lcdAddress) LCD_SendCommand(LCD_CMD_SET_DDRAM | address);
+            for(; col < end; col++)
+            {
+                LCD_SendData((uint8)lcdShadow[row][col]);
+                sent++;
+            }
+        }
+    }
+    LCD_BatchEnd();
+    return sent;
 }
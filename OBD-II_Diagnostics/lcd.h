@@ -16,6 +16,27 @@
 /* Default I2C Address for PCF8574 is usually 0x27 or 0x3F */
 #define LCD_SLAVE_ADDRESS  0x27
 
+/* SCL rate for the backpack. The PCF8574 is specified for 100 kHz but the
+ * common backpacks run at Fast-mode (400 kHz); a PCA9674 allows Fast-mode
+ * Plus (1000000). Drop to 100000 if characters get lost */
+#define LCD_I2C_BAUDRATE   400000
+
+/* HD44780 execution times in us (270 kHz oscillator). Consecutive bytes
+ * of a packet must allow LCD_EXEC_US; the others end their packet */
+#define LCD_EXEC_US        37
+#define LCD_CLEAR_US       2000     /* Clear / home: 1.52 ms, slow oscillator margin */
+#define LCD_RESET1_US      4100     /* After the first 0x30 of the reset sequence */
+#define LCD_RESET2_US      100      /* After the second */
+#define LCD_POWER_UP_US    50000    /* Vcc to first write */
+
+/* Display geometry */
+#define LCD_ROWS           2
+#define LCD_COLS           16
+
+/* Bytes per I2C transaction: 4 per character (6 at 1 MHz, see lcd.c), so
+ * a full 16-char line plus its cursor command fits in one */
+#define LCD_TX_BUFFER_SIZE 136
+
 /* Public Functions */
 void LCD_Init(void);
 void LCD_SendCommand(uint8 command);
@@ -24,4 +45,23 @@ void LCD_Clear(void);
 void LCD_SetCursor(uint8 row, uint8 col);
 void LCD_WriteString(const char *str);
 
+/* Backlight and display on/off; contents are kept while off */
+void LCD_SetPower(boolean on);
+
+/* Custom characters: 8 CGRAM slots of 5x8 pixels, one byte per row (bits
+ * 4..0, left to right). Print slot n as LCD_GLYPH(n): codes 0x08-0x0F
+ * mirror 0x00-0x07 and keep NUL out of strings */
+#define LCD_GLYPH_SLOTS    8
+#define LCD_GLYPH(slot)    ((char)(0x08 + (slot)))
+void LCD_LoadGlyph(uint8 slot, const uint8 *rows);
+
+/* Shadow framebuffer: draw into RAM with the LCD_Fb* calls (no I2C), then
+ * LCD_FbFlush sends only the cells that differ from what the display shows,
+ * one cursor command per run. Returns the number of characters sent. */
+void LCD_FbClear(void);
+void LCD_FbSetCursor(uint8 row, uint8 col);
+void LCD_FbPutChar(char c);
+void LCD_FbWriteString(const char *str);
+uint8 LCD_FbFlush(void);
+
 #endif /* LCD_H_ */
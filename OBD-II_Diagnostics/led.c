@@ -1,5 +1,6 @@
 #include "led.h"
 #include "gpio.h"
+#include "clock.h"
 #include "tm4c123gh6pm_registers.h"
 
 /* LED Pin Configuration for TM4C123G LaunchPad */
@@ -8,95 +9,250 @@
 #define GREEN_PIN    PIN3     /* PF3 */
 #define LED_PORT     GPIO_PORTF
 
-/* Unlock PORTF for configuration */
-static void unlockPortF(void) {
-    GPIO_PORTF_LOCK_REG = 0x4C4F434Bu; /* Unlock key */
-    GPIO_PORTF_CR_REG = 0x1Fu;         /* Enable commits */
+#define LED_CHANNELS          3u      /* Indexed by LED_RED / LED_BLUE / LED_GREEN */
+#define LED_STATUS_NONE       0xFFu
+
+/* Pattern kinds */
+#define LED_KIND_STEADY       0u
+#define LED_KIND_BLINK        1u
+#define LED_KIND_BREATHE      2u
+#define LED_KIND_FLASH        3u
+
+/* Error-code flashes */
+#define LED_FLASH_ON_MS       150u
+#define LED_FLASH_OFF_MS      250u
+#define LED_FLASH_PAUSE_MS    1200u
+#define LED_FLASH_MAX         15u
+
+typedef struct {
+    uint8 kind;
+    uint8 level;            /* Steady level, or the pattern's peak */
+    uint8 count;            /* FLASH: flashes per cycle */
+    uint8 shown;            /* Level currently on the output */
+    uint16 onMs;            /* BLINK: on time */
+    uint16 cycleMs;         /* Whole pattern, then it repeats */
+    uint16 phaseMs;
+} LED_Channel;
+
+static LED_Channel ledChannels[LED_CHANNELS];
+static uint32 ledLoad = 0;
+static uint8 ledStatus = LED_STATUS_NONE;
+
+static volatile uint32 * const ledCompare[LED_CHANNELS] = {
+    &PWM1_2_CMPB_REG, &PWM1_3_CMPA_REG, &PWM1_3_CMPB_REG
+};
+static const uint8 ledEnable[LED_CHANNELS] = {
+    LED_PWM_ENABLE_RED, LED_PWM_ENABLE_BLUE, LED_PWM_ENABLE_GREEN
+};
+
+/* PF1-3 to M1PWM5-7 */
+static const GPIO_PortConfig ledPinConfig = {
+    LED_PORT, 0u, 0u, RED_PIN | BLUE_PIN | GREEN_PIN, 0u, 0u, 0u,
+    GPIO_PCTL(1, LED_PWM_PCTL) | GPIO_PCTL(2, LED_PWM_PCTL) | GPIO_PCTL(3, LED_PWM_PCTL)
+};
+
+/* Channel state is shared with the tick: keep it out while changing it */
+static void LED_Lock(void)   { NVIC_DIS0_REG = (1u << LED_TIMER_IRQ); }
+static void LED_Unlock(void) { NVIC_EN0_REG = (1u << LED_TIMER_IRQ); }
+
+static void LED_Write(uint8 ch, uint8 level) {
+    uint32 counts;
+
+    ledChannels[ch].shown = level;
+    if(level == 0u) {
+        /* A disabled output is driven low: fully dark, no minimum pulse */
+        PWM1_ENABLE_REG &= ~(uint32)ledEnable[ch];
+        return;
+    }
+
+    /* Duty = level squared, so equal level steps look like equal steps */
+    counts = ((ledLoad + 1u) * level * level) / (LED_LEVEL_MAX * LED_LEVEL_MAX);
+    if(counts == 0u) counts = 1u;
+    *ledCompare[ch] = (counts >= ledLoad) ? 0u : ledLoad - counts;
+    PWM1_ENABLE_REG |= ledEnable[ch];
 }
 
-/* Configure pull-up for PORTF pins */
-static void configurePortFPullUp(uint8 pin) {
-    GPIO_PORTF_PUR_REG |= pin;
+static uint8 LED_PatternLevel(const LED_Channel *c) {
+    uint32 t = c->phaseMs;
+    uint32 half;
+
+    switch(c->kind) {
+        case LED_KIND_BLINK:
+            return (t < c->onMs) ? c->level : 0u;
+        case LED_KIND_BREATHE:
+            half = c->cycleMs / 2u;
+            if(t > half) t = c->cycleMs - t;
+            return (uint8)(((uint32)c->level * t) / half);
+        case LED_KIND_FLASH:
+            if(t >= (uint32)c->count * (LED_FLASH_ON_MS + LED_FLASH_OFF_MS)) return 0u;
+            return ((t % (LED_FLASH_ON_MS + LED_FLASH_OFF_MS)) < LED_FLASH_ON_MS) ? c->level : 0u;
+        default:
+            return c->level;
+    }
+}
+
+static void LED_Start(uint8 color, uint8 kind, uint8 level, uint16 onMs, uint16 cycleMs, uint8 count) {
+    LED_Channel *c;
+    uint8 ch, first, last;
+
+    if(color == LED_ALL) {
+        first = 0u;
+        last = LED_CHANNELS - 1u;
+    } else if(color < LED_CHANNELS) {
+        first = color;
+        last = color;
+    } else {
+        return;
+    }
+
+    LED_Lock();
+    for(ch = first; ch <= last; ch++) {
+        c = &ledChannels[ch];
+        c->kind = kind;
+        c->level = level;
+        c->count = count;
+        c->onMs = onMs;
+        c->cycleMs = cycleMs;
+        c->phaseMs = 0u;
+        LED_Write(ch, LED_PatternLevel(c));
+    }
+    if(kind != LED_KIND_STEADY) TIMER2_CTL_REG |= LED_TIMER_TAEN;
+    LED_Unlock();
 }
 
 void LED_Init(void) {
-    /* Enable clock for PORTF */
-    SYSCTL_RCGCGPIO_REG |= (1u << 5u);
-    
-    /* Wait for clock to be ready */
-    while((SYSCTL_PRGPIO_REG & (1u << 5u)) == 0u);
-    
-    /* Unlock PORTF */
-    unlockPortF();
-    
-    /* Initialize LEDs as outputs */
-    GPIO_InitPin(LED_PORT, RED_PIN, GPIO_OUTPUT);
-    GPIO_InitPin(LED_PORT, BLUE_PIN, GPIO_OUTPUT);
-    GPIO_InitPin(LED_PORT, GREEN_PIN, GPIO_OUTPUT);
-    
-    /* Turn off all LEDs initially */
-    LED_Off(LED_ALL);
+    uint8 ch;
+
+    /* 1. PWM1 from the system clock / 8 */
+    SYSCTL_RCGCPWM_REG |= 0x02u;
+    while((SYSCTL_PRPWM_REG & 0x02u) == 0u);
+    SYSCTL_RCC_REG = (SYSCTL_RCC_REG & ~SYSCTL_RCC_PWMDIV_M) | SYSCTL_RCC_USEPWMDIV | SYSCTL_RCC_PWMDIV_8;
+
+    /* 2. PF1-3 as PWM outputs */
+    GPIO_Configure(&ledPinConfig, 1u);
+
+    /* 3. Generators 2 and 3 counting down at LED_PWM_HZ, outputs off */
+    ledLoad = Clock_GetHz() / 8u / LED_PWM_HZ - 1u;
+    PWM1_ENABLE_REG &= ~(uint32)(LED_PWM_ENABLE_RED | LED_PWM_ENABLE_BLUE | LED_PWM_ENABLE_GREEN);
+    PWM1_2_CTL_REG = 0u;
+    PWM1_3_CTL_REG = 0u;
+    PWM1_2_GENB_REG = PWM_GENB_DOWN;
+    PWM1_3_GENA_REG = PWM_GENA_DOWN;
+    PWM1_3_GENB_REG = PWM_GENB_DOWN;
+    PWM1_2_LOAD_REG = ledLoad;
+    PWM1_3_LOAD_REG = ledLoad;
+    PWM1_2_CTL_REG = PWM_CTL_ENABLE;
+    PWM1_3_CTL_REG = PWM_CTL_ENABLE;
+
+    /* 4. Timer 2A pattern tick, started by the first pattern */
+    SYSCTL_RCGCTIMER_REG |= 0x04u;
+    while((SYSCTL_PRTIMER_REG & 0x04u) == 0u);
+    TIMER2_CTL_REG = 0u;
+    TIMER2_CFG_REG = 0u;
+    TIMER2_TAMR_REG = LED_TIMER_PERIODIC;
+    TIMER2_TAILR_REG = (Clock_GetHz() / 1000u) * LED_TICK_MS - 1u;
+    TIMER2_ICR_REG = LED_TIMER_TATO;
+    TIMER2_IMR_REG = LED_TIMER_TATO;
+
+    for(ch = 0u; ch < LED_CHANNELS; ch++) {
+        ledChannels[ch].kind = LED_KIND_STEADY;
+        ledChannels[ch].level = 0u;
+        ledChannels[ch].shown = 0u;
+    }
+    ledStatus = LED_STATUS_NONE;
+
+    /* Priority 3: IRQ 23 is PRI5 bits 31:29 */
+    NVIC_PRI5_REG = (NVIC_PRI5_REG & ~0xE0000000u) | (LED_IRQ_PRIORITY << 29);
+    NVIC_EN0_REG = (1u << LED_TIMER_IRQ);
+}
+
+void LED_SetLevel(uint8 color, uint8 level) {
+    LED_Start(color, LED_KIND_STEADY, level, 0u, 0u, 0u);
 }
 
 void LED_On(uint8 color) {
-    switch(color) {
-        case LED_RED:
-            GPIO_WritePin(LED_PORT, RED_PIN, GPIO_HIGH);
-            break;
-        case LED_BLUE:
-            GPIO_WritePin(LED_PORT, BLUE_PIN, GPIO_HIGH);
-            break;
-        case LED_GREEN:
-            GPIO_WritePin(LED_PORT, GREEN_PIN, GPIO_HIGH);
-            break;
-        case LED_ALL:
-            GPIO_WritePin(LED_PORT, RED_PIN, GPIO_HIGH);
-            GPIO_WritePin(LED_PORT, BLUE_PIN, GPIO_HIGH);
-            GPIO_WritePin(LED_PORT, GREEN_PIN, GPIO_HIGH);
-            break;
-        default:
-            break;
-    }
+    LED_SetLevel(color, LED_LEVEL_MAX);
 }
 
 void LED_Off(uint8 color) {
-    switch(color) {
-        case LED_RED:
-            GPIO_WritePin(LED_PORT, RED_PIN, GPIO_LOW);
-            break;
-        case LED_BLUE:
-            GPIO_WritePin(LED_PORT, BLUE_PIN, GPIO_LOW);
-            break;
-        case LED_GREEN:
-            GPIO_WritePin(LED_PORT, GREEN_PIN, GPIO_LOW);
-            break;
-        case LED_ALL:
-            GPIO_WritePin(LED_PORT, RED_PIN, GPIO_LOW);
-            GPIO_WritePin(LED_PORT, BLUE_PIN, GPIO_LOW);
-            GPIO_WritePin(LED_PORT, GREEN_PIN, GPIO_LOW);
-            break;
-        default:
-            break;
-    }
+    LED_SetLevel(color, 0u);
 }
 
 void LED_Toggle(uint8 color) {
-    switch(color) {
-        case LED_RED:
-            GPIO_TogglePin(LED_PORT, RED_PIN);
+    uint8 ch = (color == LED_ALL) ? LED_RED : color;
+
+    if(ch >= LED_CHANNELS) return;
+    LED_SetLevel(color, (ledChannels[ch].shown != 0u) ? 0u : LED_LEVEL_MAX);
+}
+
+void LED_Blink(uint8 color, uint8 level, uint16 onMs, uint16 offMs) {
+    LED_Start(color, LED_KIND_BLINK, level, onMs, onMs + offMs, 0u);
+}
+
+void LED_Breathe(uint8 color, uint8 level, uint16 periodMs) {
+    if(periodMs < 2u * LED_TICK_MS) periodMs = 2u * LED_TICK_MS;
+    LED_Start(color, LED_KIND_BREATHE, level, 0u, periodMs, 0u);
+}
+
+void LED_Flash(uint8 color, uint8 level, uint8 count) {
+    if(count == 0u) count = 1u;
+    if(count > LED_FLASH_MAX) count = LED_FLASH_MAX;
+    LED_Start(color, LED_KIND_FLASH, level, 0u,
+              (uint16)(count * (LED_FLASH_ON_MS + LED_FLASH_OFF_MS) + LED_FLASH_PAUSE_MS), count);
+}
+
+void LED_ShowStatus(uint8 status) {
+    if(status == ledStatus) return;
+    ledStatus = status;
+
+    LED_Off(LED_ALL);
+    switch(status) {
+        case LED_STATUS_CONNECTING:
+            LED_Breathe(LED_BLUE, LED_LEVEL_MAX, 2000u);
+            break;
+        case LED_STATUS_CONNECTED:
+            LED_SetLevel(LED_GREEN, LED_LEVEL_DIM);
             break;
-        case LED_BLUE:
-            GPIO_TogglePin(LED_PORT, BLUE_PIN);
+        case LED_STATUS_BUS_ERROR:
+            LED_Flash(LED_RED, LED_LEVEL_MAX, 2u);
             break;
-        case LED_GREEN:
-            GPIO_TogglePin(LED_PORT, GREEN_PIN);
+        case LED_STATUS_LOGGING:
+            LED_Blink(LED_GREEN, LED_LEVEL_MAX, 60u, 1940u);
             break;
-        case LED_ALL:
-            GPIO_TogglePin(LED_PORT, RED_PIN);
-            GPIO_TogglePin(LED_PORT, BLUE_PIN);
-            GPIO_TogglePin(LED_PORT, GREEN_PIN);
+        case LED_STATUS_OVERFLOW:
+            LED_Blink(LED_RED, LED_LEVEL_MAX, 100u, 100u);
             break;
         default:
             break;
     }
 }
+
+void LED_RestoreStatus(void) {
+    uint8 status = ledStatus;
+
+    ledStatus = LED_STATUS_NONE;
+    if(status == LED_STATUS_NONE) LED_Off(LED_ALL);
+    else LED_ShowStatus(status);
+}
+
+void Timer2A_Handler(void) {
+    LED_Channel *c;
+    boolean running = FALSE;
+    uint8 ch, level;
+
+    TIMER2_ICR_REG = LED_TIMER_TATO;
+
+    for(ch = 0u; ch < LED_CHANNELS; ch++) {
+        c = &ledChannels[ch];
+        if(c->kind == LED_KIND_STEADY) continue;
+
+        c->phaseMs += LED_TICK_MS;
+        if(c->phaseMs >= c->cycleMs) c->phaseMs = 0u;
+        level = LED_PatternLevel(c);
+        if(level != c->shown) LED_Write(ch, level);
+        running = TRUE;
+    }
+
+    /* Every channel steady: no tick until the next pattern */
+    if(!running) TIMER2_CTL_REG &= ~LED_TIMER_TAEN;
+}
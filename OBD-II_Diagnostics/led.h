@@ -3,6 +3,61 @@
 
 #include "std_types.h"
 
+/*
+ * The RGB LED on PF1-3 is driven by PWM module 1 (M1PWM5-7), so each
+ * color has a brightness, and patterns (blink, breathe, N-flash codes) run
+ * from a 10 ms Timer 2A tick. Nothing here waits: a pattern keeps running
+ * while the CPU is busy or asleep, and the tick stops when every channel
+ * is steady.
+ */
+
+/* PWM1 registers, not in tm4c123gh6pm_registers.h (generator n at 0x40 + 0x40n) */
+#define PWM1_ENABLE_REG        (*((volatile uint32 *)0x40029008))
+#define PWM1_2_CTL_REG         (*((volatile uint32 *)0x400290C0))
+#define PWM1_2_LOAD_REG        (*((volatile uint32 *)0x400290D0))
+#define PWM1_2_CMPB_REG        (*((volatile uint32 *)0x400290DC))
+#define PWM1_2_GENB_REG        (*((volatile uint32 *)0x400290E4))
+#define PWM1_3_CTL_REG         (*((volatile uint32 *)0x40029100))
+#define PWM1_3_LOAD_REG        (*((volatile uint32 *)0x40029110))
+#define PWM1_3_CMPA_REG        (*((volatile uint32 *)0x40029118))
+#define PWM1_3_CMPB_REG        (*((volatile uint32 *)0x4002911C))
+#define PWM1_3_GENA_REG        (*((volatile uint32 *)0x40029120))
+#define PWM1_3_GENB_REG        (*((volatile uint32 *)0x40029124))
+
+/* Timer 2A (16/32-bit) registers */
+#define TIMER2_CFG_REG         (*((volatile uint32 *)0x40032000))
+#define TIMER2_TAMR_REG        (*((volatile uint32 *)0x40032004))
+#define TIMER2_CTL_REG         (*((volatile uint32 *)0x4003200C))
+#define TIMER2_IMR_REG         (*((volatile uint32 *)0x40032018))
+#define TIMER2_ICR_REG         (*((volatile uint32 *)0x40032024))
+#define TIMER2_TAILR_REG       (*((volatile uint32 *)0x40032028))
+
+#define LED_TIMER_PERIODIC     0x00000002u  /* TAMR */
+#define LED_TIMER_TAEN         0x00000001u  /* CTL */
+#define LED_TIMER_TATO         0x00000001u  /* IMR / ICR time-out */
+
+#define PWM_CTL_ENABLE         0x00000001u
+#define PWM_GENA_DOWN          0x0000008Cu  /* High at LOAD, low at CMPA going down */
+#define PWM_GENB_DOWN          0x0000080Cu  /* High at LOAD, low at CMPB going down */
+#define SYSCTL_RCC_USEPWMDIV   0x00100000u
+#define SYSCTL_RCC_PWMDIV_M    0x000E0000u
+#define SYSCTL_RCC_PWMDIV_8    0x00040000u
+
+/* M1PWM5 (PF1 red) = gen 2 B, M1PWM6 (PF2 blue) = gen 3 A, M1PWM7 (PF3 green) = gen 3 B */
+#define LED_PWM_ENABLE_RED     (1u << 5)
+#define LED_PWM_ENABLE_BLUE    (1u << 6)
+#define LED_PWM_ENABLE_GREEN   (1u << 7)
+#define LED_PWM_PCTL           5u
+
+#define LED_PWM_HZ             1000u    /* PWM clock = system clock / 8 */
+#define LED_TICK_MS            10u
+#define LED_TIMER_IRQ          23u      /* Timer 2A */
+#define LED_IRQ_PRIORITY       3u
+
+/* Brightness */
+#define LED_LEVEL_MAX          255u
+#define LED_LEVEL_DIM          48u
+
 /* LED Colors */
 typedef enum {
     LED_RED,
@@ -11,12 +66,38 @@ typedef enum {
     LED_ALL
 } LED_Color;
 
+/* Device states, each with its own look */
+#define LED_STATUS_OFF         0u
+#define LED_STATUS_CONNECTING  1u   /* Blue breathing */
+#define LED_STATUS_CONNECTED   2u   /* Dim steady green */
+#define LED_STATUS_BUS_ERROR   3u   /* Red, 2 flashes then a pause */
+#define LED_STATUS_LOGGING     4u   /* Green heartbeat blink */
+#define LED_STATUS_OVERFLOW    5u   /* Fast red blink */
+
 /* LED Functions */
 void LED_Init(void);
 void LED_On(uint8 color);
 void LED_Off(uint8 color);
 void LED_Toggle(uint8 color);
 
+/* Steady brightness 0..LED_LEVEL_MAX (perceptual: squared to duty);
+ * stops any pattern on that color, as do On/Off/Toggle */
+void LED_SetLevel(uint8 color, uint8 level);
+
+/* Patterns at 'level', until the next call for that color */
+void LED_Blink(uint8 color, uint8 level, uint16 onMs, uint16 offMs);
+void LED_Breathe(uint8 color, uint8 level, uint16 periodMs);
+void LED_Flash(uint8 color, uint8 level, uint8 count);  /* Error code: count flashes, pause, repeat */
+
+/* Show a LED_STATUS_*: sets all three colors; no restart if already shown */
+void LED_ShowStatus(uint8 status);
+
+/* Start the current status again, after On/Off/SetLevel drew over it */
+void LED_RestoreStatus(void);
+
+/* Pattern tick (tm4c123gh6pm_startup_ccs.c) */
+void Timer2A_Handler(void);
+
 /* Simple Macros */
 #define RED_ON()      LED_On(LED_RED)
 #define RED_OFF()     LED_Off(LED_RED)
@@ -0,0 +1,426 @@
+/******************************************************************************
+ *
+ * Module: Log
+ *
+ * File Name: log.c
+ *
+ * Description: Source file for the flash signal log
+ * Records are encoded into one of two 1 KB RAM pages; Log_Service later
+ * erases the target page and programs the finished words, so appending
+ * never waits on the flash. A page is only reused after the other 191.
+ *
+ *******************************************************************************/
+
+#include "log.h"
+#include "codec.h"
+#include "tm4c123gh6pm_registers.h"
+
+#define LOG_STAGE_FREE      0u
+#define LOG_STAGE_FILLING   1u      /* Taking records; full words may be programmed */
+#define LOG_STAGE_SEALED    2u      /* Full: the rest is programmed, then freed */
+
+#define LOG_ERASED_WORD     0xFFFFFFFFu
+
+typedef struct {
+    uint32 words[LOG_PAGE_WORDS];
+    uint32 addr;
+    uint16 used;            /* Bytes */
+    uint16 programmed;      /* Words */
+    uint8 state;
+    boolean erased;
+} Log_Stage;
+
+static Log_Stage logStages[2];
+static uint8 logFill = 1;   /* Stage taking records (when FILLING) */
+static uint8 logProg = 0;   /* Stage being programmed (when not FREE) */
+static uint32 logHead;      /* Newest page started */
+static uint32 logSeq;
+static Log_Context logWriter;
+static Log_Stats logStats;
+static Log_MirrorFn logMirror = NULL_PTR;
+
+/*******************************************************************************
+ * Signals                                   *
+ *******************************************************************************/
+
+/* The signal's channel in this page, added while there is room. Past
+ * LOG_MAX_SIGNALS the spare channel is reset each time, so those signals
+ * are stored as key frames (writer and reader apply the same rule) */
+static Codec_Channel *Log_Channel(Log_Context *ctx, uint8 signal)
+{
+    uint8 i;
+
+    for(i = 0; i < ctx->count; i++)
+    {
+        if(ctx->ids[i] == signal) return &ctx->channels[i];
+    }
+    if(ctx->count < LOG_MAX_SIGNALS)
+    {
+        ctx->ids[ctx->count] = signal;
+        Codec_Reset(&ctx->channels[ctx->count]);
+        return &ctx->channels[ctx->count++];
+    }
+    Codec_Reset(&ctx->spare);
+    return &ctx->spare;
+}
+
+static uint8 Log_PendingRuns(const Log_Context *ctx)
+{
+    uint8 i, n = 0;
+
+    for(i = 0; i < ctx->count; i++)
+    {
+        if(ctx->channels[i].run > 0u) n++;
+    }
+    return n;
+}
+
+/*******************************************************************************
+ * Flash                                   *
+ *******************************************************************************/
+
+/* One FMC command; the CPU stalls on any flash fetch until it is done */
+static void Log_FlashCommand(uint32 addr, uint32 command)
+{
+    uint32 key = (FLASH_BOOTCFG_REG & LOG_BOOTCFG_KEY) ? LOG_FMC_KEY_BOOTCFG : LOG_FMC_KEY_DEFAULT;
+
+    FLASH_FMA_REG = addr;
+    FLASH_FMC_REG = key | command;
+    while(FLASH_FMC_REG & command);
+
+    if(FLASH_FCRIS_REG & LOG_FCRIS_ERRORS)
+    {
+        FLASH_FCMISC_REG = LOG_FCRIS_ERRORS;
+        logStats.errors++;
+    }
+}
+
+/* A page that is still blank from its last erase is not erased again;
+ * TRUE if the erase ran */
+static boolean Log_ErasePage(uint32 addr)
+{
+    const volatile uint32 *flash = (const volatile uint32 *)addr;
+    uint16 i;
+
+    for(i = 0; i < LOG_PAGE_WORDS; i++)
+    {
+        if(flash[i] != LOG_ERASED_WORD) break;
+    }
+    if(i == LOG_PAGE_WORDS) return FALSE;
+
+    Log_FlashCommand(addr, LOG_FMC_ERASE);
+    logStats.erases++;
+    return TRUE;
+}
+
+static void Log_ProgramWord(uint32 addr, uint32 word)
+{
+    FLASH_FMD_REG = word;
+    Log_FlashCommand(addr, LOG_FMC_WRITE);
+}
+
+/* The page's bytes: its staging copy while it has one, else the flash */
+static const uint8 *Log_PageBytes(uint32 addr)
+{
+    uint8 i;
+
+    for(i = 0; i < 2u; i++)
+    {
+        if(logStages[i].state != LOG_STAGE_FREE && logStages[i].addr == addr)
+        {
+            return (const uint8 *)logStages[i].words;
+        }
+    }
+    return (const uint8 *)addr;
+}
+
+static uint32 Log_NextPage(uint32 addr)
+{
+    addr += LOG_PAGE_SIZE;
+    return (addr >= LOG_FLASH_END) ? LOG_FLASH_START : addr;
+}
+
+static uint32 Log_Word(const uint8 *page, uint16 offset)
+{
+    return (uint32)page[offset] | ((uint32)page[offset + 1] << 8) |
+           ((uint32)page[offset + 2] << 16) | ((uint32)page[offset + 3] << 24);
+}
+
+/*******************************************************************************
+ * Writer                                   *
+ *******************************************************************************/
+
+static Log_Stage *Log_OpenPage(uint32 timeMs)
+{
+    Log_Stage *stage = &logStages[logFill ^ 1u];
+    uint16 i;
+
+    if(stage->state != LOG_STAGE_FREE) return NULL_PTR;
+
+    logFill ^= 1u;
+    logHead = Log_NextPage(logHead);
+
+    for(i = 0; i < LOG_PAGE_WORDS; i++) stage->words[i] = LOG_ERASED_WORD;
+    stage->words[0] = LOG_PAGE_MAGIC;
+    stage->words[1] = ++logSeq;
+    stage->words[2] = timeMs;
+    stage->addr = logHead;
+    stage->used = LOG_HEADER_SIZE;
+    stage->programmed = 0;
+    stage->erased = FALSE;
+    stage->state = LOG_STAGE_FILLING;
+
+    logWriter.count = 0;
+    logWriter.baseMs = timeMs;
+    logStats.pages++;
+    return stage;
+}
+
+void Log_Init(void)
+{
+    const volatile uint32 *page;
+    boolean found = FALSE;
+    uint32 addr;
+
+    /* Newest = highest sequence number among the pages with a header */
+    logSeq = 0;
+    logHead = LOG_FLASH_END - LOG_PAGE_SIZE;
+    for(addr = LOG_FLASH_START; addr < LOG_FLASH_END; addr += LOG_PAGE_SIZE)
+    {
+        page = (const volatile uint32 *)addr;
+        if(page[0] == LOG_PAGE_MAGIC && (!found || page[1] > logSeq))
+        {
+            found = TRUE;
+            logSeq = page[1];
+            logHead = addr;
+        }
+    }
+
+    logStages[0].state = LOG_STAGE_FREE;
+    logStages[1].state = LOG_STAGE_FREE;
+    logFill = 1;
+    logProg = 0;
+    logWriter.count = 0;
+
+    logStats.records = 0;
+    logStats.bytes = 0;
+    logStats.pages = 0;
+    logStats.erases = 0;
+    logStats.drops = 0;
+    logStats.errors = 0;
+}
+
+static void Log_Put(Log_Stage *stage, const uint8 *record, uint8 len)
+{
+    uint8 i;
+
+    for(i = 0; i < len; i++) ((uint8 *)stage->words)[stage->used + i] = record[i];
+    stage->used += len;
+    logStats.bytes += len;
+}
+
+/* Repeats still held by the codec go into this page before it closes */
+static void Log_FlushRuns(Log_Stage *stage)
+{
+    uint8 record[LOG_FLUSH_MAX];
+    uint8 i, len;
+
+    for(i = 0; i < logWriter.count; i++)
+    {
+        record[0] = logWriter.ids[i];
+        len = Codec_Flush(&logWriter.channels[i], &record[1]);
+        if(len > 0u) Log_Put(stage, record, (uint8)(len + 1u));
+    }
+}
+
+boolean Log_Append(uint8 signal, sint32 value, uint32 timeMs)
+{
+    Log_Stage *stage = &logStages[logFill];
+    Codec_Channel *ch;
+    Codec_Channel next;
+    uint8 record[LOG_RECORD_MAX];
+    uint8 len, pending;
+
+    if(signal == LOG_SIGNAL_END) return FALSE;
+
+    if(stage->state == LOG_STAGE_FILLING)
+    {
+        /* Try it on a copy: it must fit with room left for every pending run */
+        ch = Log_Channel(&logWriter, signal);
+        next = *ch;
+        len = Codec_Encode(&next, value, timeMs, logWriter.baseMs, &record[1]);
+        pending = Log_PendingRuns(&logWriter) - ((ch->run > 0u) ? 1u : 0u) + ((next.run > 0u) ? 1u : 0u);
+        if(stage->used + (len ? len + 1u : 0u) + pending * LOG_FLUSH_MAX > LOG_PAGE_SIZE)
+        {
+            Log_FlushRuns(stage);
+            stage->state = LOG_STAGE_SEALED;
+        }
+    }
+    if(stage->state != LOG_STAGE_FILLING)
+    {
+        /* New page: every signal starts again with a key frame */
+        stage = Log_OpenPage(timeMs);
+        if(stage == NULL_PTR)
+        {
+            logStats.drops++;
+            return FALSE;
+        }
+        ch = Log_Channel(&logWriter, signal);
+        next = *ch;
+        len = Codec_Encode(&next, value, timeMs, logWriter.baseMs, &record[1]);
+    }
+
+    *ch = next;
+    if(len > 0u)
+    {
+        record[0] = signal;
+        Log_Put(stage, record, (uint8)(len + 1u));
+    }
+    logStats.records++;
+    return TRUE;
+}
+
+uint16 Log_Service(boolean busQuiet)
+{
+    Log_Stage *stage = &logStages[logProg];
+    uint16 budget = busQuiet ? LOG_QUIET_WORDS : LOG_BUSY_WORDS;
+    uint16 done = 0, ready;
+    uint32 word;
+
+    while(stage->state != LOG_STAGE_FREE)
+    {
+        /* An erase is the whole call: it already holds SysTick off */
+        if(!stage->erased)
+        {
+            if(!busQuiet || done > 0u) break;
+            stage->erased = TRUE;
+            if(Log_ErasePage(stage->addr)) break;
+        }
+
+        /* Only whole words: the last one of a filling page may still grow */
+        ready = (stage->state == LOG_STAGE_SEALED) ? LOG_PAGE_WORDS : stage->used / 4u;
+        while(stage->programmed < ready && done < budget)
+        {
+            word = stage->words[stage->programmed];
+            if(word != LOG_ERASED_WORD)
+            {
+                Log_ProgramWord(stage->addr + stage->programmed * 4u, word);
+                done++;
+            }
+            stage->programmed++;
+        }
+        if(stage->state != LOG_STAGE_SEALED || stage->programmed < LOG_PAGE_WORDS) break;
+
+        if(logMirror != NULL_PTR) (void)logMirror((const uint8 *)stage->words, LOG_PAGE_SIZE);
+        stage->state = LOG_STAGE_FREE;
+        logProg ^= 1u;
+        stage = &logStages[logProg];
+    }
+    return done;
+}
+
+void Log_SetMirror(Log_MirrorFn mirror)
+{
+    logMirror = mirror;
+}
+
+void Log_Flush(void)
+{
+    Log_Stage *stage = &logStages[logFill];
+
+    if(stage->state == LOG_STAGE_FILLING)
+    {
+        Log_FlushRuns(stage);
+        stage->state = LOG_STAGE_SEALED;
+    }
+    while(logStages[logProg].state != LOG_STAGE_FREE) (void)Log_Service(TRUE);
+}
+
+/*******************************************************************************
+ * Read-back                                   *
+ *******************************************************************************/
+
+void Log_ReadBegin(Log_Reader *reader)
+{
+    /* The page after the newest is the oldest one */
+    reader->page = logHead;
+    reader->offset = LOG_PAGE_SIZE;
+    reader->pagesLeft = LOG_PAGE_COUNT;
+    reader->group.run = 0;
+    reader->runDone = 0;
+    reader->pending = FALSE;
+}
+
+/* Hand out the current token's samples, then read the next token. A run
+ * token stands for samples taken before the records stored ahead of it,
+ * so the order is per signal only (log.h) */
+static boolean Log_Decode(Log_Reader *reader, Log_Record *record)
+{
+    Codec_Group *group = &reader->group;
+    const uint8 *page;
+    uint8 used;
+
+    for(;;)
+    {
+        record->signal = reader->signal;
+        if(reader->runDone < group->run)
+        {
+            record->value = group->runValue;
+            record->timeMs = group->runStartMs + (uint32)reader->runDone * group->periodMs;
+            reader->runDone++;
+            return TRUE;
+        }
+        if(reader->pending)
+        {
+            record->value = group->value;
+            record->timeMs = group->timeMs;
+            reader->pending = FALSE;
+            return TRUE;
+        }
+
+        page = Log_PageBytes(reader->page);
+        if(reader->offset + 1u >= LOG_PAGE_SIZE || page[reader->offset] == LOG_SIGNAL_END) return FALSE;
+        reader->signal = page[reader->offset];
+        used = Codec_Decode(Log_Channel(&reader->ctx, reader->signal), &page[reader->offset + 1u],
+                            (uint16)(LOG_PAGE_SIZE - reader->offset - 1u), reader->ctx.baseMs, group);
+        if(used == 0u) return FALSE;
+
+        reader->offset += (uint16)(used + 1u);
+        reader->runDone = 0;
+        reader->pending = TRUE;
+    }
+}
+
+boolean Log_ReadNext(Log_Reader *reader, Log_Record *record)
+{
+    const uint8 *page;
+
+    for(;;)
+    {
+        if(Log_Decode(reader, record)) return TRUE;
+        if(reader->pagesLeft == 0) return FALSE;
+
+        reader->pagesLeft--;
+        reader->page = Log_NextPage(reader->page);
+        reader->offset = LOG_PAGE_SIZE;
+
+        page = Log_PageBytes(reader->page);
+        if(Log_Word(page, 0) != LOG_PAGE_MAGIC) continue;
+        reader->offset = LOG_HEADER_SIZE;
+        reader->ctx.count = 0;
+        reader->ctx.baseMs = Log_Word(page, 8);
+    }
+}
+
+void Log_GetStats(Log_Stats *stats)
+{
+    *stats = logStats;
+}
+
+uint32 Log_RecordsPerKb(void)
+{
+    uint32 used = logStats.bytes + logStats.pages * LOG_HEADER_SIZE;
+
+    if(used == 0) return 0;
+    return (uint32)(((uint64)logStats.records * 1024u) / used);
+}
@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ * Module: Log
+ *
+ * File Name: log.h
+ *
+ * Description: Header file for the signal log kept in the upper on-chip
+ * flash (0x10000-0x3FFFF, 192 pages of 1 KB; the linker file keeps code
+ * below it). Pages are written in address order and reused oldest first,
+ * so every page is erased once per pass over the region.
+ *
+ * Page:    MAGIC32 | SEQ32 | START_MS32 | records... | 0xFF (erased) to the end
+ * Record:  SIGNAL8 | codec token (codec.h)
+ *          Each signal's first token in a page is a key frame relative to
+ *          START_MS, so any page decodes alone. Records never span pages.
+ *
+ * Size:    with a 100 ms poll, a changing signal (RPM, speed) takes 2-3
+ *          bytes a sample and a steady one (coolant, voltage) 3 bytes per
+ *          run of up to 65 samples: the four built-in PIDs average about
+ *          1.4 bytes a sample, ~740 samples per KB, ~140000 in the region.
+ *          At 4 PIDs every 100 ms that is about an hour.
+ *
+ *******************************************************************************/
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include "std_types.h"
+#include "codec.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define LOG_FLASH_START         0x00010000u
+#define LOG_FLASH_END           0x00040000u
+#define LOG_PAGE_SIZE           1024u
+#define LOG_PAGE_WORDS          (LOG_PAGE_SIZE / 4u)
+#define LOG_PAGE_COUNT          ((LOG_FLASH_END - LOG_FLASH_START) / LOG_PAGE_SIZE)
+#define LOG_HEADER_SIZE         12u
+#define LOG_PAGE_MAGIC          0x31474F4Cu     /* "LOG1" */
+
+#define LOG_MAX_SIGNALS         16u     /* Compressed per page; more are stored as key frames */
+#define LOG_SIGNAL_END          0xFFu   /* Erased flash: not a valid signal */
+#define LOG_RECORD_MAX          (1u + CODEC_GROUP_MAX)
+#define LOG_FLUSH_MAX           (1u + CODEC_FLUSH_MAX)  /* Room kept for each pending run */
+
+/* Words programmed per Log_Service call when the bus may be busy, and
+ * when it is quiet (kept well under one 1 ms tick) */
+#define LOG_BUSY_WORDS          2u
+#define LOG_QUIET_WORDS         16u
+
+/* Flash controller (FMC write key from BOOTCFG, FCRIS error flags) */
+#define LOG_FMC_WRITE           0x00000001u
+#define LOG_FMC_ERASE           0x00000002u
+#define LOG_FMC_KEY_DEFAULT     0x71D50000u
+#define LOG_FMC_KEY_BOOTCFG     0xA4420000u
+#define LOG_BOOTCFG_KEY         0x00000010u
+#define LOG_FCRIS_ERRORS        0x00002E01u     /* PROG, ERR, INVDR, VOLT, ACCESS */
+
+/*******************************************************************************
+ * Types                                   *
+ *******************************************************************************/
+
+typedef struct {
+    uint32 timeMs;
+    sint32 value;
+    uint8 signal;
+} Log_Record;
+
+/* Per-page codec state, the same for the writer and a reader */
+typedef struct {
+    uint32 baseMs;          /* START_MS of the page */
+    Codec_Channel channels[LOG_MAX_SIGNALS];
+    Codec_Channel spare;    /* Signals beyond LOG_MAX_SIGNALS, reset every time */
+    uint8 ids[LOG_MAX_SIGNALS];
+    uint8 count;
+} Log_Context;
+
+typedef struct {
+    uint32 page;            /* Address of the page being read */
+    uint16 offset;
+    uint16 pagesLeft;
+    Log_Context ctx;
+    Codec_Group group;      /* Last token read, handed out one sample at a time */
+    uint8 signal;
+    uint8 runDone;
+    boolean pending;        /* group.value not handed out yet */
+} Log_Reader;
+
+/* Gets every page once it is in the flash, e.g. Storage_Append for a
+ * longer copy on external storage */
+typedef boolean (*Log_MirrorFn)(const uint8 *data, uint16 length);
+
+typedef struct {
+    uint32 records;         /* Samples */
+    uint32 bytes;           /* Record bytes, headers not included */
+    uint32 pages;           /* Pages started */
+    uint32 erases;
+    uint32 drops;           /* Both staging pages were full */
+    uint32 errors;          /* Flash controller faults */
+} Log_Stats;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Find the newest page; writing resumes in the page after it */
+void Log_Init(void);
+
+/* Encode one value into the RAM staging page. Never touches the flash, so
+ * it is safe at any time; FALSE (and counted) if both pages are waiting */
+boolean Log_Append(uint8 signal, sint32 value, uint32 timeMs);
+
+/* Write-behind: copy staged words to the flash. Erasing or programming
+ * stalls every fetch from flash, interrupts included, so pass busQuiet only
+ * when no CAN traffic is due (just after an answer). A quiet call either
+ * erases the next page or programs up to LOG_QUIET_WORDS words; otherwise
+ * at most LOG_BUSY_WORDS words are programmed and nothing is erased.
+ * Returns the number of words programmed. */
+uint16 Log_Service(boolean busQuiet);
+
+void Log_SetMirror(Log_MirrorFn mirror);
+
+/* Close the current page, pending runs included, and write everything
+ * out (before sleep) */
+void Log_Flush(void);
+
+/* Read back page by page, oldest to newest, including records not yet in
+ * the flash (samples still held in a run appear once it is written). Each
+ * signal comes out in time order, but signals are not merged: a run is
+ * written when it ends, so within a page one signal's samples can come
+ * up to 64 samples late relative to another's. Sort by timeMs to merge */
+void Log_ReadBegin(Log_Reader *reader);
+boolean Log_ReadNext(Log_Reader *reader, Log_Record *record);
+
+void Log_GetStats(Log_Stats *stats);
+
+/* Samples per KB of flash so far, page headers included */
+uint32 Log_RecordsPerKb(void);
+
+#endif /* LOG_H_ */
@@ -5,83 +5,256 @@
 #include "pushbutton.h"
 #include "led.h"
 #include "delay.h"
+#include "timebase.h"
+#include "sched.h"
+#include "power.h"
+#include "clock.h"
+#include "i2c.h"
+#include "screen.h"
+#include "log.h"
+#include "storage.h"
 
-/* Application States */
-typedef enum {
-    STATE_SHOW_RPM,
-    STATE_SHOW_SPEED,
-    STATE_SHOW_COOLANT,
-    STATE_SHOW_VOLTAGE,
-    STATE_MAX_STATES
-} AppState_t;
-
-/* --- LCD Helper Functions --- */
-void LCD_PrintInt(sint32 num)
+/* No answer for this long: the ignition is off, let the bus and LCD sleep */
+#define APP_IGNITION_OFF_MS     30000
+
+/* Full scale of the RPM bar (7 cells, 36 levels) */
+#define APP_RPM_BAR_MAX         8000
+
+/* --- Screens: SW1 / SW2 step through them in table order --- */
+static const Screen_Field rpmFields[] = {
+    /* pid            row col width dec kind                unit       barMax */
+    { OBD_PID_RPM,      1,  0,  4,   0,  SCREEN_FIELD_VALUE, " rpm",    0 },
+    { OBD_PID_RPM,      1,  9,  7,   0,  SCREEN_FIELD_BAR,   NULL_PTR,  APP_RPM_BAR_MAX },
+};
+static const Screen_Field speedFields[] = {
+    { OBD_PID_SPEED,    1,  0,  3,   0,  SCREEN_FIELD_VALUE, " km/h",   0 },
+};
+static const Screen_Field coolantFields[] = {
+    { OBD_PID_COOLANT,  1,  0,  4,   0,  SCREEN_FIELD_VALUE, " C",      0 },
+};
+static const Screen_Field voltageFields[] = {
+    { OBD_PID_VOLTAGE,  1,  0,  5,   1,  SCREEN_FIELD_VALUE, " V",      0 },
+};
+static const Screen_Field overviewFields[] = {
+    { OBD_PID_RPM,      0,  0,  4,   0,  SCREEN_FIELD_VALUE, "rpm",     0 },
+    { OBD_PID_SPEED,    0,  9,  3,   0,  SCREEN_FIELD_VALUE, "km/h",    0 },
+    { OBD_PID_COOLANT,  1,  0,  4,   0,  SCREEN_FIELD_VALUE, "C",       0 },
+    { OBD_PID_VOLTAGE,  1,  8,  4,   1,  SCREEN_FIELD_VALUE, "V",       0 },
+};
+
+static const Screen_Def appScreens[] = {
+    { "Engine RPM:",    SCREEN_FIELDS(rpmFields) },
+    { "Vehicle Speed:", SCREEN_FIELDS(speedFields) },
+    { "Coolant Temp:",  SCREEN_FIELDS(coolantFields) },
+    { "Battery Volt:",  SCREEN_FIELDS(voltageFields) },
+    { NULL_PTR,         SCREEN_FIELDS(overviewFields) },
+};
+
+#define APP_SCREEN_COUNT  ((uint8)(sizeof(appScreens) / sizeof(appScreens[0])))
+
+/* --- Application Tasks --- */
+static uint8 currentScreen = 0;
+static uint8 requestScreen;                         /* Screen the request in flight is for */
+static uint8 requestPids[OBD_MAX_PIDS_MODE01];
+static OBD_PidValue lastValues[OBD_MAX_PIDS_MODE01];
+static uint8 lastFound = 0;
+static uint32 lastAnswerMs = 0;
+
+static void App_DrawTitle(void)
 {
-    char buffer[12];
-    char *ptr = buffer;
-    uint32 u_val;
-    
-    if (num < 0) {
-        LCD_SendData('-');
-        u_val = (uint32)(-num);
-    } else {
-        u_val = (uint32)num;
-    }
-    
-    if (u_val == 0) {
-        LCD_SendData('0');
+    Screen_Draw(&appScreens[currentScreen]);
+    LCD_FbFlush();
+}
+
+/* SW1 steps forward, SW2 back; a long SW1 press returns to the first
+ * screen and a double press jumps to the last (the overview). The poller
+ * restarts on SCHED_EVENT_SCREEN */
+static void Task_Screen(const Sched_Event *event)
+{
+    uint8 next = currentScreen;
+
+    /* The press lights blue over the status pattern until release */
+    if(event->data == BUTTON_EVENT_RELEASE)
+    {
+        LED_RestoreStatus();
         return;
     }
-    
-    while (u_val > 0) {
-        *ptr++ = (char)((u_val % 10) + '0');
-        u_val /= 10;
+
+    /* While the bus sleeps a press only wakes the unit (Task_Power) */
+    if(Power_IsBusAsleep()) return;
+
+    switch(event->data)
+    {
+        case BUTTON_EVENT_PRESS:
+            LED_On(LED_BLUE);
+            if(event->arg == BUTTON_SW2) next = (currentScreen == 0) ? APP_SCREEN_COUNT - 1 : currentScreen - 1;
+            else next = (currentScreen + 1 >= APP_SCREEN_COUNT) ? 0 : currentScreen + 1;
+            break;
+        case BUTTON_EVENT_LONG:
+            if(event->arg == BUTTON_SW1) next = 0;
+            break;
+        case BUTTON_EVENT_DOUBLE:
+            next = APP_SCREEN_COUNT - 1;
+            break;
+        default:
+            break;
     }
-    
-    while (ptr > buffer) {
-        LCD_SendData(*(--ptr));
+    if(next == currentScreen) return;
+
+    currentScreen = next;
+    App_DrawTitle();
+    Sched_Post(SCHED_EVENT_SCREEN, currentScreen, 0);
+}
+
+/* Request the signals of the visible screen (one Mode 01 request) every
+ * 100 ms, or at once on a screen change (dropping the old screen's) */
+static void Task_Poller(const Sched_Event *event)
+{
+    uint8 count;
+
+    if(Power_IsBusAsleep()) return;
+    if(event->id == SCHED_EVENT_TIMER && OBD_RequestInFlight()) return;
+
+    requestScreen = currentScreen;
+    count = Screen_GetPids(&appScreens[currentScreen], requestPids, OBD_MAX_PIDS_MODE01);
+    if(OBD_StartRequest(OBD_MODE_CURRENT, 0, requestPids, count) != OBD_STATUS_OK)
+    {
+        Sched_Post(SCHED_EVENT_CAN_RX, OBD_STATUS_ERROR, requestScreen);
+    }
+}
+
+/* Collect the response without blocking; 1 ms polling of the MCP2515 */
+static void Task_CanRx(const Sched_Event *event)
+{
+    uint8 status;
+
+    (void)event;
+    if(!OBD_RequestInFlight()) return;
+
+    status = OBD_PollResponse(lastValues, OBD_MAX_PIDS_MODE01, &lastFound);
+    if(status == OBD_STATUS_PENDING) return;
+    if(status == OBD_STATUS_OK) lastAnswerMs = Time_NowMs();
+    Sched_Post(SCHED_EVENT_CAN_RX, status, requestScreen);
+}
+
+/* Log every answer, then fill in the fields if it is for the visible
+ * screen. The next request is up to 100 ms away, so the bus is quiet and
+ * the log can erase a page or program a few words now */
+static void Task_Lcd(const Sched_Event *event)
+{
+    sint32 scaled;
+    uint8 i;
+
+    if(event->arg == OBD_STATUS_OK)
+    {
+        for(i = 0; i < lastFound; i++)
+        {
+            if(OBD_DecodePid(&lastValues[i], &scaled) == OBD_STATUS_OK)
+            {
+                (void)Log_Append(lastValues[i].pid, scaled, lastAnswerMs);
+            }
+        }
     }
+    (void)Log_Service(TRUE);
+    (void)Storage_Service(TRUE);
+
+    if(event->data != currentScreen) return;
+
+    Screen_Update(&appScreens[currentScreen], lastValues,
+                  (event->arg == OBD_STATUS_OK) ? lastFound : 0);
+    LED_ShowStatus((event->arg == OBD_STATUS_OK) ? LED_STATUS_LOGGING : LED_STATUS_BUS_ERROR);
+
+    /* Usually only the digits that changed go out over I2C */
+    LCD_FbFlush();
 }
 
-void LCD_PrintFloat(float32 num)
+/* Ignition off: MCP2515 to sleep with wake-on-bus, LCD dark. Bus activity
+ * or a button press brings everything back. */
+static void Task_Power(const Sched_Event *event)
 {
-    sint32 intPart = (sint32)num;
-    sint32 decPart = (sint32)((num - intPart) * 10);
-    if(decPart < 0) decPart = -decPart;
-    LCD_PrintInt(intPart);
-    LCD_SendData('.');
-    LCD_PrintInt(decPart);
+    if(!Power_IsBusAsleep())
+    {
+        if(event->id != SCHED_EVENT_TIMER) return;
+        if((uint32)(Time_NowMs() - lastAnswerMs) < APP_IGNITION_OFF_MS) return;
+
+        Log_Flush();
+        Storage_Flush();
+        if(Power_BusSleep() == POWER_STATUS_OK)
+        {
+            LCD_SetPower(FALSE);
+            LED_ShowStatus(LED_STATUS_OFF);
+        }
+        return;
+    }
+
+    if(event->id == SCHED_EVENT_TIMER) return;
+    if(event->id == SCHED_EVENT_BUTTON && event->data == BUTTON_EVENT_RELEASE) return;
+
+    Power_BusWake();
+    LCD_SetPower(TRUE);
+    LED_ShowStatus(LED_STATUS_CONNECTING);
+    lastAnswerMs = Time_NowMs();
+    App_DrawTitle();
+    Sched_Post(SCHED_EVENT_SCREEN, currentScreen, 0);
+}
+
+/* LCD packets drain from the I2C1 interrupt; this only catches a stuck bus
+ * while nothing is waiting on it */
+static void Task_I2c(const Sched_Event *event)
+{
+    (void)event;
+    I2C1_Poll();
 }
 
+/* The rest of the log page programmed and log pages copied to the SPI
+ * NOR / SD card: one short step at a time between CAN polls (an erase and
+ * a card block wait for the lcd task) */
+static void Task_Storage(const Sched_Event *event)
+{
+    (void)event;
+    (void)Log_Service(FALSE);
+    (void)Storage_Service(FALSE);
+}
+
+/* Static task table: events are dispatched in table order */
+static const Sched_Task appTasks[] = {
+    /* name      run          period  events */
+    { "screen", Task_Screen,    0,    SCHED_EVENT_MASK(SCHED_EVENT_BUTTON) },
+    { "poller", Task_Poller,  100,    SCHED_EVENT_MASK(SCHED_EVENT_SCREEN) },
+    { "can_rx", Task_CanRx,     1,    0 },
+    { "lcd",    Task_Lcd,       0,    SCHED_EVENT_MASK(SCHED_EVENT_CAN_RX) },
+    { "power",  Task_Power,  1000,    SCHED_EVENT_MASK(SCHED_EVENT_WAKE) |
+                                      SCHED_EVENT_MASK(SCHED_EVENT_BUTTON) },
+    { "i2c",    Task_I2c,      10,    0 },
+    { "store",  Task_Storage,   2,    0 },
+};
+
+#define APP_TASK_COUNT  ((uint8)(sizeof(appTasks) / sizeof(appTasks[0])))
+
 int main(void)
 {
-    AppState_t currentState = STATE_SHOW_RPM;
-    uint8 status;
     boolean isConnected = FALSE;
+    uint32 supported[8];
     
-    /* Data Variables */
-    uint16 rpmVal = 0;
-    uint8  speedVal = 0;
-    sint8  tempVal = 0;
-    float32 voltVal = 0.0f;
-    
-    /* Button Logic */
-    boolean btnPrevState = FALSE;
-    boolean btnCurrState = FALSE;
-    
-    /* 1. Hardware Initialization */
+    /* 1. Hardware Initialization: the clock first (drivers derive their
+     * dividers from it), then the time base every wait depends on */
+    Clock_Init(CLOCK_80MHZ);
+    Time_Init();
+    Power_Init();
+    Log_Init();
+    if(Storage_Init() != STORAGE_TYPE_NONE) Log_SetMirror(Storage_Append);
     LCD_Init();       
     Button_Init();    
     LED_Init();
     
     /* 2. Start-up Screen */
-    LCD_Clear(); 
-    LCD_SetCursor(0, 0);
-    LCD_WriteString("OBD-II System");
-    LCD_SetCursor(1, 0);
-    LCD_WriteString("Initializing...");
-    LED_On(LED_BLUE);
+    LCD_FbClear();
+    LCD_FbSetCursor(0, 0);
+    LCD_FbWriteString("OBD-II System");
+    LCD_FbSetCursor(1, 0);
+    LCD_FbWriteString("Initializing...");
+    LCD_FbFlush();
+    LED_ShowStatus(LED_STATUS_CONNECTING);
     Delay_MS(1000);
     
     /* 3. Connection Loop (Keeps trying until wiring is fixed) */
@@ -90,96 +263,39 @@ int main(void)
         if(OBD_Init() == OBD_STATUS_OK)
         {
             isConnected = TRUE;
-            LCD_Clear();
-            LCD_SetCursor(0, 0);
-            LCD_WriteString("OBD Connected!");
-            LED_Off(LED_BLUE);
-            LED_On(LED_GREEN);
+            LCD_FbClear();
+            LCD_FbSetCursor(0, 0);
+            LCD_FbWriteString("OBD Connected!");
+            LCD_FbFlush();
+            LED_ShowStatus(LED_STATUS_CONNECTED);
+
+            /* Learn which ECU carries which PIDs, so a poll only waits for those */
+            (void)OBD_GetSupportedPids(OBD_MODE_CURRENT, 0, supported);
             Delay_MS(1000);
         }
         else
         {
             /* If "FAIL 00" happens, we end up here */
-            LCD_Clear();
-            LCD_SetCursor(0, 0);
-            LCD_WriteString("Connection Fail");
-            LCD_SetCursor(1, 0);
-            LCD_WriteString("Check Wiring...");
+            LCD_FbClear();
+            LCD_FbSetCursor(0, 0);
+            LCD_FbWriteString("Connection Fail");
+            LCD_FbSetCursor(1, 0);
+            LCD_FbWriteString("Check Wiring...");
+            LCD_FbFlush();
             
-            /* Flash Red LED to alert user */
-            LED_On(LED_RED);
-            Delay_MS(500);
-            LED_Off(LED_RED);
-            Delay_MS(500);
-            /* Loop repeats, trying to Init again */
+            /* The red error code runs from the LED timer; retry once a second */
+            LED_ShowStatus(LED_STATUS_BUS_ERROR);
+            Delay_MS(1000);
         }
     }
     
     /* 4. Main Data Loop (Runs only after connection is successful) */
-    LCD_Clear();
-    LCD_SetCursor(0, 0);
-    LCD_WriteString("Engine RPM:");
-    
-    while(1)
-    {
-        /* A. Check Button (Switch Screens) */
-        btnCurrState = Button_IsPressed();
-        if (btnCurrState == TRUE && btnPrevState == FALSE)
-        {
-            LED_On(LED_BLUE);
-            currentState++;
-            if(currentState >= STATE_MAX_STATES) currentState = STATE_SHOW_RPM;
-            
-            LCD_Clear();
-            LCD_SetCursor(0, 0);
-            switch(currentState)
-            {
-                case STATE_SHOW_RPM:     LCD_WriteString("Engine RPM:"); break;
-                case STATE_SHOW_SPEED:   LCD_WriteString("Vehicle Speed:"); break;
-                case STATE_SHOW_COOLANT: LCD_WriteString("Coolant Temp:"); break;
-                case STATE_SHOW_VOLTAGE: LCD_WriteString("Battery Volt:"); break;
-            }
-        }
-        else if (btnCurrState == FALSE && btnPrevState == TRUE)
-        {
-            LED_Off(LED_BLUE);
-        }
-        btnPrevState = btnCurrState;
-        
-        /* B. Fetch Data */
-        LCD_SetCursor(1, 0);
-        switch(currentState)
-        {
-            case STATE_SHOW_RPM:
-                if(OBD_GetEngineRPM(&rpmVal) == OBD_STATUS_OK) {
-                    LCD_PrintInt((sint32)rpmVal);
-                    LCD_WriteString(" rpm     "); 
-                } else LCD_WriteString("No Data...    ");
-                break;
-                
-            case STATE_SHOW_SPEED:
-                if(OBD_GetVehicleSpeed(&speedVal) == OBD_STATUS_OK) {
-                    LCD_PrintInt((sint32)speedVal);
-                    LCD_WriteString(" km/h    ");
-                } else LCD_WriteString("No Data...    ");
-                break;
-                
-            case STATE_SHOW_COOLANT:
-                if(OBD_GetCoolantTemp(&tempVal) == OBD_STATUS_OK) {
-                    LCD_PrintInt((sint32)tempVal);
-                    LCD_WriteString(" C       ");
-                } else LCD_WriteString("No Data...    ");
-                break;
-                
-            case STATE_SHOW_VOLTAGE:
-                if(OBD_GetBatteryVoltage(&voltVal) == OBD_STATUS_OK) {
-                    LCD_PrintFloat(voltVal);
-                    LCD_WriteString(" V       ");
-                } else LCD_WriteString("No Data...    ");
-                break;
-        }
-        
-        /* C. Refresh Rate (100ms) */
-        Delay_MS(100);
-    }
+    App_DrawTitle();
+
+    lastAnswerMs = Time_NowMs();
+    Sched_Init(appTasks, APP_TASK_COUNT);
+    Sched_Post(SCHED_EVENT_SCREEN, currentScreen, 0);
+    Sched_Run();
+
+    return 0;
 }
@@ -1,13 +1,25 @@
 #include "mcp2515.h"
 #include "spi.h"
-#include "delay.h"
+#include "timebase.h"
+
+/* RXB1 was full as RXB0 was last read out, so it is older than RXB0 */
+static boolean rx1Older = FALSE;
 
 void MCP2515_Reset(void)
 {
+    uint32 deadline;
+
     SPI_CS_Assert();
     SPI_Write(MCP2515_CMD_RESET);
     SPI_CS_Deassert();
-    Delay_MS(10);
+
+    /* Ready once the oscillator has started and CANSTAT reports config mode */
+    deadline = TIME_DEADLINE_MS(MCP2515_RESET_TIMEOUT_MS);
+    while((MCP2515_ReadRegister(MCP2515_REG_CANSTAT) & 0xE0) != MCP2515_MODE_CONFIG)
+    {
+        if(TIME_EXPIRED_MS(deadline)) return;
+        Time_Sleep();
+    }
 }
 
 uint8 MCP2515_ReadRegister(uint8 address)
@@ -40,6 +52,19 @@ void MCP2515_BitModify(uint8 address, uint8 mask, uint8 value)
     SPI_CS_Deassert();
 }
 
+uint8 MCP2515_SetMode(uint8 mode)
+{
+    uint32 deadline = TIME_DEADLINE_MS(MCP2515_MODE_TIMEOUT_MS);
+
+    MCP2515_BitModify(MCP2515_REG_CANCTRL, 0xE0, mode);
+    while((MCP2515_ReadRegister(MCP2515_REG_CANSTAT) & 0xE0) != mode)
+    {
+        if(TIME_EXPIRED_MS(deadline)) return MCP2515_STATUS_ERROR;
+        Time_Sleep();
+    }
+    return MCP2515_STATUS_OK;
+}
+
 uint8 MCP2515_Init(const MCP2515_Config *config)
 {
     uint8 status;
@@ -49,6 +74,7 @@ uint8 MCP2515_Init(const MCP2515_Config *config)
     
     /* 2. Reset MCP2515 */
     MCP2515_Reset();
+    rx1Older = FALSE;
     
     /* 3. SANITY CHECK: Must be 0x80 after reset */
     status = MCP2515_ReadRegister(MCP2515_REG_CANSTAT);
@@ -65,16 +91,12 @@ uint8 MCP2515_Init(const MCP2515_Config *config)
     /* 5. Clear Interrupts */
     MCP2515_WriteRegister(MCP2515_REG_CANINTF, 0x00);
     
-    /* 6. FORCE LOOPBACK MODE (For Desk Testing) */
-    /* 0x40 = Loopback. 0x00 = Normal */
-    MCP2515_BitModify(MCP2515_REG_CANCTRL, 0xE0, 0x40);
-    
-    /* 7. Verify Loopback Mode */
-    Delay_MS(10);
-    status = MCP2515_ReadRegister(MCP2515_REG_CANSTAT);
+    /* Roll RXB0 over into RXB1 so back-to-back ISO-TP frames are kept */
+    MCP2515_BitModify(MCP2515_REG_RXB0CTRL, 0x04, 0x04);
     
-    /* We now expect 0x40 (Loopback), NOT 0x00 */
-    if((status & 0xE0) != 0x40)
+    /* 6. FORCE LOOPBACK MODE (For Desk Testing) */
+    /* 7. Verify Loopback Mode (SetMode waits for CANSTAT to follow) */
+    if(MCP2515_SetMode(MCP2515_MODE_LOOPBACK) != MCP2515_STATUS_OK)
     {
         return MCP2515_STATUS_ERROR;
     }
@@ -105,38 +127,85 @@ uint8 MCP2515_Transmit(const MCP2515_Message *msg)
     return MCP2515_STATUS_OK;
 }
 
-uint8 MCP2515_Receive(MCP2515_Message *msg)
+uint8 MCP2515_ReadStatus(void)
 {
-    uint8 intf, i;
-    intf = MCP2515_ReadRegister(MCP2515_REG_CANINTF);
-    
-    if(intf & 0x01)
+    uint8 status;
+    SPI_CS_Assert();
+    SPI_Write(MCP2515_CMD_READ_STATUS);
+    status = SPI_Read();
+    SPI_CS_Deassert();
+    return status;
+}
+
+/* READ RX BUFFER clears the matching RXnIF flag when CS is released */
+void MCP2515_ReadRxBuffer(uint8 readCmd, MCP2515_Message *msg)
+{
+    uint8 sidh, sidl, eid8, eid0, dlc, i;
+
+    SPI_CS_Assert();
+    SPI_Write(readCmd);
+    sidh = SPI_Read();
+    sidl = SPI_Read();
+    eid8 = SPI_Read();
+    eid0 = SPI_Read();
+    dlc = SPI_Read();
+    if(sidl & 0x08)
+    {
+        msg->id = ((uint32)sidh << 21) | ((uint32)(sidl & 0xE0) << 13) |
+                  ((uint32)(sidl & 0x03) << 16) | ((uint32)eid8 << 8) | eid0;
+        msg->idType = MCP2515_FRAME_EXT;
+    }
+    else
     {
-        SPI_CS_Assert();
-        SPI_Write(MCP2515_CMD_READ_RX0);
-        uint8 d0 = SPI_Read();
-        uint8 d1 = SPI_Read();
-        SPI_Read(); SPI_Read();
-        uint8 dlc = SPI_Read();
-        msg->id = ((uint16)d0 << 3) | (d1 >> 5);
-        msg->dlc = dlc & 0x0F;
-        for(i=0; i<msg->dlc; i++) msg->data[i] = SPI_Read();
-        SPI_CS_Deassert();
-        
-        MCP2515_BitModify(MCP2515_REG_CANINTF, 0x01, 0x00);
+        msg->id = ((uint16)sidh << 3) | (sidl >> 5);
+        msg->idType = MCP2515_FRAME_STD;
+    }
+    msg->dlc = dlc & 0x0F;
+    if(msg->dlc > 8) msg->dlc = 8;
+    for(i=0; i<msg->dlc; i++) msg->data[i] = SPI_Read();
+    SPI_CS_Deassert();
+}
+
+/* With rollover a frame only goes to RXB1 while RXB0 is full, so RXB0 is
+ * the older one, except when RXB1 was already full as RXB0 was read out:
+ * whatever RXB0 takes in after that is newer than RXB1 */
+uint8 MCP2515_ReadOldest(uint8 status, MCP2515_Message *msg)
+{
+    if((status & MCP2515_STAT_RX1IF) && (rx1Older || !(status & MCP2515_STAT_RX0IF)))
+    {
+        MCP2515_ReadRxBuffer(MCP2515_CMD_READ_RX1, msg);
+        rx1Older = FALSE;
+        return MCP2515_STATUS_OK;
+    }
+    if(status & MCP2515_STAT_RX0IF)
+    {
+        MCP2515_ReadRxBuffer(MCP2515_CMD_READ_RX0, msg);
+
+        /* A frame that rolled into RXB1 while RXB0 was being read out (the
+         * status above predates it) is older than the next one in RXB0 */
+        if(!(status & MCP2515_STAT_RX1IF)) status = MCP2515_ReadStatus();
+        rx1Older = (status & MCP2515_STAT_RX1IF) ? TRUE : FALSE;
         return MCP2515_STATUS_OK;
     }
+    rx1Older = FALSE;
     return MCP2515_STATUS_NO_MSG;
 }
 
+uint8 MCP2515_Receive(MCP2515_Message *msg)
+{
+    return MCP2515_ReadOldest(MCP2515_ReadStatus(), msg);
+}
+
 uint8 MCP2515_ReceiveWithTimeout(MCP2515_Message *msg, uint32 timeout_ms)
 {
-    while(timeout_ms--)
+    uint32 deadline = TIME_DEADLINE_MS(timeout_ms);
+
+    for(;;)
     {
         if(MCP2515_Receive(msg) == MCP2515_STATUS_OK) return MCP2515_STATUS_OK;
-        Delay_MS(1);
+        if(TIME_EXPIRED_MS(deadline)) return MCP2515_STATUS_TIMEOUT;
+        Time_Sleep();
     }
-    return MCP2515_STATUS_TIMEOUT;
 }
 
 /* Dummy stubs */
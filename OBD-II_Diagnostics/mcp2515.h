@@ -12,6 +12,7 @@
 #define MCP2515_CMD_LOAD_TX0        0x40
 #define MCP2515_CMD_RTS_TX0         0x81
 #define MCP2515_CMD_BIT_MODIFY      0x05
+#define MCP2515_CMD_READ_STATUS     0xA0
 
 /* Registers */
 #define MCP2515_REG_CANSTAT         0x0E
@@ -21,9 +22,35 @@
 #define MCP2515_REG_CNF3            0x28
 #define MCP2515_REG_CANINTE         0x2B
 #define MCP2515_REG_CANINTF         0x2C
+#define MCP2515_REG_EFLG            0x2D
 #define MCP2515_REG_RXB0CTRL        0x60
 #define MCP2515_REG_RXB1CTRL        0x70
 
+/* Operating Modes (CANCTRL.REQOP / CANSTAT.OPMOD) */
+#define MCP2515_MODE_NORMAL         0x00
+#define MCP2515_MODE_SLEEP          0x20
+#define MCP2515_MODE_LOOPBACK       0x40
+#define MCP2515_MODE_LISTEN_ONLY    0x60
+#define MCP2515_MODE_CONFIG         0x80
+
+/* CANINTE / CANINTF Bits */
+#define MCP2515_INT_RX0             0x01
+#define MCP2515_INT_RX1             0x02
+#define MCP2515_INT_ERR             0x20
+#define MCP2515_INT_WAKE            0x40
+
+/* EFLG Bits */
+#define MCP2515_EFLG_RX0OVR         0x40
+#define MCP2515_EFLG_RX1OVR         0x80
+
+/* READ STATUS Bits */
+#define MCP2515_STAT_RX0IF          0x01
+#define MCP2515_STAT_RX1IF          0x02
+
+/* Timeouts (ms) */
+#define MCP2515_RESET_TIMEOUT_MS    10
+#define MCP2515_MODE_TIMEOUT_MS     10
+
 /* Status Codes */
 #define MCP2515_STATUS_OK           0
 #define MCP2515_STATUS_ERROR        1
@@ -54,6 +81,12 @@ uint8 MCP2515_ReadRegister(uint8 address);
 void MCP2515_WriteRegister(uint8 address, uint8 value);
 void MCP2515_BitModify(uint8 address, uint8 mask, uint8 value);
 uint8 MCP2515_Transmit(const MCP2515_Message *msg);
+uint8 MCP2515_SetMode(uint8 mode);
+uint8 MCP2515_ReadStatus(void);
+void MCP2515_ReadRxBuffer(uint8 readCmd, MCP2515_Message *msg);
+/* Read the older of the full RX buffers given a READ STATUS result;
+ * MCP2515_STATUS_NO_MSG if neither is full */
+uint8 MCP2515_ReadOldest(uint8 status, MCP2515_Message *msg);
 uint8 MCP2515_Receive(MCP2515_Message *msg);
 uint8 MCP2515_ReceiveWithTimeout(MCP2515_Message *msg, uint32 timeout_ms);
 uint8 MCP2515_ConfigureMask(uint8 maskNum, uint32 mask, uint8 idType);
@@ -1,12 +1,61 @@
 #include "obd.h"
 #include "mcp2515.h"
-#include "delay.h"
+#include "isotp.h"
+#include "timebase.h"
+
+/* Mode 01 decoder table, shared by Mode 02 (same PID formats per J1979) */
+static const OBD_PidInfo obdPidTable[] = {
+    /* pid   len  mul  div  offset dec */
+    { 0x02,  2,   1,   1,     0,   0 },  /* DTC that caused freeze frame */
+    { 0x03,  2,   1,   1,     0,   0 },  /* Fuel system status (raw) */
+    { 0x04,  1, 100, 255,     0,   0 },  /* Engine load (%) */
+    { 0x05,  1,   1,   1,   -40,   0 },  /* Coolant temp (C) */
+    { 0x06,  1, 100, 128,  -100,   0 },  /* Short term fuel trim B1 (%) */
+    { 0x07,  1, 100, 128,  -100,   0 },  /* Long term fuel trim B1 (%) */
+    { 0x0B,  1,   1,   1,     0,   0 },  /* Intake MAP (kPa) */
+    { 0x0C,  2,   1,   4,     0,   0 },  /* Engine RPM */
+    { 0x0D,  1,   1,   1,     0,   0 },  /* Vehicle speed (km/h) */
+    { 0x0E,  1,   1,   2,   -64,   0 },  /* Timing advance (deg) */
+    { 0x0F,  1,   1,   1,   -40,   0 },  /* Intake air temp (C) */
+    { 0x10,  2,   1,   1,     0,   2 },  /* MAF (g/s) */
+    { 0x11,  1, 100, 255,     0,   0 },  /* Throttle position (%) */
+    { 0x1F,  2,   1,   1,     0,   0 },  /* Run time since start (s) */
+    { 0x2F,  1, 100, 255,     0,   0 },  /* Fuel level (%) */
+    { 0x33,  1,   1,   1,     0,   0 },  /* Barometric pressure (kPa) */
+    { 0x42,  2,   1,   1,     0,   3 },  /* Control module voltage (V) */
+    { 0x46,  1,   1,   1,   -40,   0 },  /* Ambient air temp (C) */
+    { 0x5C,  1,   1,   1,   -40,   0 },  /* Engine oil temp (C) */
+};
+
+#define OBD_PID_TABLE_SIZE  (sizeof(obdPidTable) / sizeof(obdPidTable[0]))
+
+/* PIDs 0x00, 0x20 ... 0xE0 report the next 32 supported PIDs */
+#define OBD_IS_RANGE_PID(pid)   (((pid) & 0x1F) == 0)
+
+/* What each ECU answers, learned from its replies (bit n = PID n), so a
+ * request only waits out P2 for ECUs that may still answer it */
+#define OBD_PID_BIT(pid)        (1ul << ((pid) & 0x1F))
+
+static uint8 ecuSeen = 0;       /* ECUs that have answered since OBD_Init */
+static uint32 ecuPidKnown[OBD_MAX_ECUS][8];
+static uint32 ecuPidSupported[OBD_MAX_ECUS][8];
+
+/* Reassembly per responder: several ECUs answer a functional request at once */
+static ISOTP_RxSession ecuSession[OBD_MAX_ECUS];
+static uint8 ecuResponse[OBD_MAX_ECUS][OBD_MAX_RESPONSE_LEN];
 
 uint8 OBD_Init(void)
 {
     MCP2515_Config cfg;
+    uint8 ecu, i;
+
     cfg.baudRate = MCP2515_BAUD_500KBPS;
-    
+    ecuSeen = 0;
+    for(ecu = 0; ecu < OBD_MAX_ECUS; ecu++)
+    {
+        for(i = 0; i < 8; i++) ecuPidKnown[ecu][i] = 0;
+    }
+
     if(MCP2515_Init(&cfg) != MCP2515_STATUS_OK)
     {
         return OBD_STATUS_ERROR;
@@ -14,39 +63,458 @@ uint8 OBD_Init(void)
     return OBD_STATUS_OK;
 }
 
-static uint8 OBD_Request(uint8 pid, uint8 *dataOut, uint8 len)
+const OBD_PidInfo *OBD_GetPidInfo(uint8 pid)
+{
+    uint8 i;
+    for(i = 0; i < OBD_PID_TABLE_SIZE; i++)
+    {
+        if(obdPidTable[i].pid == pid) return &obdPidTable[i];
+    }
+    return NULL_PTR;
+}
+
+static uint8 OBD_PidLength(uint8 pid)
+{
+    const OBD_PidInfo *info;
+    if(OBD_IS_RANGE_PID(pid)) return 4;
+    info = OBD_GetPidInfo(pid);
+    return (info != NULL_PTR) ? info->length : 0;
+}
+
+uint8 OBD_DecodePid(const OBD_PidValue *value, sint32 *scaled)
+{
+    const OBD_PidInfo *info = OBD_GetPidInfo(value->pid);
+    uint32 raw = 0;
+    uint8 i;
+
+    if(info == NULL_PTR || value->length != info->length) return OBD_STATUS_ERROR;
+
+    for(i = 0; i < info->length; i++) raw = (raw << 8) | value->data[i];
+    *scaled = (sint32)((raw * info->mul) / info->div) + info->offset;
+    return OBD_STATUS_OK;
+}
+
+uint8 OBD_ParseResponse(uint8 service, uint8 frame, const uint8 *response, uint16 respLen,
+                        OBD_PidValue *values, uint8 maxValues, uint8 *found)
+{
+    uint16 pos = 1;
+    uint8 pid, len, i;
+
+    *found = 0;
+    if(respLen == 0 || response[0] != (uint8)(service + OBD_RESPONSE_OFFSET)) return OBD_STATUS_ERROR;
+
+    /* Record lengths come from the decoder table; an unknown PID ends the parse */
+    while(pos < respLen && *found < maxValues)
+    {
+        pid = response[pos++];
+        if(service == OBD_MODE_FREEZE_FRAME)
+        {
+            if(pos >= respLen || response[pos++] != frame) break;
+        }
+
+        len = OBD_PidLength(pid);
+        if(len == 0 || pos + len > respLen) break;
+
+        values[*found].pid = pid;
+        values[*found].length = len;
+        for(i = 0; i < len; i++) values[*found].data[i] = response[pos + i];
+        (*found)++;
+        pos += len;
+    }
+
+    return (*found > 0) ? OBD_STATUS_OK : OBD_STATUS_ERROR;
+}
+
+/* A late answer to an earlier request (another ECU, or one that missed P2)
+ * carries PIDs we did not ask for this time */
+static boolean OBD_AnswersRequest(const uint8 *request, uint8 reqLen, const OBD_PidValue *values, uint8 found)
+{
+    uint8 step = (request[0] == OBD_MODE_FREEZE_FRAME) ? 2 : 1;
+    uint8 i, v;
+
+    for(v = 0; v < found; v++)
+    {
+        for(i = 1; i < reqLen && request[i] != values[v].pid; i += step);
+        if(i >= reqLen) return FALSE;
+    }
+    return TRUE;
+}
+
+/* What to do with a complete ISO-TP message received after request */
+#define OBD_REPLY_ACCEPT        0
+#define OBD_REPLY_PENDING       1   /* NRC 0x78: keep waiting up to P2* */
+#define OBD_REPLY_STALE         2   /* Answer to an earlier request: skip it */
+#define OBD_REPLY_REJECT        3
+
+static uint8 OBD_ClassifyReply(const uint8 *request, uint8 reqLen, const uint8 *response, uint16 respLen,
+                               OBD_PidValue *values, uint8 *found)
+{
+    uint8 frame = (request[0] == OBD_MODE_FREEZE_FRAME) ? request[2] : 0;
+
+    *found = 0;
+
+    /* Negative response: only "response pending" keeps the request alive */
+    if(response[0] == OBD_NEGATIVE_RESPONSE && respLen >= 3 && response[1] == request[0])
+    {
+        return (response[2] == 0x78) ? OBD_REPLY_PENDING : OBD_REPLY_REJECT;
+    }
+    if(response[0] != (uint8)(request[0] + OBD_RESPONSE_OFFSET)) return OBD_REPLY_REJECT;
+    if(OBD_ParseResponse(request[0], frame, response, respLen, values, OBD_MAX_PIDS_MODE01, found) != OBD_STATUS_OK)
+    {
+        return OBD_REPLY_REJECT;
+    }
+    if(!OBD_AnswersRequest(request, reqLen, values, *found)) return OBD_REPLY_STALE;
+    return OBD_REPLY_ACCEPT;
+}
+
+static void OBD_LearnPid(uint8 ecu, uint8 pid, boolean supported)
+{
+    ecuPidKnown[ecu][pid >> 5] |= OBD_PID_BIT(pid);
+    if(supported) ecuPidSupported[ecu][pid >> 5] |= OBD_PID_BIT(pid);
+    else ecuPidSupported[ecu][pid >> 5] &= ~OBD_PID_BIT(pid);
+}
+
+/* Unknown counts as supported: the ECU is waited for until it tells */
+static boolean OBD_EcuMayAnswer(uint8 ecu, uint8 pid)
+{
+    if(!(ecuPidKnown[ecu][pid >> 5] & OBD_PID_BIT(pid))) return TRUE;
+    return (ecuPidSupported[ecu][pid >> 5] & OBD_PID_BIT(pid)) ? TRUE : FALSE;
+}
+
+/* A Mode 01 answer holds the supported subset of the PIDs asked for, and
+ * a range PID (0x00, 0x20, ...) the support of the 32 that follow it */
+static void OBD_LearnAnswer(uint8 ecu, const uint8 *request, uint8 reqLen,
+                            const OBD_PidValue *values, uint8 found)
+{
+    uint32 bitmap;
+    uint16 pid;
+    uint8 i, v;
+
+    for(i = 1; i < reqLen; i++)
+    {
+        for(v = 0; v < found && values[v].pid != request[i]; v++);
+        OBD_LearnPid(ecu, request[i], (v < found) ? TRUE : FALSE);
+    }
+    for(v = 0; v < found; v++)
+    {
+        if(!OBD_IS_RANGE_PID(values[v].pid)) continue;
+        bitmap = ((uint32)values[v].data[0] << 24) | ((uint32)values[v].data[1] << 16) |
+                 ((uint32)values[v].data[2] << 8)  | values[v].data[3];
+        for(pid = values[v].pid + 1u; pid <= values[v].pid + 32u && pid <= 0xFF; pid++)
+        {
+            OBD_LearnPid(ecu, (uint8)pid, ((bitmap >> (values[v].pid + 32u - pid)) & 1u) ? TRUE : FALSE);
+        }
+    }
+}
+
+/* Mode 01 = [01 pid...], Mode 02 = [02 pid frame...]; returns the length, 0 if invalid */
+static uint8 OBD_BuildRequest(uint8 service, uint8 frame, const uint8 *pids, uint8 count, uint8 *request)
+{
+    uint8 maxPids = (service == OBD_MODE_FREEZE_FRAME) ? OBD_MAX_PIDS_MODE02 : OBD_MAX_PIDS_MODE01;
+    uint8 reqLen = 1;
+    uint8 i;
+
+    if(count == 0 || count > maxPids) return 0;
+
+    request[0] = service;
+    for(i = 0; i < count; i++)
+    {
+        request[reqLen++] = pids[i];
+        if(service == OBD_MODE_FREEZE_FRAME) request[reqLen++] = frame;
+    }
+    return reqLen;
+}
+
+/* Drop frames left over from the previous exchange, then send the request */
+static uint8 OBD_SendRequest(ISOTP_Link *link, const uint8 *request, uint8 reqLen)
+{
+    MCP2515_Message stale;
+
+    while(MCP2515_Receive(&stale) == MCP2515_STATUS_OK);
+
+    ISOTP_InitLink(link, OBD_REQUEST_ID, OBD_RESPONSE_ID_MIN, OBD_RESPONSE_ID_MAX);
+    if(ISOTP_Send(link, request, reqLen) != ISOTP_STATUS_OK) return OBD_STATUS_ERROR;
+    return OBD_STATUS_OK;
+}
+
+/* Request in flight between OBD_StartRequest and OBD_PollResponse */
+static uint8 pendingRequest[1 + 2 * OBD_MAX_PIDS_MODE02];
+static uint8 pendingLen = 0;        /* 0 = nothing in flight */
+static uint32 pendingDeadline;
+static uint8 pendingExpected;       /* ECUs that may still answer */
+static uint8 pendingAnswered;       /* ECUs that answered, positively or not */
+static OBD_PidValue pendingValues[OBD_MAX_PIDS_MODE01];
+static uint8 pendingFound;
+
+/* ECUs that answered before and may support one of the PIDs; when none
+ * is known to, every responder ID is listened to for the whole of P2 */
+static uint8 OBD_ExpectedEcus(void)
+{
+    uint8 expected = 0;
+    uint8 ecu, i;
+
+    for(ecu = 0; ecu < OBD_MAX_ECUS; ecu++)
+    {
+        if(!(ecuSeen & (1u << ecu))) continue;
+        for(i = 1; i < pendingLen; i++)
+        {
+            if(pendingRequest[0] != OBD_MODE_CURRENT || OBD_EcuMayAnswer(ecu, pendingRequest[i]))
+            {
+                expected |= (uint8)(1u << ecu);
+                break;
+            }
+        }
+    }
+    return (expected != 0) ? expected : 0xFF;
+}
+
+/* Each PID is taken from the first ECU that reports it; range bitmaps
+ * from several ECUs are combined */
+static void OBD_MergeValues(const OBD_PidValue *values, uint8 found)
+{
+    uint8 v, m, i;
+
+    for(v = 0; v < found; v++)
+    {
+        for(m = 0; m < pendingFound && pendingValues[m].pid != values[v].pid; m++);
+        if(m < pendingFound)
+        {
+            if(OBD_IS_RANGE_PID(values[v].pid))
+            {
+                for(i = 0; i < values[v].length; i++) pendingValues[m].data[i] |= values[v].data[i];
+            }
+        }
+        else if(pendingFound < OBD_MAX_PIDS_MODE01)
+        {
+            pendingValues[pendingFound++] = values[v];
+        }
+    }
+}
+
+static void OBD_TakeReply(uint8 ecu, uint16 respLen)
+{
+    OBD_PidValue values[OBD_MAX_PIDS_MODE01];
+    uint8 bit = (uint8)(1u << ecu);
+    uint8 found;
+
+    ecuSeen |= bit;
+    switch(OBD_ClassifyReply(pendingRequest, pendingLen, ecuResponse[ecu], respLen, values, &found))
+    {
+        case OBD_REPLY_ACCEPT:
+            if(pendingRequest[0] == OBD_MODE_CURRENT) OBD_LearnAnswer(ecu, pendingRequest, pendingLen, values, found);
+            OBD_MergeValues(values, found);
+            pendingAnswered |= bit;
+            pendingExpected &= (uint8)~bit;
+            break;
+        case OBD_REPLY_PENDING:
+            pendingDeadline = TIME_DEADLINE_MS(OBD_PENDING_TIMEOUT);
+            pendingExpected |= bit;
+            break;
+        case OBD_REPLY_STALE:
+            break;
+        default:
+            pendingAnswered |= bit;
+            pendingExpected &= (uint8)~bit;
+            break;
+    }
+}
+
+uint8 OBD_StartRequest(uint8 service, uint8 frame, const uint8 *pids, uint8 count)
+{
+    ISOTP_Link link;
+    uint8 ecu;
+
+    pendingLen = OBD_BuildRequest(service, frame, pids, count, pendingRequest);
+    if(pendingLen == 0) return OBD_STATUS_ERROR;
+
+    if(OBD_SendRequest(&link, pendingRequest, pendingLen) != OBD_STATUS_OK)
+    {
+        pendingLen = 0;
+        return OBD_STATUS_ERROR;
+    }
+    for(ecu = 0; ecu < OBD_MAX_ECUS; ecu++)
+    {
+        ISOTP_RxInit(&ecuSession[ecu], &link, ecuResponse[ecu], OBD_MAX_RESPONSE_LEN);
+    }
+    pendingExpected = OBD_ExpectedEcus();
+    pendingAnswered = 0;
+    pendingFound = 0;
+    pendingDeadline = TIME_DEADLINE_MS(OBD_RESPONSE_TIMEOUT);
+    return OBD_STATUS_OK;
+}
+
+boolean OBD_RequestInFlight(void)
+{
+    return (pendingLen != 0) ? TRUE : FALSE;
+}
+
+uint8 OBD_PollResponse(OBD_PidValue *values, uint8 maxValues, uint8 *found)
 {
     MCP2515_Message msg;
+    uint16 respLen;
+    uint8 receiving = 0;
+    uint8 ecu, i;
+
+    *found = 0;
+    if(pendingLen == 0) return OBD_STATUS_ERROR;
+
+    /* Only the frames already received: a multi-frame answer advances by
+     * the Consecutive Frames that have arrived since the last poll */
+    while(MCP2515_Receive(&msg) == MCP2515_STATUS_OK)
+    {
+        if(msg.id < OBD_RESPONSE_ID_MIN || msg.id > OBD_RESPONSE_ID_MAX) continue;
+        ecu = (uint8)(msg.id - OBD_RESPONSE_ID_MIN);
+        if(ISOTP_RxFrame(&ecuSession[ecu], &msg, &respLen) == ISOTP_STATUS_OK) OBD_TakeReply(ecu, respLen);
+    }
+
+    /* A message that missed N_Cr is dropped; one still arriving holds off P2 */
+    for(ecu = 0; ecu < OBD_MAX_ECUS; ecu++)
+    {
+        (void)ISOTP_RxExpired(&ecuSession[ecu]);
+        if(ecuSession[ecu].rxId != 0) receiving |= (uint8)(1u << ecu);
+    }
+    if(receiving != 0) return OBD_STATUS_PENDING;
+    if(pendingExpected != 0 && !TIME_EXPIRED_MS(pendingDeadline)) return OBD_STATUS_PENDING;
+
+    pendingLen = 0;
+    for(i = 0; i < pendingFound && i < maxValues; i++) values[i] = pendingValues[i];
+    *found = i;
+    if(*found > 0) return OBD_STATUS_OK;
+    return (pendingAnswered != 0) ? OBD_STATUS_ERROR : OBD_STATUS_TIMEOUT;
+}
+
+uint8 OBD_RequestPids(uint8 service, uint8 frame, const uint8 *pids, uint8 count,
+                      OBD_PidValue *values, uint8 *found)
+{
     uint8 status;
-    
-    /* 1. Send Request */
-    msg.id = OBD_REQUEST_ID;
-    msg.dlc = 8;
-    msg.data[0] = 0x02; /* Length */
-    msg.data[1] = 0x01; /* Mode 1 */
-    msg.data[2] = pid;
-    msg.data[3] = 0x55; /* Padding */
-    msg.data[4] = 0x55;
-    msg.data[5] = 0x55;
-    msg.data[6] = 0x55;
-    msg.data[7] = 0x55;
-    
-    if(MCP2515_Transmit(&msg) != MCP2515_STATUS_OK) return OBD_STATUS_ERROR;
-    
-    /* 2. Wait for Response */
-    status = MCP2515_ReceiveWithTimeout(&msg, 100); /* 100ms Timeout */
-    
-    if(status == MCP2515_STATUS_OK)
-    {
-        /* Check if it is a response to our Mode 1 request */
-        if(msg.data[1] == 0x41 && msg.data[2] == pid)
+
+    *found = 0;
+    if(OBD_StartRequest(service, frame, pids, count) != OBD_STATUS_OK) return OBD_STATUS_ERROR;
+
+    for(;;)
+    {
+        status = OBD_PollResponse(values, count, found);
+        if(status != OBD_STATUS_PENDING) return status;
+        Time_Sleep();
+    }
+}
+
+boolean OBD_IsPidSupported(const uint32 supported[8], uint8 pid)
+{
+    if(pid == 0) return TRUE;
+    pid--;
+    return ((supported[pid >> 5] >> (31 - (pid & 0x1F))) & 1u) ? TRUE : FALSE;
+}
+
+uint8 OBD_GetSupportedPids(uint8 service, uint8 frame, uint32 supported[8])
+{
+    OBD_PidValue values[OBD_MAX_PIDS_MODE01];
+    uint8 ranges[OBD_MAX_PIDS_MODE01];
+    uint8 maxPids = (service == OBD_MODE_FREEZE_FRAME) ? OBD_MAX_PIDS_MODE02 : OBD_MAX_PIDS_MODE01;
+    uint8 next = 0;     /* Index of the next range PID (0x00, 0x20, ...) */
+    uint8 count, found, i;
+
+    for(i = 0; i < 8; i++) supported[i] = 0;
+
+    /* Ask for several ranges per request; the ECU omits unsupported ones */
+    while(next < 8)
+    {
+        count = 0;
+        while(count < maxPids && next + count < 8)
+        {
+            ranges[count] = (uint8)((next + count) << 5);
+            count++;
+        }
+
+        if(OBD_RequestPids(service, frame, ranges, count, values, &found) != OBD_STATUS_OK)
         {
-            uint8 i;
-            for(i=0; i<len; i++) dataOut[i] = msg.data[3+i];
-            return OBD_STATUS_OK;
+            return (next == 0) ? OBD_STATUS_ERROR : OBD_STATUS_OK;
         }
+
+        for(i = 0; i < found; i++)
+        {
+            if(OBD_IS_RANGE_PID(values[i].pid))
+            {
+                supported[values[i].pid >> 5] = ((uint32)values[i].data[0] << 24) |
+                                               ((uint32)values[i].data[1] << 16) |
+                                               ((uint32)values[i].data[2] << 8)  |
+                                               values[i].data[3];
+            }
+        }
+
+        /* Continue only if the last range of this batch announces the next one */
+        next += count;
+        if(next >= 8 || (supported[next - 1] & 1u) == 0) break;
     }
-    return OBD_STATUS_TIMEOUT;
+    return OBD_STATUS_OK;
+}
+
+uint8 OBD_ReadFreezeFrame(uint8 frame, OBD_FreezeFrame *ff)
+{
+    uint32 supported[8];
+    uint8 batch[OBD_MAX_PIDS_MODE02];
+    OBD_PidValue values[OBD_MAX_PIDS_MODE02];
+    uint8 count = 0;
+    uint8 found, i;
+    uint16 pid;
+
+    ff->frame = frame;
+    ff->dtc = 0;
+    ff->count = 0;
+
+    /* 1. Supported PID bitmaps for this frame (1-3 exchanges) */
+    if(OBD_GetSupportedPids(OBD_MODE_FREEZE_FRAME, frame, supported) != OBD_STATUS_OK)
+    {
+        return OBD_STATUS_ERROR;
+    }
+
+    /* 2. Fetch every supported, decodable PID, three per exchange */
+    for(pid = 1; pid <= 0xFF; pid++)
+    {
+        if(OBD_IS_RANGE_PID(pid) || OBD_GetPidInfo((uint8)pid) == NULL_PTR) continue;
+        if(!OBD_IsPidSupported(supported, (uint8)pid)) continue;
+        if(ff->count + count >= OBD_FREEZE_FRAME_MAX_PIDS) break;
+
+        batch[count++] = (uint8)pid;
+        if(count == OBD_MAX_PIDS_MODE02)
+        {
+            if(OBD_RequestPids(OBD_MODE_FREEZE_FRAME, frame, batch, count, values, &found) == OBD_STATUS_OK)
+            {
+                for(i = 0; i < found; i++) ff->values[ff->count++] = values[i];
+            }
+            count = 0;
+        }
+    }
+    if(count > 0 &&
+       OBD_RequestPids(OBD_MODE_FREEZE_FRAME, frame, batch, count, values, &found) == OBD_STATUS_OK)
+    {
+        for(i = 0; i < found; i++) ff->values[ff->count++] = values[i];
+    }
+
+    /* 3. PID 02 identifies the DTC that stored the frame */
+    for(i = 0; i < ff->count; i++)
+    {
+        if(ff->values[i].pid == OBD_PID_FREEZE_DTC)
+        {
+            ff->dtc = ((uint16)ff->values[i].data[0] << 8) | ff->values[i].data[1];
+        }
+    }
+    return (ff->count > 0) ? OBD_STATUS_OK : OBD_STATUS_ERROR;
+}
+
+/* Single Mode 01 PID, copying the data bytes out */
+static uint8 OBD_Request(uint8 pid, uint8 *dataOut, uint8 len)
+{
+    OBD_PidValue value;
+    uint8 found, i;
+
+    if(OBD_RequestPids(OBD_MODE_CURRENT, 0, &pid, 1, &value, &found) != OBD_STATUS_OK ||
+       value.pid != pid || value.length < len)
+    {
+        return OBD_STATUS_TIMEOUT;
+    }
+    for(i = 0; i < len; i++) dataOut[i] = value.data[i];
+    return OBD_STATUS_OK;
 }
 
 uint8 OBD_GetEngineRPM(uint16 *rpm)
@@ -70,7 +538,7 @@ uint8 OBD_GetCoolantTemp(sint8 *temp)
     uint8 val;
     if(OBD_Request(OBD_PID_COOLANT, &val, 1) == OBD_STATUS_OK)
     {
-        *temp = (sint8)val - 40;
+        *temp = (sint8)((sint16)val - 40);
         return OBD_STATUS_OK;
     }
     return OBD_STATUS_ERROR;
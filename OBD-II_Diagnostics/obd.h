@@ -7,18 +7,61 @@
 #define OBD_REQUEST_ID          0x7DF
 #define OBD_RESPONSE_ID_MIN     0x7E8
 #define OBD_RESPONSE_ID_MAX     0x7EF
+#define OBD_MAX_ECUS            (OBD_RESPONSE_ID_MAX - OBD_RESPONSE_ID_MIN + 1)
 
-/* PIDs */
+/* Services */
 #define OBD_MODE_CURRENT        0x01
+#define OBD_MODE_FREEZE_FRAME   0x02
+#define OBD_RESPONSE_OFFSET     0x40    /* Positive response = service + 0x40 */
+#define OBD_NEGATIVE_RESPONSE   0x7F
+
+/* PIDs */
+#define OBD_PID_SUPPORTED_01_20 0x00
+#define OBD_PID_FREEZE_DTC      0x02
 #define OBD_PID_RPM             0x0C
 #define OBD_PID_SPEED           0x0D
 #define OBD_PID_COOLANT         0x05
 #define OBD_PID_VOLTAGE         0x42
 
+/* Request Limits (ISO 15765-4) */
+#define OBD_MAX_PIDS_MODE01     6       /* PIDs per Mode 01 request */
+#define OBD_MAX_PIDS_MODE02     3       /* PID/frame pairs per Mode 02 request */
+#define OBD_MAX_RESPONSE_LEN    64
+#define OBD_RESPONSE_TIMEOUT    100     /* P2 (ms) */
+#define OBD_PENDING_TIMEOUT     5000    /* P2* (ms) after NRC 0x78 */
+
+#define OBD_FREEZE_FRAME_MAX_PIDS   24
+
 /* Errors */
 #define OBD_STATUS_OK           0
 #define OBD_STATUS_ERROR        1
 #define OBD_STATUS_TIMEOUT      2
+#define OBD_STATUS_PENDING      3       /* OBD_PollResponse: no answer yet */
+
+/* Decoder table entry: value = raw * mul / div + offset, in units of 10^-decimals */
+typedef struct {
+    uint8  pid;
+    uint8  length;      /* Data bytes (A..D) */
+    uint16 mul;
+    uint16 div;
+    sint16 offset;
+    uint8  decimals;
+} OBD_PidInfo;
+
+/* Raw PID data as returned by the ECU */
+typedef struct {
+    uint8 pid;
+    uint8 length;
+    uint8 data[4];
+} OBD_PidValue;
+
+/* Mode 02 snapshot */
+typedef struct {
+    uint8  frame;
+    uint16 dtc;         /* DTC that stored the frame (0 = no freeze frame) */
+    uint8  count;
+    OBD_PidValue values[OBD_FREEZE_FRAME_MAX_PIDS];
+} OBD_FreezeFrame;
 
 /* Functions */
 uint8 OBD_Init(void);
@@ -27,4 +70,37 @@ uint8 OBD_GetVehicleSpeed(uint8 *speed);
 uint8 OBD_GetCoolantTemp(sint8 *temp);
 uint8 OBD_GetBatteryVoltage(float32 *volt);
 
+/* Decoder Table */
+const OBD_PidInfo *OBD_GetPidInfo(uint8 pid);
+uint8 OBD_DecodePid(const OBD_PidValue *value, sint32 *scaled);
+
+/* Split a positive 0x41/0x42 response into PID records; also used by the
+ * host trace replay to decode captured traffic */
+uint8 OBD_ParseResponse(uint8 service, uint8 frame, const uint8 *response, uint16 respLen,
+                        OBD_PidValue *values, uint8 maxValues, uint8 *found);
+
+/* Generic Service 01/02 Requests (frame is ignored for Mode 01). The
+ * answers of every ECU are collected until each one that may support a
+ * requested PID has answered, or P2 runs out; a PID reported by several
+ * ECUs is taken from the first. Built on OBD_StartRequest, so it drops a
+ * request in flight */
+uint8 OBD_RequestPids(uint8 service, uint8 frame, const uint8 *pids, uint8 count,
+                      OBD_PidValue *values, uint8 *found);
+
+/* Non-blocking variant for the scheduler: start the request, then poll until
+ * the result is not OBD_STATUS_PENDING. A poll only takes in the frames
+ * already received and never waits on the bus: a multi-frame answer is
+ * reassembled across polls (STmin 1, so about one CF per ms between them)
+ * and holds off P2 until it completes or misses N_Cr. Starting a new
+ * request drops the one in flight. */
+uint8 OBD_StartRequest(uint8 service, uint8 frame, const uint8 *pids, uint8 count);
+uint8 OBD_PollResponse(OBD_PidValue *values, uint8 maxValues, uint8 *found);
+boolean OBD_RequestInFlight(void);
+
+uint8 OBD_GetSupportedPids(uint8 service, uint8 frame, uint32 supported[8]);
+boolean OBD_IsPidSupported(const uint32 supported[8], uint8 pid);
+
+/* Freeze Frame (Mode 02) */
+uint8 OBD_ReadFreezeFrame(uint8 frame, OBD_FreezeFrame *ff);
+
 #endif /* OBD_H_ */
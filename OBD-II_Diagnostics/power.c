@@ -0,0 +1,161 @@
+/******************************************************************************
+ *
+ * Module: Power
+ *
+ * File Name: power.c
+ *
+ * Description: Source file for low-power idle and CAN bus sleep
+ *
+ *******************************************************************************/
+
+#include "power.h"
+#include "timebase.h"
+#include "sched.h"
+#include "mcp2515.h"
+#include "tm4c123gh6pm_registers.h"
+#include "gpio.h"
+
+static volatile boolean busAsleep = FALSE;
+static uint8 savedMode = MCP2515_MODE_NORMAL;
+
+/* PB0 and MCP2515 interrupt setup from before the bus slept (the sniffer's
+ * level-triggered RX interrupt), put back by Power_BusWake */
+static uint8 savedCanInte = 0;
+static uint32 savedPinIs = 0;
+static uint32 savedPinIbe = 0;
+static uint32 savedPinIev = 0;
+static uint32 savedPinIm = 0;
+static boolean savedIrqEnabled = FALSE;
+
+static uint32 windowStartMs = 0;
+static uint32 windowSleepUs = 0;
+static Power_Stats powerStats;
+
+void Power_Init(void)
+{
+    SYSCTL_SCGCGPIO_REG |= POWER_SCGC_GPIO;
+    SYSCTL_SCGCUART_REG |= POWER_SCGC_UART;
+    SYSCTL_SCGCI2C_REG |= POWER_SCGC_I2C;
+    SYSCTL_SCGCWTIMER_REG |= POWER_SCGC_WTIMER;
+    SYSCTL_SCGCTIMER_REG |= POWER_SCGC_TIMER;
+    SYSCTL_SCGCPWM_REG |= POWER_SCGC_PWM;
+    SYSCTL_RCC_REG |= SYSCTL_RCC_ACG;
+
+    powerStats.sleepPermille = 0;
+    powerStats.minSleepPermille = 1000;
+    powerStats.sleepMsTotal = 0;
+    powerStats.wakeups = 0;
+    powerStats.busSleeps = 0;
+    windowSleepUs = 0;
+    windowStartMs = Time_NowMs();
+}
+
+void Power_Idle(void)
+{
+    uint32 start = Time_NowUs();
+    uint32 elapsedMs;
+    uint16 permille;
+
+    /* The ISR that ends the sleep is counted as sleep: a few us per wake-up */
+    Time_Sleep();
+    windowSleepUs += Time_NowUs() - start;
+    powerStats.wakeups++;
+
+    elapsedMs = Time_NowMs() - windowStartMs;
+    if(elapsedMs < POWER_WINDOW_MS) return;
+
+    permille = (uint16)(windowSleepUs / elapsedMs);
+    if(permille > 1000) permille = 1000;
+    powerStats.sleepPermille = permille;
+    if(permille < powerStats.minSleepPermille) powerStats.minSleepPermille = permille;
+    powerStats.sleepMsTotal += windowSleepUs / 1000;
+    windowSleepUs = 0;
+    windowStartMs += elapsedMs;
+}
+
+static void Power_WakePinInit(void)
+{
+    static const GPIO_PortConfig wakePinConfig = { GPIO_PORTB, 0u, POWER_WAKE_PIN, 0u, POWER_WAKE_PIN, 0u, 0u, 0u };
+
+    GPIO_Configure(&wakePinConfig, 1u);
+
+    /* Falling edge: WAKIF stays set until Power_BusWake clears it */
+    GPIO_PORTB_IM_REG &= ~POWER_WAKE_PIN;
+    GPIO_PORTB_IS_REG &= ~POWER_WAKE_PIN;
+    GPIO_PORTB_IBE_REG &= ~POWER_WAKE_PIN;
+    GPIO_PORTB_IEV_REG &= ~POWER_WAKE_PIN;
+    GPIO_PORTB_ICR_REG = POWER_WAKE_PIN;
+    GPIO_PORTB_IM_REG |= POWER_WAKE_PIN;
+}
+
+uint8 Power_BusSleep(void)
+{
+    if(busAsleep) return POWER_STATUS_OK;
+
+    savedMode = MCP2515_ReadRegister(MCP2515_REG_CANSTAT) & 0xE0;
+    savedCanInte = MCP2515_ReadRegister(MCP2515_REG_CANINTE);
+    savedPinIs = GPIO_PORTB_IS_REG & POWER_WAKE_PIN;
+    savedPinIbe = GPIO_PORTB_IBE_REG & POWER_WAKE_PIN;
+    savedPinIev = GPIO_PORTB_IEV_REG & POWER_WAKE_PIN;
+    savedPinIm = GPIO_PORTB_IM_REG & POWER_WAKE_PIN;
+    savedIrqEnabled = (NVIC_EN0_REG & (1u << POWER_WAKE_IRQ)) ? TRUE : FALSE;
+
+    /* 1. Only the wake-up interrupt drives INT while asleep */
+    MCP2515_WriteRegister(MCP2515_REG_CANINTE, MCP2515_INT_WAKE);
+    MCP2515_WriteRegister(MCP2515_REG_CANINTF, 0x00);
+    Power_WakePinInit();
+
+    /* 2. The MCP2515 enters sleep once the bus is idle */
+    busAsleep = TRUE;
+    NVIC_EN0_REG = (1u << POWER_WAKE_IRQ);
+    if(MCP2515_SetMode(MCP2515_MODE_SLEEP) != MCP2515_STATUS_OK)
+    {
+        Power_BusWake();
+        return POWER_STATUS_ERROR;
+    }
+    powerStats.busSleeps++;
+    return POWER_STATUS_OK;
+}
+
+uint8 Power_BusWake(void)
+{
+    uint8 status = POWER_STATUS_OK;
+
+    NVIC_DIS0_REG = (1u << POWER_WAKE_IRQ);
+    GPIO_PORTB_IM_REG &= ~POWER_WAKE_PIN;
+    busAsleep = FALSE;
+
+    /* 1. A bus wake-up leaves the MCP2515 in listen-only; return to the old mode */
+    MCP2515_WriteRegister(MCP2515_REG_CANINTE, 0x00);
+    MCP2515_WriteRegister(MCP2515_REG_CANINTF, 0x00);
+    if(MCP2515_SetMode(savedMode) != MCP2515_STATUS_OK) status = POWER_STATUS_ERROR;
+
+    /* 2. Put back the interrupt setup from before the sleep */
+    MCP2515_WriteRegister(MCP2515_REG_CANINTE, savedCanInte);
+    GPIO_PORTB_IS_REG = (GPIO_PORTB_IS_REG & ~POWER_WAKE_PIN) | savedPinIs;
+    GPIO_PORTB_IBE_REG = (GPIO_PORTB_IBE_REG & ~POWER_WAKE_PIN) | savedPinIbe;
+    GPIO_PORTB_IEV_REG = (GPIO_PORTB_IEV_REG & ~POWER_WAKE_PIN) | savedPinIev;
+    GPIO_PORTB_ICR_REG = POWER_WAKE_PIN;
+    GPIO_PORTB_IM_REG |= savedPinIm;
+    if(savedIrqEnabled) NVIC_EN0_REG = (1u << POWER_WAKE_IRQ);
+    return status;
+}
+
+boolean Power_IsBusAsleep(void)
+{
+    return busAsleep;
+}
+
+void Power_GetStats(Power_Stats *stats)
+{
+    *stats = powerStats;
+    stats->busAsleep = busAsleep;
+}
+
+void Power_WakeHandler(void)
+{
+    /* One event per wake-up: the pin stays masked until the next bus sleep */
+    GPIO_PORTB_ICR_REG = POWER_WAKE_PIN;
+    GPIO_PORTB_IM_REG &= ~POWER_WAKE_PIN;
+    Sched_Post(SCHED_EVENT_WAKE, 0, 0);
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ * Module: Power
+ *
+ * File Name: power.h
+ *
+ * Description: Header file for low-power idle and CAN bus sleep.
+ * Power_Idle replaces the bare WFI in the scheduler: the core sleeps until
+ * the next interrupt (SysTick, MCP2515 INT, UART, ...) with only the
+ * peripherals listed below clocked, and the time spent asleep is measured.
+ * Power_BusSleep puts the MCP2515 to sleep with wake-on-bus-activity when
+ * the ignition is off; the wake-up arrives on PB0 as SCHED_EVENT_WAKE.
+ * The sleep figures are updated from the idle path, once per window.
+ *
+ *******************************************************************************/
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* RCC Auto Clock Gating: sleep mode uses the SCGCx registers */
+#define SYSCTL_RCC_ACG              0x08000000
+
+/* Peripherals kept clocked while the core sleeps */
+#define POWER_SCGC_GPIO             0x22    /* Port B (MCP2515 INT), Port F (buttons) */
+#define POWER_SCGC_UART             0x01    /* UART0 stream drains from its FIFO interrupt */
+#define POWER_SCGC_I2C              0x02    /* I2C1 (LCD) */
+#define POWER_SCGC_WTIMER           0x01    /* Wide Timer 0 (sniffer timestamps) */
+#define POWER_SCGC_TIMER            0x06    /* Timer 1 (button scan), Timer 2 (LED patterns) */
+#define POWER_SCGC_PWM              0x02    /* PWM1 (RGB LED) */
+
+/* MCP2515 wake-up (WAKIF) is signalled on INT (PB0) */
+#define POWER_WAKE_PIN              (1u << 0)   /* Shared with sniffer.c */
+#define POWER_WAKE_IRQ              1           /* GPIO Port B */
+
+/* Sleep statistics window */
+#define POWER_WINDOW_MS             1000
+
+/* Status Codes */
+#define POWER_STATUS_OK             0
+#define POWER_STATUS_ERROR          1
+
+typedef struct {
+    uint16 sleepPermille;       /* Time asleep in the last window */
+    uint16 minSleepPermille;    /* Busiest window since Power_Init */
+    uint32 sleepMsTotal;
+    uint32 wakeups;             /* Power_Idle calls (interrupts that ended a sleep) */
+    uint32 busSleeps;
+    boolean busAsleep;
+} Power_Stats;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Enable auto clock gating with the sleep-mode set above */
+void Power_Init(void);
+
+/* Sleep until the next interrupt and account the time asleep */
+void Power_Idle(void);
+
+/* MCP2515 to sleep with wake-on-bus-activity. Power_BusWake restores the
+ * mode, CANINTE and the PB0 interrupt setup (the sniffer's RX interrupt) */
+uint8 Power_BusSleep(void);
+uint8 Power_BusWake(void);
+boolean Power_IsBusAsleep(void);
+
+void Power_GetStats(Power_Stats *stats);
+
+/* PB0 interrupt while the MCP2515 sleeps (called from GPIOPortB_Handler) */
+void Power_WakeHandler(void);
+
+#endif /* POWER_H_ */
@@ -1,38 +1,68 @@
 #include "pushbutton.h"
 #include "tm4c123gh6pm_registers.h"
+#include "clock.h"
+#include "timebase.h"
+#include "sched.h"
+#include "gpio.h"
 
-/* SW1 Configuration - PF4 */
-#define SW1_PIN      (1u << 4)  /* PF4 */
+#define BUTTON_SETTLE_SCANS   (BUTTON_DEBOUNCE_MS / BUTTON_SCAN_MS)
 
-static boolean sw1LastState = FALSE;
+typedef struct {
+    uint8 pin;
+    boolean pressed;        /* Debounced state */
+    uint8 settle;           /* Scans the pin has disagreed with 'pressed' */
+    uint16 heldMs;
+    boolean longSent;
+    boolean secondPress;    /* This press already made a DOUBLE */
+    boolean clickPending;   /* Short release: the next press may be a DOUBLE */
+    uint32 releaseMs;
+} Button_State;
+
+static Button_State buttons[BUTTON_COUNT] = {
+    { SW1_PIN, FALSE, 0, 0, FALSE, FALSE, FALSE, 0 },
+    { SW2_PIN, FALSE, 0, 0, FALSE, FALSE, FALSE, 0 },
+};
+
+static const GPIO_PortConfig buttonPinConfig = { GPIO_PORTF, 0u, BUTTON_PINS, 0u, BUTTON_PINS, 0u, 0u, 0u };
 
 void Button_Init(void) {
-    /* Enable clock for PORTF */
-    SYSCTL_RCGCGPIO_REG |= (1u << 5u);
-    
-    /* Wait for clock to be ready */
-    while((SYSCTL_PRGPIO_REG & (1u << 5u)) == 0u);
-    
-    /* Unlock PORTF to allow configuration of PF4 */
-    GPIO_PORTF_LOCK_REG = 0x4C4F434Bu; /* Unlock key */
-    GPIO_PORTF_CR_REG = 0x1Fu;         /* Allow changes to PF4-0 */
-    
-    /* Configure PF4 (SW1) as input */
-    GPIO_PORTF_DIR_REG &= ~SW1_PIN;
-    
-    /* Enable pull-up resistor for SW1 (active low) */
-    GPIO_PORTF_PUR_REG |= SW1_PIN;
-    
-    /* Enable digital function for SW1 */
-    GPIO_PORTF_DEN_REG |= SW1_PIN;
-    
-    /* Read initial state */
-    sw1LastState = Button_IsPressed();
+    uint8 i;
+
+    /* SW1/SW2 as inputs with pull-ups (active low); PF0 gets unlocked */
+    GPIO_Configure(&buttonPinConfig, 1u);
+
+    /* Both edges interrupt; the scan decides what they meant */
+    GPIO_PORTF_IM_REG &= ~BUTTON_PINS;
+    GPIO_PORTF_IS_REG &= ~BUTTON_PINS;
+    GPIO_PORTF_IBE_REG |= BUTTON_PINS;
+    GPIO_PORTF_ICR_REG = BUTTON_PINS;
+    GPIO_PORTF_IM_REG |= BUTTON_PINS;
+
+    /* Timer 1A: periodic scan tick, stopped until the first edge */
+    SYSCTL_RCGCTIMER_REG |= (1u << 1u);
+    while((SYSCTL_PRTIMER_REG & (1u << 1u)) == 0u);
+    TIMER1_CTL_REG = 0;
+    TIMER1_CFG_REG = TIMER_CFG_32BIT;
+    TIMER1_TAMR_REG = TIMER_TAMR_PERIODIC;
+    TIMER1_TAILR_REG = (Clock_GetHz() / 1000u) * BUTTON_SCAN_MS - 1u;
+    TIMER1_ICR_REG = TIMER_INT_TATO;
+    TIMER1_IMR_REG = TIMER_INT_TATO;
+
+    /* A button held through reset is taken as released until it changes */
+    for(i = 0; i < BUTTON_COUNT; i++) {
+        buttons[i].pressed = FALSE;
+        buttons[i].settle = 0;
+        buttons[i].clickPending = FALSE;
+    }
+
+    /* Priority 3 for both: IRQ 30 is PRI7 bits 23:21, IRQ 21 is PRI5 bits 15:13 */
+    NVIC_PRI7_REG = (NVIC_PRI7_REG & ~0x00E00000u) | (BUTTON_IRQ_PRIORITY << 21);
+    NVIC_PRI5_REG = (NVIC_PRI5_REG & ~0x0000E000u) | (BUTTON_IRQ_PRIORITY << 13);
+    NVIC_EN0_REG = (1u << BUTTON_GPIO_IRQ) | (1u << BUTTON_TIMER_IRQ);
 }
 
 boolean Button_IsPressed(void) {
     /* SW1 is active low (0 when pressed) */
-    /* Check if SW1 pin is LOW (pressed) */
     if((GPIO_PORTF_DATA_REG & SW1_PIN) == 0u) {
         return TRUE;  /* Button is pressed */
     } else {
@@ -40,18 +70,75 @@ boolean Button_IsPressed(void) {
     }
 }
 
-boolean Button_WasPressed(void) {
-    boolean currentState = Button_IsPressed();
-    boolean wasPressed = FALSE;
-    
-    /* Detect rising edge (button was just released) */
-    /* This detects when button goes from pressed to not pressed */
-    if(sw1LastState == TRUE && currentState == FALSE) {
-        wasPressed = TRUE;
+/* One scan of one button; returns TRUE while it still needs the timer */
+static boolean Button_Scan(Button_State *b, uint8 id, boolean level) {
+    uint32 now;
+
+    if(level != b->pressed) {
+        b->settle++;
+        if(b->settle >= BUTTON_SETTLE_SCANS) {
+            b->pressed = level;
+            b->settle = 0;
+            now = Time_NowMs();
+
+            if(level) {
+                b->heldMs = 0;
+                b->longSent = FALSE;
+                b->secondPress = FALSE;
+                Sched_Post(SCHED_EVENT_BUTTON, id, BUTTON_EVENT_PRESS);
+                if(b->clickPending && (uint32)(now - b->releaseMs) <= BUTTON_DOUBLE_MS) {
+                    b->secondPress = TRUE;
+                    Sched_Post(SCHED_EVENT_BUTTON, id, BUTTON_EVENT_DOUBLE);
+                }
+                b->clickPending = FALSE;
+            } else {
+                /* A long press or the second of a pair does not start a new pair */
+                b->clickPending = (b->longSent || b->secondPress) ? FALSE : TRUE;
+                b->releaseMs = now;
+                Sched_Post(SCHED_EVENT_BUTTON, id, BUTTON_EVENT_RELEASE);
+            }
+        }
+    } else {
+        b->settle = 0;
     }
-    
-    /* Update last state */
-    sw1LastState = currentState;
-    
-    return wasPressed;
+
+    if(b->pressed && !b->longSent) {
+        b->heldMs += BUTTON_SCAN_MS;
+        if(b->heldMs >= BUTTON_LONG_MS) {
+            b->longSent = TRUE;
+            Sched_Post(SCHED_EVENT_BUTTON, id, BUTTON_EVENT_LONG);
+        }
+    }
+
+    return (b->pressed || b->settle > 0) ? TRUE : FALSE;
+}
+
+/* First edge: hand over to the scan; bounces no longer interrupt */
+void GPIOPortF_Handler(void) {
+    GPIO_PORTF_ICR_REG = BUTTON_PINS;
+    GPIO_PORTF_IM_REG &= ~BUTTON_PINS;
+
+    TIMER1_TAILR_REG = (Clock_GetHz() / 1000u) * BUTTON_SCAN_MS - 1u;
+    TIMER1_CTL_REG |= TIMER_CTL_TAEN;
+}
+
+void Timer1A_Handler(void) {
+    uint32 levels = GPIO_PORTF_DATA_REG;
+    boolean busy = FALSE;
+    uint8 i;
+
+    TIMER1_ICR_REG = TIMER_INT_TATO;
+
+    for(i = 0; i < BUTTON_COUNT; i++) {
+        if(Button_Scan(&buttons[i], (uint8)(i + 1u), ((levels & buttons[i].pin) == 0u) ? TRUE : FALSE)) {
+            busy = TRUE;
+        }
+    }
+    if(busy) return;
+
+    /* Settled and released: back to edge wake-up. Edges latched during the
+     * scan are left pending, so one after the last sample is not lost; a
+     * stale one costs a single extra scan */
+    TIMER1_CTL_REG &= ~TIMER_CTL_TAEN;
+    GPIO_PORTF_IM_REG |= BUTTON_PINS;
 }
@@ -3,13 +3,64 @@
 
 #include "std_types.h"
 
-/* Button Functions for SW1 only */
+/*
+ * SW1 (PF4) and SW2 (PF0), active low. An edge on either pin interrupts
+ * and starts Timer 1A scanning both every BUTTON_SCAN_MS; a level that
+ * holds for BUTTON_DEBOUNCE_MS becomes the new state. Each change is posted
+ * as SCHED_EVENT_BUTTON (arg = button, data = BUTTON_EVENT_*). The timer
+ * stops again once both buttons are released and settled, so an idle
+ * button costs nothing and a press wakes the CPU from Power_Idle.
+ */
+
+/* Timer 1A (16/32-bit) registers, not in tm4c123gh6pm_registers.h */
+#define TIMER1_CFG_REG         (*((volatile uint32 *)0x40031000))
+#define TIMER1_TAMR_REG        (*((volatile uint32 *)0x40031004))
+#define TIMER1_CTL_REG         (*((volatile uint32 *)0x4003100C))
+#define TIMER1_IMR_REG         (*((volatile uint32 *)0x40031018))
+#define TIMER1_ICR_REG         (*((volatile uint32 *)0x40031024))
+#define TIMER1_TAILR_REG       (*((volatile uint32 *)0x40031028))
+
+#define TIMER_CFG_32BIT        0x00000000u  /* 16/32 timer: A and B joined */
+#define TIMER_TAMR_PERIODIC    0x00000002u
+#define TIMER_CTL_TAEN         0x00000001u
+#define TIMER_INT_TATO         0x00000001u  /* Time-out (IMR / ICR) */
+
+/* Buttons (the arg of SCHED_EVENT_BUTTON) */
+#define BUTTON_SW1             1u
+#define BUTTON_SW2             2u
+#define BUTTON_COUNT           2u
+
+/* Events (the data of SCHED_EVENT_BUTTON) */
+#define BUTTON_EVENT_RELEASE   0u
+#define BUTTON_EVENT_PRESS     1u
+#define BUTTON_EVENT_LONG      2u   /* Still held BUTTON_LONG_MS after the press */
+#define BUTTON_EVENT_DOUBLE    3u   /* Second press within BUTTON_DOUBLE_MS, after its PRESS */
+
+/* Timing */
+#define BUTTON_SCAN_MS         5u
+#define BUTTON_DEBOUNCE_MS     20u
+#define BUTTON_LONG_MS         800u
+#define BUTTON_DOUBLE_MS       350u  /* Release to next press */
+
+/* Pins and interrupts */
+#define SW1_PIN                (1u << 4)   /* PF4 */
+#define SW2_PIN                (1u << 0)   /* PF0: NMI-capable, needs the unlock */
+#define BUTTON_PINS            (SW1_PIN | SW2_PIN)
+#define BUTTON_GPIO_IRQ        30u         /* GPIO Port F */
+#define BUTTON_TIMER_IRQ       21u         /* Timer 1A */
+#define BUTTON_IRQ_PRIORITY    3u
+
+/* Button Functions */
 void Button_Init(void);
+
+/* SW1 raw pin level, not debounced */
 boolean Button_IsPressed(void);
-boolean Button_WasPressed(void);
+
+/* Vector table entries (tm4c123gh6pm_startup_ccs.c) */
+void GPIOPortF_Handler(void);
+void Timer1A_Handler(void);
 
 /* Simple Macros for SW1 */
 #define SW1_PRESSED()     Button_IsPressed()
-#define SW1_WAS_PRESSED() Button_WasPressed()
 
 #endif /* PUSHBUTTON_H */
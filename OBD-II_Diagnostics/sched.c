@@ -0,0 +1,157 @@
+/******************************************************************************
+ *
+ * Module: Scheduler
+ *
+ * File Name: sched.c
+ *
+ * Description: Source file for the cooperative run-to-completion scheduler
+ *
+ *******************************************************************************/
+
+#include "sched.h"
+#include "timebase.h"
+#include "power.h"
+
+static const Sched_Task *schedTasks = NULL_PTR;
+static uint8 schedTaskCount = 0;
+static uint32 schedNextRun[SCHED_MAX_TASKS];
+static Sched_TaskStats schedStats[SCHED_MAX_TASKS];
+
+static Sched_Event eventQueue[SCHED_EVENT_QUEUE_SIZE];
+static volatile uint8 eventHead = 0;
+static volatile uint8 eventTail = 0;
+static volatile uint32 eventDrops = 0;
+
+uint8 Sched_Init(const Sched_Task *tasks, uint8 count)
+{
+    uint32 now = Time_NowMs();
+    uint8 i;
+
+    if(tasks == NULL_PTR || count > SCHED_MAX_TASKS) return SCHED_STATUS_ERROR;
+
+    schedTasks = tasks;
+    schedTaskCount = count;
+    for(i = 0; i < count; i++)
+    {
+        schedNextRun[i] = now + tasks[i].periodMs;
+        schedStats[i].runs = 0;
+        schedStats[i].lastUs = 0;
+        schedStats[i].maxUs = 0;
+        schedStats[i].totalUs = 0;
+        schedStats[i].lateRuns = 0;
+    }
+    eventHead = 0;
+    eventTail = 0;
+    eventDrops = 0;
+    return SCHED_STATUS_OK;
+}
+
+/* The event queue has producers in interrupt handlers as well as tasks.
+ * The compiler intrinsics save PRIMASK and restore it, so interrupts stay
+ * off if the caller already had them off */
+static uint32 Sched_EnterCritical(void)
+{
+    return (uint32)_disable_interrupts();
+}
+
+static void Sched_ExitCritical(uint32 primask)
+{
+    _restore_interrupts((unsigned int)primask);
+}
+
+uint8 Sched_Post(uint8 id, uint8 arg, uint16 data)
+{
+    uint32 primask;
+    uint8 next;
+
+    primask = Sched_EnterCritical();
+    next = (uint8)((eventHead + 1) & (SCHED_EVENT_QUEUE_SIZE - 1));
+    if(next == eventTail)
+    {
+        eventDrops++;
+        Sched_ExitCritical(primask);
+        return SCHED_STATUS_FULL;
+    }
+    eventQueue[eventHead].id = id;
+    eventQueue[eventHead].arg = arg;
+    eventQueue[eventHead].data = data;
+    eventHead = next;
+    Sched_ExitCritical(primask);
+    return SCHED_STATUS_OK;
+}
+
+static void Sched_Execute(uint8 index, const Sched_Event *event)
+{
+    Sched_TaskStats *stats = &schedStats[index];
+    uint32 start = Time_NowUs();
+    uint32 elapsed;
+
+    schedTasks[index].run(event);
+
+    elapsed = Time_NowUs() - start;
+    stats->runs++;
+    stats->lastUs = elapsed;
+    stats->totalUs += elapsed;
+    if(elapsed > stats->maxUs) stats->maxUs = elapsed;
+}
+
+boolean Sched_RunOnce(void)
+{
+    Sched_Event event;
+    uint32 now;
+    uint8 i;
+
+    /* 1. Events first: they carry user input and bus traffic */
+    if(eventTail != eventHead)
+    {
+        event = eventQueue[eventTail];
+        eventTail = (uint8)((eventTail + 1) & (SCHED_EVENT_QUEUE_SIZE - 1));
+
+        for(i = 0; i < schedTaskCount; i++)
+        {
+            if(schedTasks[i].eventMask & SCHED_EVENT_MASK(event.id)) Sched_Execute(i, &event);
+        }
+        return TRUE;
+    }
+
+    /* 2. First due periodic task in table order */
+    event.id = SCHED_EVENT_TIMER;
+    event.arg = 0;
+    event.data = 0;
+    for(i = 0; i < schedTaskCount; i++)
+    {
+        if(schedTasks[i].periodMs == 0 || !TIME_EXPIRED_MS(schedNextRun[i])) continue;
+
+        /* Keep the period phase-locked; resynchronise after a long stall */
+        now = Time_NowMs();
+        schedNextRun[i] += schedTasks[i].periodMs;
+        if((sint32)(now - schedNextRun[i]) >= 0)
+        {
+            schedStats[i].lateRuns++;
+            schedNextRun[i] = now + schedTasks[i].periodMs;
+        }
+        Sched_Execute(i, &event);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* An event posted by an interrupt just before WFI waits at most one tick */
+void Sched_Run(void)
+{
+    for(;;)
+    {
+        if(!Sched_RunOnce()) Power_Idle();
+    }
+}
+
+const Sched_TaskStats *Sched_GetStats(uint8 index)
+{
+    if(index >= schedTaskCount) return NULL_PTR;
+    return &schedStats[index];
+}
+
+uint32 Sched_GetEventDrops(void)
+{
+    return eventDrops;
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ * Module: Scheduler
+ *
+ * File Name: sched.h
+ *
+ * Description: Header file for the cooperative run-to-completion scheduler.
+ * Tasks come from a static table supplied by the application. A task runs
+ * when its period elapses, when an event it subscribes to is posted, or
+ * both. Every task returns quickly; nothing in a task may block on the bus.
+ *
+ *******************************************************************************/
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define SCHED_MAX_TASKS             8
+#define SCHED_EVENT_QUEUE_SIZE      16      /* Power of two */
+
+/* Event IDs (event 0 is the timer tick passed to periodic runs) */
+#define SCHED_EVENT_TIMER           0
+#define SCHED_EVENT_BUTTON          1       /* arg = BUTTON_SW1/SW2, data = BUTTON_EVENT_* */
+#define SCHED_EVENT_CAN_RX          2       /* arg = OBD status, data = screen it was for */
+#define SCHED_EVENT_SCREEN          3       /* arg = new screen index */
+#define SCHED_EVENT_WAKE            4       /* CAN bus activity woke the MCP2515 */
+#define SCHED_EVENT_USER            8       /* First application-specific ID */
+
+#define SCHED_EVENT_MASK(id)        ((uint32)1 << (id))
+
+/* Status Codes */
+#define SCHED_STATUS_OK             0
+#define SCHED_STATUS_ERROR          1
+#define SCHED_STATUS_FULL           2
+
+typedef struct {
+    uint8  id;
+    uint8  arg;
+    uint16 data;
+} Sched_Event;
+
+typedef void (*Sched_TaskFn)(const Sched_Event *event);
+
+/* One entry of the application's static task table */
+typedef struct {
+    const char  *name;
+    Sched_TaskFn run;
+    uint16       periodMs;      /* 0 = event-triggered only */
+    uint32       eventMask;     /* SCHED_EVENT_MASK() of the events it handles */
+} Sched_Task;
+
+/* Execution time of one task, measured on the 1 us time base */
+typedef struct {
+    uint32 runs;
+    uint32 lastUs;
+    uint32 maxUs;
+    uint32 totalUs;             /* Wraps after ~71 minutes of pure run time */
+    uint32 lateRuns;            /* Periodic runs started a full period late */
+} Sched_TaskStats;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Install the task table (kept by reference) and clear the statistics */
+uint8 Sched_Init(const Sched_Task *tasks, uint8 count);
+
+/* Queue an event; callable from tasks and interrupt handlers */
+uint8 Sched_Post(uint8 id, uint8 arg, uint16 data);
+
+/* Dispatch one queued event or one due periodic task; FALSE if nothing ran */
+boolean Sched_RunOnce(void);
+
+/* Dispatch forever, in Power_Idle whenever nothing is ready */
+void Sched_Run(void);
+
+const Sched_TaskStats *Sched_GetStats(uint8 index);
+uint32 Sched_GetEventDrops(void);
+
+#endif /* SCHED_H_ */
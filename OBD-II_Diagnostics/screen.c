@@ -0,0 +1,138 @@
+/******************************************************************************
+ *
+ * Module: Screen
+ *
+ * File Name: screen.c
+ *
+ * Description: Source file for the table-driven dashboard renderer
+ *
+ *******************************************************************************/
+
+#include "screen.h"
+#include "lcd.h"
+#include "gauge.h"
+#include "fmt.h"
+
+/* Right-aligned in width cells; '-' fills the field when it does not fit */
+static void Screen_PutNumber(sint32 value, uint8 decimals, uint8 width)
+{
+    char buffer[LCD_COLS + 1];
+
+    if(width > LCD_COLS) width = LCD_COLS;
+    Fmt_Fixed(buffer, value, decimals, width, 0);
+    LCD_FbWriteString(buffer);
+}
+
+static void Screen_PutMissing(uint8 width)
+{
+    uint8 i;
+    for(i = 0; i + 2 < width; i++) LCD_FbPutChar(' ');
+    for(; i < width; i++) LCD_FbPutChar('-');
+}
+
+/* Scaled PID value at the field's precision, rounded half away from zero */
+static sint32 Screen_Rescale(sint32 scaled, uint8 fromDecimals, uint8 toDecimals)
+{
+    sint32 divisor = 1;
+
+    while(fromDecimals > toDecimals)
+    {
+        divisor *= 10;
+        fromDecimals--;
+    }
+    if(divisor == 1) return scaled;
+    if(scaled < 0) return -((-scaled + divisor / 2) / divisor);
+    return (scaled + divisor / 2) / divisor;
+}
+
+static void Screen_DrawField(const Screen_Field *field, const OBD_PidValue *value)
+{
+    const OBD_PidInfo *info = OBD_GetPidInfo(field->pid);
+    sint32 scaled;
+    uint8 decimals;
+    boolean valid = FALSE;
+
+    if(value != NULL_PTR && info != NULL_PTR && OBD_DecodePid(value, &scaled) == OBD_STATUS_OK)
+    {
+        valid = TRUE;
+    }
+
+    if(field->kind == SCREEN_FIELD_BAR)
+    {
+        Gauge_DrawBar(field->row, field->col, field->width, valid ? scaled : 0, 0, field->barMax);
+        return;
+    }
+
+    LCD_FbSetCursor(field->row, field->col);
+    if(!valid)
+    {
+        Screen_PutMissing(field->width);
+        return;
+    }
+    decimals = (field->decimals < info->decimals) ? field->decimals : info->decimals;
+    Screen_PutNumber(Screen_Rescale(scaled, info->decimals, decimals), decimals, field->width);
+}
+
+void Screen_Draw(const Screen_Def *screen)
+{
+    const Screen_Field *field;
+    uint8 i;
+    boolean bars = FALSE;
+
+    LCD_FbClear();
+    if(screen->title != NULL_PTR)
+    {
+        LCD_FbSetCursor(0, 0);
+        LCD_FbWriteString(screen->title);
+    }
+
+    for(i = 0; i < screen->fieldCount; i++)
+    {
+        field = &screen->fields[i];
+        if(field->kind == SCREEN_FIELD_BAR) bars = TRUE;
+        Screen_DrawField(field, NULL_PTR);
+        if(field->unit != NULL_PTR)
+        {
+            LCD_FbSetCursor(field->row, field->col + field->width);
+            LCD_FbWriteString(field->unit);
+        }
+    }
+
+    /* CGRAM once per screen, not per refresh */
+    if(bars) Gauge_LoadGlyphs();
+}
+
+uint8 Screen_GetPids(const Screen_Def *screen, uint8 *pids, uint8 max)
+{
+    uint8 i, j, count = 0;
+
+    for(i = 0; i < screen->fieldCount && count < max; i++)
+    {
+        for(j = 0; j < count; j++)
+        {
+            if(pids[j] == screen->fields[i].pid) break;
+        }
+        if(j == count) pids[count++] = screen->fields[i].pid;
+    }
+    return count;
+}
+
+void Screen_Update(const Screen_Def *screen, const OBD_PidValue *values, uint8 count)
+{
+    const OBD_PidValue *value;
+    uint8 i, j;
+
+    for(i = 0; i < screen->fieldCount; i++)
+    {
+        value = NULL_PTR;
+        for(j = 0; j < count; j++)
+        {
+            if(values[j].pid == screen->fields[i].pid)
+            {
+                value = &values[j];
+                break;
+            }
+        }
+        Screen_DrawField(&screen->fields[i], value);
+    }
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+ *
+ * Module: Screen
+ *
+ * File Name: screen.h
+ *
+ * Description: Header file for the table-driven dashboard renderer.
+ * A screen is a const description supplied by the application: an
+ * optional title on row 0 and a list of fields, each showing one PID as a
+ * right-aligned number with its unit, or as a bar graph. The renderer
+ * draws the static parts once, lists the PIDs to request, and fills the
+ * fields in from a response. Everything goes through the LCD framebuffer.
+ *
+ *******************************************************************************/
+
+#ifndef SCREEN_H_
+#define SCREEN_H_
+
+#include "std_types.h"
+#include "obd.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* Field kinds */
+#define SCREEN_FIELD_VALUE      0
+#define SCREEN_FIELD_BAR        1
+
+typedef struct {
+    uint8 pid;
+    uint8 row;
+    uint8 col;
+    uint8 width;            /* Cells: value right-aligned in them, or bar length */
+    uint8 decimals;         /* Digits after the point, at most the PID's own */
+    uint8 kind;
+    const char *unit;       /* Drawn right after the value; NULL_PTR for none */
+    sint32 barMax;          /* Bar full scale in the PID's units (bar from 0) */
+} Screen_Field;
+
+typedef struct {
+    const char *title;      /* Row 0; NULL_PTR when fields use both rows */
+    const Screen_Field *fields;
+    uint8 fieldCount;
+} Screen_Def;
+
+/* Field array and its length, for a Screen_Def initializer */
+#define SCREEN_FIELDS(array)    (array), (uint8)(sizeof(array) / sizeof((array)[0]))
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Clear the framebuffer and draw the title and units, with every value
+ * shown as missing until the first response; loads the bar glyphs if a
+ * field needs them. The caller flushes */
+void Screen_Draw(const Screen_Def *screen);
+
+/* The distinct PIDs the screen shows, in field order, at most max */
+uint8 Screen_GetPids(const Screen_Def *screen, uint8 *pids, uint8 max);
+
+/* Fill the fields from the values of a response; a field whose PID is not
+ * among them shows "--" */
+void Screen_Update(const Screen_Def *screen, const OBD_PidValue *values, uint8 count);
+
+#endif /* SCREEN_H_ */
@@ -0,0 +1,221 @@
+/******************************************************************************
+ *
+ * Module: Sniffer
+ *
+ * File Name: sniffer.c
+ *
+ * Description: Source file for the passive CAN capture mode
+ * Single producer (ISR) / single consumer ring, no locking needed
+ *
+ *******************************************************************************/
+
+#include "sniffer.h"
+#include "power.h"
+#include "clock.h"
+#include "tm4c123gh6pm_registers.h"
+#include "gpio.h"
+
+/* Nominal frame length incl. 3-bit IFS, excluding stuff bits (so the bus
+ * load figure is a slight lower bound) */
+#define SNIFFER_FRAME_BITS(msg)     ((((msg)->idType == MCP2515_FRAME_EXT) ? 67u : 47u) + 8u * (msg)->dlc)
+
+#define SNIFFER_RING_MASK           (SNIFFER_RING_SIZE - 1)
+#define SNIFFER_WINDOW_US           1000000u
+
+static Sniffer_Frame snifferRing[SNIFFER_RING_SIZE];
+static volatile uint16 ringHead = 0;    /* Written by the ISR only */
+static volatile uint16 ringTail = 0;    /* Written by the consumer only */
+
+static volatile uint32 windowFrames = 0;
+static volatile uint32 windowBits = 0;
+static uint32 windowStartUs = 0;
+
+static volatile Sniffer_Stats snifferStats;
+static uint8 savedMode = MCP2515_MODE_LOOPBACK;
+
+uint32 Sniffer_NowUs(void)
+{
+    /* Down-counter from 0xFFFFFFFF at 1 MHz: its complement counts up in us */
+    return ~WTIMER0_TAR_REG;
+}
+
+static void Sniffer_TimerInit(void)
+{
+    SYSCTL_RCGCWTIMER_REG |= 0x01;
+    while((SYSCTL_PRWTIMER_REG & 0x01) == 0);
+
+    WTIMER0_CTL_REG = 0;
+    WTIMER0_CFG_REG = GPTM_CFG_32BIT;
+    WTIMER0_TAMR_REG = GPTM_TAMR_PERIODIC;     /* Down count: prescaler divides */
+    WTIMER0_TAILR_REG = 0xFFFFFFFF;
+    WTIMER0_TAPR_REG = Clock_GetHz() / SNIFFER_TIMER_HZ - 1;
+    WTIMER0_CTL_REG = GPTM_CTL_TAEN;
+}
+
+static void Sniffer_IntPinInit(void)
+{
+    static const GPIO_PortConfig intPinConfig = { GPIO_PORTB, 0u, SNIFFER_INT_PIN, 0u, SNIFFER_INT_PIN, 0u, 0u, 0u };
+
+    GPIO_Configure(&intPinConfig, 1u);
+
+    /* Level sensitive, active low: re-enters while frames remain */
+    GPIO_PORTB_IM_REG &= ~SNIFFER_INT_PIN;
+    GPIO_PORTB_IS_REG |= SNIFFER_INT_PIN;
+    GPIO_PORTB_IBE_REG &= ~SNIFFER_INT_PIN;
+    GPIO_PORTB_IEV_REG &= ~SNIFFER_INT_PIN;
+    GPIO_PORTB_ICR_REG = SNIFFER_INT_PIN;
+    GPIO_PORTB_IM_REG |= SNIFFER_INT_PIN;
+
+    /* Highest priority: CAN RX must preempt everything else */
+    NVIC_PRI0_REG &= ~0x0000E000;
+}
+
+uint8 Sniffer_Start(void)
+{
+    savedMode = MCP2515_ReadRegister(MCP2515_REG_CANSTAT) & 0xE0;
+
+    /* 1. Accept every frame, RXB0 rolling over into RXB1 */
+    if(MCP2515_SetMode(MCP2515_MODE_CONFIG) != MCP2515_STATUS_OK) return MCP2515_STATUS_ERROR;
+    MCP2515_WriteRegister(MCP2515_REG_RXB0CTRL, 0x64);
+    MCP2515_WriteRegister(MCP2515_REG_RXB1CTRL, 0x60);
+    MCP2515_WriteRegister(MCP2515_REG_CANINTF, 0x00);
+    MCP2515_BitModify(MCP2515_REG_EFLG, MCP2515_EFLG_RX0OVR | MCP2515_EFLG_RX1OVR, 0x00);
+    MCP2515_WriteRegister(MCP2515_REG_CANINTE, MCP2515_INT_RX0 | MCP2515_INT_RX1 | MCP2515_INT_ERR);
+
+    /* 2. Reset ring and statistics */
+    ringHead = 0;
+    ringTail = 0;
+    windowFrames = 0;
+    windowBits = 0;
+    snifferStats.framesTotal = 0;
+    snifferStats.ringDrops = 0;
+    snifferStats.hwOverruns = 0;
+    snifferStats.framesPerSec = 0;
+    snifferStats.peakFramesPerSec = 0;
+    snifferStats.busLoadPermille = 0;
+    snifferStats.ringHighWater = 0;
+
+    Sniffer_TimerInit();
+    windowStartUs = Sniffer_NowUs();
+    Sniffer_IntPinInit();
+
+    /* 3. Go on the bus without ever acknowledging frames */
+    if(MCP2515_SetMode(MCP2515_MODE_LISTEN_ONLY) != MCP2515_STATUS_OK) return MCP2515_STATUS_ERROR;
+    NVIC_EN0_REG = (1u << SNIFFER_INT_IRQ);
+    return MCP2515_STATUS_OK;
+}
+
+void Sniffer_Stop(void)
+{
+    NVIC_DIS0_REG = (1u << SNIFFER_INT_IRQ);
+    GPIO_PORTB_IM_REG &= ~SNIFFER_INT_PIN;
+
+    MCP2515_WriteRegister(MCP2515_REG_CANINTE, 0x00);
+    MCP2515_SetMode(savedMode);
+}
+
+boolean Sniffer_Read(Sniffer_Frame *frame)
+{
+    uint16 tail = ringTail;
+
+    if(tail == ringHead) return FALSE;
+
+    *frame = snifferRing[tail];
+    ringTail = (tail + 1) & SNIFFER_RING_MASK;
+    return TRUE;
+}
+
+void Sniffer_UpdateStats(void)
+{
+    uint32 now = Sniffer_NowUs();
+    uint32 elapsed = now - windowStartUs;
+    uint32 frames, bits, fps;
+
+    if(elapsed < SNIFFER_WINDOW_US) return;
+
+    /* Swap the window counters out with the MCP2515 interrupt masked */
+    NVIC_DIS0_REG = (1u << SNIFFER_INT_IRQ);
+    frames = windowFrames;
+    bits = windowBits;
+    windowFrames = 0;
+    windowBits = 0;
+    NVIC_EN0_REG = (1u << SNIFFER_INT_IRQ);
+    windowStartUs = now;
+
+    fps = (uint32)(((uint64)frames * 1000000u) / elapsed);
+    snifferStats.framesPerSec = (uint16)fps;
+    if(fps > snifferStats.peakFramesPerSec) snifferStats.peakFramesPerSec = (uint16)fps;
+    snifferStats.busLoadPermille = (uint16)(((uint64)bits * 1000u * 1000000u) /
+                                            ((uint64)SNIFFER_BUS_BITRATE * elapsed));
+}
+
+void Sniffer_GetStats(Sniffer_Stats *stats)
+{
+    stats->framesTotal = snifferStats.framesTotal;
+    stats->ringDrops = snifferStats.ringDrops;
+    stats->hwOverruns = snifferStats.hwOverruns;
+    stats->framesPerSec = snifferStats.framesPerSec;
+    stats->peakFramesPerSec = snifferStats.peakFramesPerSec;
+    stats->busLoadPermille = snifferStats.busLoadPermille;
+    stats->ringHighWater = snifferStats.ringHighWater;
+}
+
+void GPIOPortB_Handler(void)
+{
+    static MCP2515_Message discard;
+    Sniffer_Frame *slot;
+    uint16 head, next, used;
+    uint8 status, eflg;
+
+    /* Not sniffing: INT is the wake-up from CAN bus sleep */
+    if(Power_IsBusAsleep())
+    {
+        Power_WakeHandler();
+        return;
+    }
+
+    GPIO_PORTB_ICR_REG = SNIFFER_INT_PIN;
+
+    /* 1. Drain both RX buffers, the older frame first (after a rollover
+     * that can be RXB1) */
+    for(;;)
+    {
+        status = MCP2515_ReadStatus();
+        if((status & (MCP2515_STAT_RX0IF | MCP2515_STAT_RX1IF)) == 0) break;
+
+        head = ringHead;
+        next = (head + 1) & SNIFFER_RING_MASK;
+        if(next == ringTail)
+        {
+            /* Still read it out so the MCP2515 can accept the next frame */
+            (void)MCP2515_ReadOldest(status, &discard);
+            snifferStats.ringDrops++;
+            continue;
+        }
+
+        slot = &snifferRing[head];
+        slot->timestampUs = Sniffer_NowUs();
+        (void)MCP2515_ReadOldest(status, &slot->msg);
+        ringHead = next;
+
+        snifferStats.framesTotal++;
+        windowFrames++;
+        windowBits += SNIFFER_FRAME_BITS(&slot->msg);
+
+        used = (next - ringTail) & SNIFFER_RING_MASK;
+        if(used > snifferStats.ringHighWater) snifferStats.ringHighWater = used;
+    }
+
+    /* 2. INT still asserted: receive overflow reported through ERRIF */
+    if((GPIO_PORTB_DATA_REG & SNIFFER_INT_PIN) == 0)
+    {
+        if(MCP2515_ReadRegister(MCP2515_REG_CANINTF) & MCP2515_INT_ERR)
+        {
+            eflg = MCP2515_ReadRegister(MCP2515_REG_EFLG);
+            if(eflg & MCP2515_EFLG_RX0OVR) snifferStats.hwOverruns++;
+            if(eflg & MCP2515_EFLG_RX1OVR) snifferStats.hwOverruns++;
+            MCP2515_BitModify(MCP2515_REG_EFLG, MCP2515_EFLG_RX0OVR | MCP2515_EFLG_RX1OVR, 0x00);
+            MCP2515_BitModify(MCP2515_REG_CANINTF, MCP2515_INT_ERR, 0x00);
+        }
+    }
+}
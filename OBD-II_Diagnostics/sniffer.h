@@ -0,0 +1,87 @@
+/******************************************************************************
+ *
+ * Module: Sniffer
+ *
+ * File Name: sniffer.h
+ *
+ * Description: Header file for the passive (listen-only) CAN capture mode.
+ * Frames are read from the MCP2515 in the INT pin ISR (PB0), timestamped
+ * with Wide Timer 0 (1 us resolution) and queued in a RAM ring buffer.
+ *
+ *******************************************************************************/
+
+#ifndef SNIFFER_H_
+#define SNIFFER_H_
+
+#include "std_types.h"
+#include "mcp2515.h"
+
+/*******************************************************************************
+ * Register Definitions (Wide Timer 0)                    *
+ *******************************************************************************/
+#define WTIMER0_CFG_REG         (*((volatile uint32 *)0x40036000))
+#define WTIMER0_TAMR_REG        (*((volatile uint32 *)0x40036004))
+#define WTIMER0_CTL_REG         (*((volatile uint32 *)0x4003600C))
+#define WTIMER0_TAILR_REG       (*((volatile uint32 *)0x40036028))
+#define WTIMER0_TAPR_REG        (*((volatile uint32 *)0x40036038))
+#define WTIMER0_TAR_REG         (*((volatile uint32 *)0x40036048))
+
+#define GPTM_TAMR_PERIODIC      0x00000002
+#define GPTM_CTL_TAEN           0x00000001
+#define GPTM_CFG_32BIT          0x00000004  /* Wide timer: 32-bit individual */
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* MCP2515 INT (active low) on PB0 */
+#define SNIFFER_INT_PIN             (1u << 0)
+#define SNIFFER_INT_IRQ             1       /* GPIO Port B */
+
+/* Timestamp rate: the prescaler is derived from Clock_GetHz() */
+#define SNIFFER_TIMER_HZ            1000000
+
+/* Ring capacity (power of two). 256 x 20 bytes = 5 KB of SRAM; at
+ * 4000 frames/s this absorbs 64 ms of consumer stall. */
+#define SNIFFER_RING_SIZE           256
+
+#define SNIFFER_BUS_BITRATE         500000
+
+typedef struct {
+    uint32 timestampUs;
+    MCP2515_Message msg;
+} Sniffer_Frame;
+
+typedef struct {
+    uint32 framesTotal;
+    uint32 ringDrops;           /* Ring full when the ISR had a frame */
+    uint32 hwOverruns;          /* MCP2515 RXBn overflow (EFLG) */
+    uint16 framesPerSec;        /* Last complete 1 s window */
+    uint16 peakFramesPerSec;
+    uint16 busLoadPermille;     /* Last complete 1 s window, 0..1000 */
+    uint16 ringHighWater;
+} Sniffer_Stats;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Put the MCP2515 in listen-only mode and start interrupt-driven capture.
+ * The sniffer owns the MCP2515 until Sniffer_Stop; no OBD requests meanwhile. */
+uint8 Sniffer_Start(void);
+void Sniffer_Stop(void);
+
+/* Pop the oldest captured frame; FALSE if the ring is empty */
+boolean Sniffer_Read(Sniffer_Frame *frame);
+
+/* Free-running microsecond timestamp (wraps every ~71 minutes) */
+uint32 Sniffer_NowUs(void);
+
+/* Close the statistics window; call at least once per second */
+void Sniffer_UpdateStats(void);
+void Sniffer_GetStats(Sniffer_Stats *stats);
+
+/* MCP2515 INT handler (vector table: GPIO Port B) */
+void GPIOPortB_Handler(void);
+
+#endif /* SNIFFER_H_ */
@@ -1,5 +1,7 @@
 #include "spi.h"
 #include "tm4c123gh6pm_registers.h"
+#include "clock.h"
+#include "gpio.h"
 
 /* Pin Definitions for Port A (Bit-Banging) */
 #define BIT_CLK  (1u << 2) /* PA2 */
@@ -7,33 +9,104 @@
 #define BIT_MISO (1u << 4) /* PA4 */
 #define BIT_MOSI (1u << 5) /* PA5 */
 
+/* Port B */
+#define BIT_STORAGE_CS  SPI_STORAGE_CS_PIN  /* PB5 */
+
+/* One masked data address per pin: each edge is a single store, and the
+ * MCP2515 or sniffer interrupt cannot undo a pin change made around it */
+#define SPI_CLK_DATA   GPIO_DATA_MASKED(GPIO_PORTA_BASE, BIT_CLK)
+#define SPI_CS_DATA    GPIO_DATA_MASKED(GPIO_PORTA_BASE, BIT_CS)
+#define SPI_MISO_DATA  GPIO_DATA_MASKED(GPIO_PORTA_BASE, BIT_MISO)
+#define SPI_MOSI_DATA  GPIO_DATA_MASKED(GPIO_PORTA_BASE, BIT_MOSI)
+#define SPI_STORAGE_CS_DATA  GPIO_DATA_MASKED(GPIO_PORTB_BASE, BIT_STORAGE_CS)
+
+/* Cycles between two edges without padding (one store to the masked data
+ * address), and per iteration of the padding loop */
+#define SPI_EDGE_CYCLES     2
+#define SPI_PAD_CYCLES      6
+
+static uint32 spiPad = 0;
+static uint32 spiCanPad = 0;        /* MCP2515, and whenever no storage CS is low */
+static uint32 spiStoragePad = 0;
+static uint32 spiIrqSaved = 0;      /* CAN interrupt enabled before SPI_Storage_Select */
+
+/* Mode 0 idle state: SCK low, both CS high. MISO is pulled up so that a
+ * device not driving it (an SD card not yet in SPI mode) reads 0xFF */
+static const GPIO_PortConfig spiPinConfig[] = {
+    { GPIO_PORTA, BIT_CLK | BIT_CS | BIT_MOSI, BIT_MISO, 0u, BIT_MISO, 0u, BIT_CS, 0u },
+    { GPIO_PORTB, BIT_STORAGE_CS, 0u, 0u, 0u, 0u, BIT_STORAGE_CS, 0u },
+};
+
+/* Hold SCK for the rest of a half period (only needed on fast clocks) */
+#define SPI_HALF_PERIOD()   do { volatile uint32 n = spiPad; while(n--); } while(0)
+
+/* Padding loops for a half period at sckHz or slower */
+static uint32 SPI_PadFor(uint32 sckHz)
+{
+    uint32 halfCycles = Clock_GetHz() / (2 * sckHz);
+
+    return (halfCycles > SPI_EDGE_CYCLES) ?
+           (halfCycles - SPI_EDGE_CYCLES + SPI_PAD_CYCLES - 1) / SPI_PAD_CYCLES : 0;
+}
+
 void SPI_Init(void)
 {
-    /* 1. Enable Port A Clock */
-    SYSCTL_RCGCGPIO_REG |= 0x01;
-    while((SYSCTL_PRGPIO_REG & 0x01) == 0);
-    
-    /* 2. Configure Output Pins (CLK, CS, MOSI) */
-    GPIO_PORTA_DIR_REG |= (BIT_CLK | BIT_CS | BIT_MOSI);
-    
-    /* 3. Configure Input Pin (MISO) */
-    GPIO_PORTA_DIR_REG &= ~BIT_MISO;
-    
-    /* 4. Enable Digital Functionality */
-    GPIO_PORTA_DEN_REG |= (BIT_CLK | BIT_CS | BIT_MISO | BIT_MOSI);
-    
-    /* 5. Disable Alternate Functions (Force GPIO) */
-    GPIO_PORTA_AFSEL_REG &= ~(BIT_CLK | BIT_CS | BIT_MISO | BIT_MOSI);
-    GPIO_PORTA_PCTL_REG  &= 0xFF0000FF; 
-    GPIO_PORTA_AMSEL_REG &= ~(BIT_CLK | BIT_CS | BIT_MISO | BIT_MOSI);
-    
-    /* 6. Set Idle State (Mode 0: CLK=0, CS=1) */
-    GPIO_PORTA_DATA_REG &= ~BIT_CLK;
-    GPIO_PORTA_DATA_REG |= BIT_CS;
+    /* 0. Half-period padding for the current core clock (0 at 16 MHz) */
+    spiCanPad = SPI_PadFor(SPI_MAX_SCK_HZ);
+    spiStoragePad = spiCanPad;
+    spiPad = spiCanPad;
+
+    /* 1. PA2-5 and PB5 as plain GPIO, already in the idle state */
+    GPIO_Configure(spiPinConfig, 2u);
+}
+
+void SPI_CS_Assert(void)   { SPI_CS_DATA = 0; }
+void SPI_CS_Deassert(void) { SPI_CS_DATA = BIT_CS; }
+
+void SPI_Storage_SetClock(uint32 sckHz)
+{
+    spiStoragePad = SPI_PadFor((sckHz < SPI_MAX_SCK_HZ) ? sckHz : SPI_MAX_SCK_HZ);
 }
 
-void SPI_CS_Assert(void)   { GPIO_PORTA_DATA_REG &= ~BIT_CS; }
-void SPI_CS_Deassert(void) { GPIO_PORTA_DATA_REG |= BIT_CS; }
+/* Only called from task context: the interrupt cannot be halfway
+ * through an MCP2515 transaction here, so masking it is enough */
+static void SPI_Storage_Hold(void)
+{
+    spiIrqSaved = NVIC_EN0_REG & (1u << SPI_CAN_IRQ);
+    NVIC_DIS0_REG = (1u << SPI_CAN_IRQ);
+    __asm("    DSB");
+    __asm("    ISB");
+    spiPad = spiStoragePad;
+}
+
+/* A masked interrupt that became pending meanwhile is taken right here */
+static void SPI_Storage_Release(void)
+{
+    spiPad = spiCanPad;
+    NVIC_EN0_REG = spiIrqSaved;
+}
+
+void SPI_Storage_Select(void)
+{
+    SPI_Storage_Hold();
+    SPI_STORAGE_CS_DATA = 0;
+}
+
+/* One byte after CS goes high: an SD card lets go of MISO only on the
+ * next clock edges, a NOR flash ignores it */
+void SPI_Storage_Deselect(void)
+{
+    SPI_STORAGE_CS_DATA = BIT_STORAGE_CS;
+    (void)SPI_Transfer(0xFF);
+    SPI_Storage_Release();
+}
+
+void SPI_Storage_Idle(uint8 bytes)
+{
+    SPI_Storage_Hold();
+    while(bytes--) (void)SPI_Transfer(0xFF);
+    SPI_Storage_Release();
+}
 
 uint8 SPI_Transfer(uint8 data)
 {
@@ -44,21 +117,33 @@ uint8 SPI_Transfer(uint8 data)
     for(i = 7; i >= 0; i--)
     {
         /* 1. Write MOSI (Setup) */
-        if(data & (1u << i)) GPIO_PORTA_DATA_REG |= BIT_MOSI;
-        else                 GPIO_PORTA_DATA_REG &= ~BIT_MOSI;
+        SPI_MOSI_DATA = (data & (1u << i)) ? BIT_MOSI : 0;
         
         /* 2. Clock Rising Edge (Sample) */
-        GPIO_PORTA_DATA_REG |= BIT_CLK;
+        SPI_CLK_DATA = BIT_CLK;
+        if(spiPad) SPI_HALF_PERIOD();
         
         /* 3. Read MISO */
-        if(GPIO_PORTA_DATA_REG & BIT_MISO) rxByte |= (1u << i);
+        if(SPI_MISO_DATA) rxByte |= (1u << i);
         
         /* 4. Clock Falling Edge (Hold) */
-        GPIO_PORTA_DATA_REG &= ~BIT_CLK;
+        SPI_CLK_DATA = 0;
+        if(spiPad) SPI_HALF_PERIOD();
     }
     return rxByte;
 }
 
 void SPI_Write(uint8 data) { SPI_Transfer(data); }
 uint8 SPI_Read(void) { return SPI_Transfer(0xFF); }
-void SPI_TransferBuffer(const uint8 *txBuffer, uint8 *rxBuffer, uint16 length) { }
+
+void SPI_TransferBuffer(const uint8 *txBuffer, uint8 *rxBuffer, uint16 length)
+{
+    uint16 i;
+    uint8 rxByte;
+
+    for(i = 0; i < length; i++)
+    {
+        rxByte = SPI_Transfer((txBuffer != NULL_PTR) ? txBuffer[i] : 0xFF);
+        if(rxBuffer != NULL_PTR) rxBuffer[i] = rxByte;
+    }
+}
@@ -8,8 +8,16 @@
 
 #include "std_types.h"
 
-/* Chip Select Pin Definition (PA3) */
+/* Chip Select Pin Definitions: MCP2515 on PA3, block storage on PB5 */
 #define SPI_CS_PIN                (1u << 3)
+#define SPI_STORAGE_CS_PIN        (1u << 5)
+
+/* The MCP2515 INT interrupt (GPIO Port B: sniffer, wake-up), held off
+ * while the storage CS is low */
+#define SPI_CAN_IRQ               1
+
+/* SCK ceiling (MCP2515: 10 MHz); edges are padded from Clock_GetHz() */
+#define SPI_MAX_SCK_HZ            8000000
 
 /* Function Prototypes */
 void SPI_Init(void);
@@ -18,6 +26,21 @@ void SPI_Write(uint8 data);
 uint8 SPI_Read(void);
 void SPI_CS_Assert(void);
 void SPI_CS_Deassert(void);
+
+/* NULL txBuffer sends 0xFF, NULL rxBuffer discards what is read */
 void SPI_TransferBuffer(const uint8 *txBuffer, uint8 *rxBuffer, uint16 length);
 
+/* Bus arbiter for the second device. The MCP2515 is also read from the
+ * Port B interrupt, which would clock into the card if it ran with the
+ * storage CS low: Select masks it and Deselect unmasks it, so a pending
+ * CAN read waits for one storage transaction at most and runs right
+ * after. Keep each transaction short. The storage clock applies only
+ * between the two calls */
+void SPI_Storage_Select(void);
+void SPI_Storage_Deselect(void);
+void SPI_Storage_SetClock(uint32 sckHz);
+
+/* 0xFF bytes at the storage clock with both CS high (SD power-up) */
+void SPI_Storage_Idle(uint8 bytes);
+
 #endif /* SPI_H_ */
@@ -0,0 +1,600 @@
+/******************************************************************************
+ *
+ * Module: Storage
+ *
+ * File Name: storage.c
+ *
+ * Description: Source file for the SPI NOR / SD block storage
+ * A ring of RAM blocks between the appender and the device: one block is
+ * written while the next ones fill. Every transaction selects the device
+ * through the SPI arbiter, so the MCP2515 interrupt waits at most one of
+ * them (a NOR chunk is ~40 bytes, an SD block ~530 and only on a quiet bus).
+ *
+ *******************************************************************************/
+
+#include "storage.h"
+#include "spi.h"
+#include "timebase.h"
+
+#define STORAGE_STATE_IDLE      0u      /* No block started */
+#define STORAGE_STATE_WRITE     1u      /* Next: send the block from storageOffset */
+#define STORAGE_STATE_BUSY      2u      /* Device busy with an erase, a chunk or a block */
+
+#define STORAGE_NOR_SECTOR_BLOCKS   (STORAGE_NOR_SECTOR_SIZE / STORAGE_BLOCK_SIZE)
+#define STORAGE_SD_TOKEN_POLLS      2000u   /* Bytes read while waiting for data */
+#define STORAGE_SD_CMD0_TRIES       10u
+
+static uint8 storageQueue[STORAGE_QUEUE_BLOCKS][STORAGE_BLOCK_SIZE];
+static uint8 storageWrite = 0;      /* Slot being written */
+static uint8 storageQueued = 0;     /* Full slots from storageWrite on */
+static uint16 storageFillUsed = 0;  /* Payload bytes in the slot after them */
+static uint16 storageOffset;        /* Bytes of the block already sent */
+static uint8 storageState = STORAGE_STATE_IDLE;
+static uint8 storageType = STORAGE_TYPE_NONE;
+static boolean storageByteAddress;  /* SDSC card: CMD17/24 take byte addresses */
+static uint32 storageBlocks;
+static uint32 storageHead;          /* Device block written next */
+static uint32 storageSeq;           /* Its SEQ */
+static uint32 storageBusyMs;
+static uint32 storageBusyLimitMs;
+static uint32 storageSelectUs;
+static Storage_Stats storageStats;
+
+static void Storage_Put32(uint8 *p, uint32 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+    p[2] = (uint8)(v >> 16);
+    p[3] = (uint8)(v >> 24);
+}
+
+static uint32 Storage_Get32(const uint8 *p)
+{
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+/*******************************************************************************
+ * Bus                                   *
+ *******************************************************************************/
+
+static void Storage_Select(void)
+{
+    SPI_Storage_Select();
+    storageSelectUs = Time_NowUs();
+}
+
+static void Storage_Deselect(void)
+{
+    uint32 held = Time_NowUs() - storageSelectUs;
+
+    SPI_Storage_Deselect();
+    if(held > storageStats.maxHoldUs) storageStats.maxHoldUs = held;
+}
+
+/*******************************************************************************
+ * SPI NOR                                   *
+ *******************************************************************************/
+
+static void Storage_NorCommand(uint8 command, uint32 addr)
+{
+    SPI_Write(command);
+    SPI_Write((uint8)(addr >> 16));
+    SPI_Write((uint8)(addr >> 8));
+    SPI_Write((uint8)addr);
+}
+
+static void Storage_NorWriteEnable(void)
+{
+    Storage_Select();
+    SPI_Write(STORAGE_NOR_WRITE_ENABLE);
+    Storage_Deselect();
+}
+
+static uint8 Storage_NorStatus(void)
+{
+    uint8 status;
+
+    Storage_Select();
+    SPI_Write(STORAGE_NOR_READ_STATUS);
+    status = SPI_Read();
+    Storage_Deselect();
+    return status;
+}
+
+static void Storage_NorErase(uint32 addr)
+{
+    Storage_NorWriteEnable();
+    Storage_Select();
+    Storage_NorCommand(STORAGE_NOR_ERASE_4K, addr);
+    Storage_Deselect();
+}
+
+/* Within one 256-byte page */
+static void Storage_NorProgram(uint32 addr, const uint8 *data, uint16 length)
+{
+    Storage_NorWriteEnable();
+    Storage_Select();
+    Storage_NorCommand(STORAGE_NOR_PROGRAM, addr);
+    SPI_TransferBuffer(data, NULL_PTR, length);
+    Storage_Deselect();
+}
+
+/* A read can stop and restart anywhere, so it goes in chunks as well */
+static void Storage_NorRead(uint32 addr, uint8 *buffer, uint16 length)
+{
+    uint16 n;
+
+    while(length > 0u)
+    {
+        n = (length > STORAGE_NOR_CHUNK) ? STORAGE_NOR_CHUNK : length;
+        Storage_Select();
+        Storage_NorCommand(STORAGE_NOR_READ, addr);
+        SPI_TransferBuffer(NULL_PTR, buffer, n);
+        Storage_Deselect();
+        addr += n;
+        buffer += n;
+        length -= n;
+    }
+}
+
+static boolean Storage_NorDetect(void)
+{
+    uint8 id[3];
+    uint8 sizeLog2;
+    uint32 start;
+
+    Storage_Select();
+    SPI_Write(STORAGE_NOR_JEDEC_ID);
+    SPI_TransferBuffer(NULL_PTR, id, 3u);
+    Storage_Deselect();
+
+    /* Manufacturer, type, capacity (2^n bytes); MISO pulled up reads 0xFF */
+    if(id[0] == 0x00u || id[0] == 0xFFu || id[2] < 12u || id[2] > 32u) return FALSE;
+    sizeLog2 = (id[2] > STORAGE_NOR_MAX_SIZE_LOG2) ? STORAGE_NOR_MAX_SIZE_LOG2 : id[2];
+    storageBlocks = (1uL << sizeLog2) / STORAGE_BLOCK_SIZE;
+
+    /* Clear the block protect bits some parts power up with */
+    Storage_NorWriteEnable();
+    Storage_Select();
+    SPI_Write(STORAGE_NOR_WRITE_STATUS);
+    SPI_Write(0x00u);
+    Storage_Deselect();
+
+    start = Time_NowMs();
+    while(Storage_NorStatus() & STORAGE_NOR_WIP)
+    {
+        if((uint32)(Time_NowMs() - start) > STORAGE_NOR_ERASE_MS) return FALSE;
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * SD card                                   *
+ *******************************************************************************/
+
+/* Send a command and return R1 (0xFF if the card never answers). Only
+ * CMD0 and CMD8 are checked for their CRC in SPI mode */
+static uint8 Storage_SdCommand(uint8 index, uint32 arg)
+{
+    uint8 crc = (index == STORAGE_SD_GO_IDLE) ? 0x95u :
+                (index == STORAGE_SD_SEND_IF_COND) ? 0x87u : 0x01u;
+    uint8 r1 = 0xFFu;
+    uint8 i;
+
+    (void)SPI_Transfer(0xFF);
+    SPI_Write((uint8)(0x40u | index));
+    SPI_Write((uint8)(arg >> 24));
+    SPI_Write((uint8)(arg >> 16));
+    SPI_Write((uint8)(arg >> 8));
+    SPI_Write((uint8)arg);
+    SPI_Write(crc);
+
+    for(i = 0; i < 8u && (r1 & 0x80u); i++) r1 = SPI_Read();
+    return r1;
+}
+
+static uint8 Storage_SdAppCommand(uint8 index, uint32 arg)
+{
+    uint8 r1 = Storage_SdCommand(STORAGE_SD_APP_CMD, 0u);
+
+    return (r1 > STORAGE_SD_R1_IDLE) ? r1 : Storage_SdCommand(index, arg);
+}
+
+/* Data block after a read command: keep the first 'length' of 'total'
+ * bytes, clock out the rest and the CRC */
+static boolean Storage_SdReceive(uint8 *buffer, uint16 length, uint16 total)
+{
+    uint8 token = 0xFFu;
+    uint16 i;
+
+    for(i = 0; i < STORAGE_SD_TOKEN_POLLS && token == 0xFFu; i++) token = SPI_Read();
+    if(token != STORAGE_SD_TOKEN_DATA) return FALSE;
+
+    SPI_TransferBuffer(NULL_PTR, buffer, length);
+    SPI_TransferBuffer(NULL_PTR, NULL_PTR, (uint16)(total - length + 2u));
+    return TRUE;
+}
+
+static uint32 Storage_SdAddress(uint32 block)
+{
+    return storageByteAddress ? block * STORAGE_BLOCK_SIZE : block;
+}
+
+/* Capacity in 512-byte blocks from the CSD register */
+static uint32 Storage_SdBlocks(const uint8 *csd)
+{
+    uint32 size;
+    uint8 shift;
+
+    if((csd[0] >> 6) == 1u)
+    {
+        /* CSD 2.0: (C_SIZE + 1) x 512 KB */
+        size = ((uint32)(csd[7] & 0x3Fu) << 16) | ((uint32)csd[8] << 8) | csd[9];
+        return (size + 1u) << 10;
+    }
+
+    /* CSD 1.0: (C_SIZE + 1) x 2^(C_SIZE_MULT + 2) x 2^READ_BL_LEN bytes */
+    size = ((uint32)(csd[6] & 0x03u) << 10) | ((uint32)csd[7] << 2) | (csd[8] >> 6);
+    shift = (uint8)((((csd[9] & 0x03u) << 1) | (csd[10] >> 7)) + 2u + (csd[5] & 0x0Fu));
+    return (shift >= 9u) ? (size + 1u) << (shift - 9u) : 0u;
+}
+
+static boolean Storage_SdDetect(void)
+{
+    uint8 r1 = 0xFFu, i;
+    uint8 reply[4], csd[16];
+    uint32 start;
+    boolean v2, ok;
+
+    /* 1. 80 clocks with CS high, then CMD0 into SPI mode, all below 400 kHz */
+    SPI_Storage_SetClock(STORAGE_SD_INIT_HZ);
+    SPI_Storage_Idle(10u);
+    for(i = 0; i < STORAGE_SD_CMD0_TRIES && r1 != STORAGE_SD_R1_IDLE; i++)
+    {
+        Storage_Select();
+        r1 = Storage_SdCommand(STORAGE_SD_GO_IDLE, 0u);
+        Storage_Deselect();
+    }
+    if(r1 != STORAGE_SD_R1_IDLE) return FALSE;
+
+    /* 2. CMD8: a version 2 card echoes the 2.7-3.6 V check pattern */
+    Storage_Select();
+    r1 = Storage_SdCommand(STORAGE_SD_SEND_IF_COND, 0x1AAu);
+    if(r1 == STORAGE_SD_R1_IDLE) SPI_TransferBuffer(NULL_PTR, reply, 4u);
+    Storage_Deselect();
+
+    if(r1 == STORAGE_SD_R1_IDLE)
+    {
+        if((reply[2] & 0x0Fu) != 0x01u || reply[3] != 0xAAu) return FALSE;
+        v2 = TRUE;
+    }
+    else if(r1 & STORAGE_SD_R1_ILLEGAL)
+    {
+        v2 = FALSE;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    /* 3. ACMD41 until the card leaves the idle state; one command per
+     * transaction, so CAN reads keep going meanwhile */
+    start = Time_NowMs();
+    do
+    {
+        Storage_Select();
+        r1 = Storage_SdAppCommand(STORAGE_SD_APP_SEND_OP_COND, v2 ? STORAGE_SD_HCS : 0u);
+        Storage_Deselect();
+        if((uint32)(Time_NowMs() - start) > STORAGE_SD_INIT_MS) return FALSE;
+    } while(r1 == STORAGE_SD_R1_IDLE);
+    if(r1 != 0u) return FALSE;
+
+    /* 4. SDHC/SDXC address blocks; SDSC addresses bytes, 512 a block */
+    storageByteAddress = TRUE;
+    if(v2)
+    {
+        Storage_Select();
+        r1 = Storage_SdCommand(STORAGE_SD_READ_OCR, 0u);
+        if(r1 == 0u) SPI_TransferBuffer(NULL_PTR, reply, 4u);
+        Storage_Deselect();
+        if(r1 != 0u) return FALSE;
+        if(reply[0] & STORAGE_SD_OCR_CCS) storageByteAddress = FALSE;
+    }
+    if(storageByteAddress)
+    {
+        Storage_Select();
+        r1 = Storage_SdCommand(STORAGE_SD_SET_BLOCKLEN, STORAGE_BLOCK_SIZE);
+        Storage_Deselect();
+        if(r1 != 0u) return FALSE;
+    }
+
+    /* 5. Capacity */
+    Storage_Select();
+    ok = (Storage_SdCommand(STORAGE_SD_SEND_CSD, 0u) == 0u &&
+          Storage_SdReceive(csd, sizeof(csd), sizeof(csd))) ? TRUE : FALSE;
+    Storage_Deselect();
+    if(!ok) return FALSE;
+
+    storageBlocks = Storage_SdBlocks(csd);
+    return (storageBlocks != 0u) ? TRUE : FALSE;
+}
+
+/* Sends the block; the card then programs it while holding MISO low */
+static boolean Storage_SdWrite(uint32 block, const uint8 *data)
+{
+    uint8 response = 0;
+
+    Storage_Select();
+    if(Storage_SdCommand(STORAGE_SD_WRITE_BLOCK, Storage_SdAddress(block)) == 0u)
+    {
+        SPI_Write(0xFF);
+        SPI_Write(STORAGE_SD_TOKEN_DATA);
+        SPI_TransferBuffer(data, NULL_PTR, STORAGE_BLOCK_SIZE);
+        SPI_Write(0xFF);                /* CRC, not checked in SPI mode */
+        SPI_Write(0xFF);
+        response = SPI_Read() & 0x1Fu;
+    }
+    Storage_Deselect();
+    return (response == STORAGE_SD_DATA_ACCEPTED) ? TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Blocks                                   *
+ *******************************************************************************/
+
+static boolean Storage_DeviceBusy(void)
+{
+    uint8 level;
+
+    if(storageType == STORAGE_TYPE_NOR) return (Storage_NorStatus() & STORAGE_NOR_WIP) ? TRUE : FALSE;
+
+    Storage_Select();
+    level = SPI_Read();
+    Storage_Deselect();
+    return (level != 0xFFu) ? TRUE : FALSE;
+}
+
+static void Storage_Busy(uint32 limitMs)
+{
+    storageState = STORAGE_STATE_BUSY;
+    storageBusyMs = Time_NowMs();
+    storageBusyLimitMs = limitMs;
+}
+
+/* The first 'length' bytes of a block */
+static boolean Storage_Read(uint32 block, uint8 *buffer, uint16 length)
+{
+    boolean ok;
+
+    if(storageType == STORAGE_TYPE_NOR)
+    {
+        Storage_NorRead(block * STORAGE_BLOCK_SIZE, buffer, length);
+        return TRUE;
+    }
+
+    Storage_Select();
+    ok = (Storage_SdCommand(STORAGE_SD_READ_BLOCK, Storage_SdAddress(block)) == 0u &&
+          Storage_SdReceive(buffer, length, STORAGE_BLOCK_SIZE)) ? TRUE : FALSE;
+    Storage_Deselect();
+    return ok;
+}
+
+/* SEQ of a block; FALSE if it holds none (erased, never written) */
+static boolean Storage_BlockSeq(uint32 block, uint32 *seq)
+{
+    uint8 header[STORAGE_HEADER_SIZE];
+
+    if(!Storage_Read(block, header, STORAGE_HEADER_SIZE)) return FALSE;
+    if(Storage_Get32(header) != STORAGE_BLOCK_MAGIC) return FALSE;
+    *seq = Storage_Get32(&header[4]);
+    return TRUE;
+}
+
+/* Blocks before the head were written in this pass, so their SEQs count
+ * up from block 0's; from the head on they are a pass older or blank.
+ * The first block that breaks the count is found in log2(blocks) reads */
+static void Storage_FindHead(void)
+{
+    uint32 first, seq, mid;
+    uint32 lo = 1, hi = storageBlocks;
+
+    storageHead = 0;
+    storageSeq = 0;
+    if(!Storage_BlockSeq(0u, &first)) return;
+
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2u;
+        if(Storage_BlockSeq(mid, &seq) && seq - first == mid) lo = mid + 1u;
+        else hi = mid;
+    }
+    storageHead = (lo == storageBlocks) ? 0u : lo;
+    storageSeq = first + lo;
+}
+
+/*******************************************************************************
+ * Public Functions                                   *
+ *******************************************************************************/
+
+uint8 Storage_Init(void)
+{
+    SPI_Init();
+
+    storageType = STORAGE_TYPE_NONE;
+    if(Storage_SdDetect())
+    {
+        storageType = STORAGE_TYPE_SD;
+    }
+    SPI_Storage_SetClock(SPI_MAX_SCK_HZ);
+    if(storageType == STORAGE_TYPE_NONE && Storage_NorDetect())
+    {
+        storageType = STORAGE_TYPE_NOR;
+    }
+    if(storageType == STORAGE_TYPE_NONE) return STORAGE_TYPE_NONE;
+
+    Storage_FindHead();
+    storageWrite = 0;
+    storageQueued = 0;
+    storageFillUsed = 0;
+    storageState = STORAGE_STATE_IDLE;
+    return storageType;
+}
+
+uint8 Storage_GetType(void)
+{
+    return storageType;
+}
+
+uint32 Storage_GetBlockCount(void)
+{
+    return (storageType == STORAGE_TYPE_NONE) ? 0u : storageBlocks;
+}
+
+boolean Storage_Append(const uint8 *data, uint16 length)
+{
+    uint8 *dst;
+    uint16 i, n;
+
+    if(storageType == STORAGE_TYPE_NONE) return FALSE;
+    if(length > (uint32)(STORAGE_QUEUE_BLOCKS - storageQueued) * STORAGE_PAYLOAD_SIZE - storageFillUsed)
+    {
+        storageStats.drops++;
+        return FALSE;
+    }
+
+    while(length > 0u)
+    {
+        dst = &storageQueue[(storageWrite + storageQueued) % STORAGE_QUEUE_BLOCKS]
+                           [STORAGE_HEADER_SIZE + storageFillUsed];
+        n = STORAGE_PAYLOAD_SIZE - storageFillUsed;
+        if(n > length) n = length;
+        for(i = 0; i < n; i++) dst[i] = data[i];
+        data += n;
+        length -= n;
+        storageFillUsed += n;
+        if(storageFillUsed == STORAGE_PAYLOAD_SIZE)
+        {
+            storageQueued++;
+            storageFillUsed = 0;
+        }
+    }
+    return TRUE;
+}
+
+uint16 Storage_Service(boolean busQuiet)
+{
+    uint8 *block = storageQueue[storageWrite];
+    uint16 sent = 0;
+
+    if(storageType == STORAGE_TYPE_NONE) return 0;
+
+    if(storageState == STORAGE_STATE_BUSY)
+    {
+        if(Storage_DeviceBusy())
+        {
+            if((uint32)(Time_NowMs() - storageBusyMs) > storageBusyLimitMs)
+            {
+                /* An SD block is sent again in place. NOR bits cannot be
+                 * programmed twice without erasing the sector's earlier
+                 * blocks, so the device block and its SEQ are given up and
+                 * the RAM block goes to the next one */
+                storageStats.errors++;
+                if(storageType == STORAGE_TYPE_NOR)
+                {
+                    storageSeq++;
+                    storageHead = (storageHead + 1u == storageBlocks) ? 0u : storageHead + 1u;
+                }
+                storageState = STORAGE_STATE_IDLE;
+            }
+            return 0;
+        }
+        if(storageOffset < STORAGE_BLOCK_SIZE)
+        {
+            storageState = STORAGE_STATE_WRITE;
+        }
+        else
+        {
+            storageWrite = (uint8)((storageWrite + 1u) % STORAGE_QUEUE_BLOCKS);
+            storageQueued--;
+            storageSeq++;
+            storageHead = (storageHead + 1u == storageBlocks) ? 0u : storageHead + 1u;
+            storageStats.blocks++;
+            storageState = STORAGE_STATE_IDLE;
+            return 0;
+        }
+    }
+
+    if(storageState == STORAGE_STATE_IDLE)
+    {
+        if(storageQueued == 0u) return 0;
+
+        Storage_Put32(&block[0], STORAGE_BLOCK_MAGIC);
+        Storage_Put32(&block[4], storageSeq);
+        storageOffset = 0;
+        storageState = STORAGE_STATE_WRITE;
+
+        if(storageType == STORAGE_TYPE_NOR && (storageHead % STORAGE_NOR_SECTOR_BLOCKS) == 0u)
+        {
+            Storage_NorErase(storageHead * STORAGE_BLOCK_SIZE);
+            Storage_Busy(STORAGE_NOR_ERASE_MS);
+            return 0;
+        }
+    }
+
+    if(storageType == STORAGE_TYPE_NOR)
+    {
+        Storage_NorProgram(storageHead * STORAGE_BLOCK_SIZE + storageOffset, &block[storageOffset],
+                           STORAGE_NOR_CHUNK);
+        storageOffset += STORAGE_NOR_CHUNK;
+        sent = STORAGE_NOR_CHUNK;
+        Storage_Busy(STORAGE_NOR_PROGRAM_MS);
+    }
+    else if(busQuiet)
+    {
+        if(!Storage_SdWrite(storageHead, block))
+        {
+            storageStats.errors++;      /* Sent again next time */
+            return 0;
+        }
+        storageOffset = STORAGE_BLOCK_SIZE;
+        sent = STORAGE_BLOCK_SIZE;
+        Storage_Busy(STORAGE_SD_WRITE_MS);
+    }
+    return sent;
+}
+
+void Storage_Flush(void)
+{
+    uint8 *slot;
+    uint16 i;
+    uint32 start = Time_NowMs();
+
+    if(storageType == STORAGE_TYPE_NONE) return;
+
+    if(storageFillUsed > 0u)
+    {
+        slot = storageQueue[(storageWrite + storageQueued) % STORAGE_QUEUE_BLOCKS];
+        for(i = STORAGE_HEADER_SIZE + storageFillUsed; i < STORAGE_BLOCK_SIZE; i++) slot[i] = 0xFFu;
+        storageQueued++;
+        storageFillUsed = 0;
+    }
+
+    /* A card that stopped answering must not keep the unit awake */
+    while((storageQueued > 0u || storageState != STORAGE_STATE_IDLE) &&
+          (uint32)(Time_NowMs() - start) < STORAGE_FLUSH_MS)
+    {
+        (void)Storage_Service(TRUE);
+    }
+}
+
+boolean Storage_ReadBlock(uint32 block, uint8 *buffer)
+{
+    if(storageType == STORAGE_TYPE_NONE || storageState != STORAGE_STATE_IDLE) return FALSE;
+    if(block >= storageBlocks) return FALSE;
+    return Storage_Read(block, buffer, STORAGE_BLOCK_SIZE);
+}
+
+void Storage_GetStats(Storage_Stats *stats)
+{
+    *stats = storageStats;
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ * Module: Storage
+ *
+ * File Name: storage.h
+ *
+ * Description: Header file for the block storage on the second chip select
+ * of the SPI bus (PB5): a SPI NOR flash or an SD card in SPI mode, found by
+ * Storage_Init. Appended bytes collect in a RAM queue of 512-byte blocks;
+ * Storage_Service writes whole blocks at block-aligned addresses, in bus
+ * transactions short enough that the MCP2515 never overruns (spi.h).
+ *
+ * Block:   MAGIC32 | SEQ32 | 504 payload bytes (0xFF padded by a flush)
+ *          SEQ counts the blocks written over the device's life, so after
+ *          a reset the next block to write is found by a binary search, and
+ *          a host reading the card puts the payload back in order.
+ *
+ * NOR:     JEDEC 0x9F / 0x06 / 0x20 (4 KB erase) / 0x02 (page program) /
+ *          0x05 / 0x03, 3-byte addresses, up to 16 MB. A block is written
+ *          as 16 programs of 32 bytes, each its own transaction.
+ * SD:      CMD0 / CMD8 / ACMD41 / CMD58 / CMD9, then CMD24 / CMD17 single
+ *          blocks. A block is one ~530-byte transaction, so it is only
+ *          started when the caller says the bus is quiet.
+ *
+ *******************************************************************************/
+
+#ifndef STORAGE_H_
+#define STORAGE_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define STORAGE_TYPE_NONE           0u
+#define STORAGE_TYPE_NOR            1u
+#define STORAGE_TYPE_SD             2u
+
+#define STORAGE_BLOCK_SIZE          512u
+#define STORAGE_HEADER_SIZE         8u
+#define STORAGE_PAYLOAD_SIZE        (STORAGE_BLOCK_SIZE - STORAGE_HEADER_SIZE)
+#define STORAGE_BLOCK_MAGIC         0x31475453u     /* "STG1" */
+
+/* RAM queue: blocks filling or waiting to be written (2 KB) */
+#define STORAGE_QUEUE_BLOCKS        4u
+
+/* SPI NOR */
+#define STORAGE_NOR_READ            0x03u
+#define STORAGE_NOR_PROGRAM         0x02u
+#define STORAGE_NOR_WRITE_ENABLE    0x06u
+#define STORAGE_NOR_WRITE_STATUS    0x01u
+#define STORAGE_NOR_READ_STATUS     0x05u
+#define STORAGE_NOR_ERASE_4K        0x20u
+#define STORAGE_NOR_JEDEC_ID        0x9Fu
+#define STORAGE_NOR_WIP             0x01u
+#define STORAGE_NOR_SECTOR_SIZE     4096u
+#define STORAGE_NOR_MAX_SIZE_LOG2   24u     /* 3-byte addresses */
+#define STORAGE_NOR_CHUNK           32u     /* Bytes per program or read transaction */
+#define STORAGE_NOR_ERASE_MS        500u
+#define STORAGE_NOR_PROGRAM_MS      10u
+
+/* SD card, SPI mode */
+#define STORAGE_SD_GO_IDLE          0u
+#define STORAGE_SD_SEND_IF_COND     8u
+#define STORAGE_SD_SEND_CSD         9u
+#define STORAGE_SD_SET_BLOCKLEN     16u
+#define STORAGE_SD_READ_BLOCK       17u
+#define STORAGE_SD_WRITE_BLOCK      24u
+#define STORAGE_SD_APP_CMD          55u
+#define STORAGE_SD_READ_OCR         58u
+#define STORAGE_SD_APP_SEND_OP_COND 41u
+#define STORAGE_SD_R1_IDLE          0x01u
+#define STORAGE_SD_R1_ILLEGAL       0x04u
+#define STORAGE_SD_TOKEN_DATA       0xFEu
+#define STORAGE_SD_DATA_ACCEPTED    0x05u
+#define STORAGE_SD_OCR_CCS          0x40u   /* First OCR byte: block addressing */
+#define STORAGE_SD_HCS              0x40000000u
+#define STORAGE_SD_INIT_HZ          400000u
+#define STORAGE_SD_INIT_MS          1000u
+#define STORAGE_SD_WRITE_MS         250u
+
+/* Storage_Flush gives up on a device that stopped answering */
+#define STORAGE_FLUSH_MS            2000u
+
+/*******************************************************************************
+ * Types                                   *
+ *******************************************************************************/
+
+typedef struct {
+    uint32 blocks;          /* Written since Storage_Init */
+    uint32 drops;           /* Appends refused: the queue was full */
+    uint32 errors;          /* Rejected writes and timeouts (the block is retried) */
+    uint32 maxHoldUs;       /* Longest storage transaction, CAN interrupt held off */
+} Storage_Stats;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Find the device (an SD card first, then a NOR flash) and the block after
+ * the newest one written. Returns STORAGE_TYPE_NONE if neither answers;
+ * every other call is then a no-op. Up to STORAGE_SD_INIT_MS for a card */
+uint8 Storage_Init(void);
+
+uint8 Storage_GetType(void);
+uint32 Storage_GetBlockCount(void);
+
+/* Copy into the queue; FALSE (and counted) unless all of it fits. Never
+ * touches the bus */
+boolean Storage_Append(const uint8 *data, uint16 length);
+
+/* One step of the write in progress, or the start of the next queued
+ * block: a NOR erase, a 32-byte program or a status poll. An SD block is
+ * only started when busQuiet. Never waits for the device.
+ * Returns the block bytes sent to the device */
+uint16 Storage_Service(boolean busQuiet);
+
+/* Pad the block being filled and write the queue out (before sleep) */
+void Storage_Flush(void);
+
+/* Blocking read of a whole block; a card holds the bus for all of it.
+ * FALSE while a block is being written */
+boolean Storage_ReadBlock(uint32 block, uint8 *buffer);
+
+void Storage_GetStats(Storage_Stats *stats);
+
+#endif /* STORAGE_H_ */
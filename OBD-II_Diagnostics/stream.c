@@ -0,0 +1,253 @@
+/******************************************************************************
+ *
+ * Module: Stream
+ *
+ * File Name: stream.c
+ *
+ * Description: Source file for the binary UART0 export
+ * Records are built in place and queued whole; a full TX ring drops the
+ * record (the host sees the gap in SEQ) instead of stalling the caller.
+ *
+ *******************************************************************************/
+
+#include "stream.h"
+#include "uart.h"
+#include "crc16.h"
+#include "fmt.h"
+#include "codec.h"
+
+static uint8 streamSeq = 0;
+static uint32 streamDrops = 0;
+
+/* STREAM_REC_PACKED being filled */
+static uint8 packRecord[STREAM_MAX_RECORD];
+static uint8 packLen = 0;           /* Payload bytes; 0: no record open */
+static uint32 packBaseMs;
+static Codec_Channel packChannels[STREAM_PACK_SIGNALS];
+static Codec_Channel packSpare;
+static uint8 packIds[STREAM_PACK_SIGNALS];
+static uint8 packCount = 0;
+
+static void Stream_Put16(uint8 *p, uint16 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+}
+
+static void Stream_Put32(uint8 *p, uint32 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+    p[2] = (uint8)(v >> 16);
+    p[3] = (uint8)(v >> 24);
+}
+
+/* record[] must already hold the payload at offset STREAM_HEADER_LEN */
+static boolean Stream_Emit(uint8 *record, uint8 type, uint8 payloadLen)
+{
+    uint16 crc;
+    uint8 total = STREAM_HEADER_LEN + payloadLen + STREAM_CRC_LEN;
+
+    record[0] = STREAM_SYNC;
+    record[1] = payloadLen;
+    record[2] = type;
+    record[3] = streamSeq++;
+
+    crc = CRC16_Update(CRC16_INIT, &record[1], (uint16)(STREAM_HEADER_LEN - 1 + payloadLen));
+    Stream_Put16(&record[STREAM_HEADER_LEN + payloadLen], crc);
+
+    if(UART0_Write(record, total) == FALSE)
+    {
+        streamDrops++;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void Stream_Init(uint32 baudRate)
+{
+    streamSeq = 0;
+    streamDrops = 0;
+    packLen = 0;
+    packCount = 0;
+    UART0_Init(baudRate);
+}
+
+boolean Stream_SendCanFrame(const Sniffer_Frame *frame)
+{
+    uint8 record[STREAM_MAX_RECORD];
+    uint8 *payload = &record[STREAM_HEADER_LEN];
+    uint8 len, i;
+
+    Stream_Put32(payload, frame->timestampUs);
+    if(frame->msg.idType == MCP2515_FRAME_EXT)
+    {
+        Stream_Put32(&payload[4], frame->msg.id);
+        len = 8;
+    }
+    else
+    {
+        Stream_Put16(&payload[4], (uint16)frame->msg.id);
+        len = 6;
+    }
+    for(i = 0; i < frame->msg.dlc; i++) payload[len++] = frame->msg.data[i];
+
+    return Stream_Emit(record, (frame->msg.idType == MCP2515_FRAME_EXT) ? STREAM_REC_CAN_EXT
+                                                                      : STREAM_REC_CAN_STD, len);
+}
+
+boolean Stream_SendSample(uint32 timestampUs, uint16 signalId, sint32 value, uint8 decimals)
+{
+    uint8 record[STREAM_MAX_RECORD];
+    uint8 *payload = &record[STREAM_HEADER_LEN];
+
+    Stream_Put32(payload, timestampUs);
+    Stream_Put16(&payload[4], signalId);
+    Stream_Put32(&payload[6], (uint32)value);
+    payload[10] = decimals;
+    return Stream_Emit(record, STREAM_REC_SAMPLE, 11);
+}
+
+boolean Stream_SendSnifferStats(const Sniffer_Stats *stats)
+{
+    uint8 record[STREAM_MAX_RECORD];
+    uint8 *payload = &record[STREAM_HEADER_LEN];
+
+    Stream_Put32(payload, stats->framesTotal);
+    Stream_Put32(&payload[4], stats->ringDrops);
+    Stream_Put32(&payload[8], stats->hwOverruns);
+    Stream_Put16(&payload[12], stats->framesPerSec);
+    Stream_Put16(&payload[14], stats->peakFramesPerSec);
+    Stream_Put16(&payload[16], stats->busLoadPermille);
+    Stream_Put32(&payload[18], streamDrops);
+    return Stream_Emit(record, STREAM_REC_STATS, 22);
+}
+
+boolean Stream_SendText(uint32 timestampUs, const char *label, sint32 value, uint8 decimals)
+{
+    uint8 record[STREAM_MAX_RECORD];
+    uint8 *payload = &record[STREAM_HEADER_LEN];
+    uint8 len = 4;
+
+    Stream_Put32(payload, timestampUs);
+    while(*label != '\0' && len < STREAM_MAX_PAYLOAD - FMT_BUFFER_SIZE)
+    {
+        payload[len++] = (uint8)*label++;
+    }
+    payload[len++] = ' ';
+    /* The NUL lands where the CRC goes and is overwritten */
+    len += Fmt_Fixed((char *)&payload[len], value, decimals, 0, 0);
+    return Stream_Emit(record, STREAM_REC_TEXT, len);
+}
+
+uint16 Stream_Pump(uint16 maxFrames)
+{
+    Sniffer_Frame frame;
+    uint16 sent = 0;
+
+    while(sent < maxFrames && UART0_TxFree() >= STREAM_MAX_RECORD && Sniffer_Read(&frame))
+    {
+        Stream_SendCanFrame(&frame);
+        sent++;
+    }
+    return sent;
+}
+
+/* Past STREAM_PACK_SIGNALS the spare channel is reset every time */
+static Codec_Channel *Stream_PackChannel(uint8 signal)
+{
+    uint8 i;
+
+    for(i = 0; i < packCount; i++)
+    {
+        if(packIds[i] == signal) return &packChannels[i];
+    }
+    if(packCount < STREAM_PACK_SIGNALS)
+    {
+        packIds[packCount] = signal;
+        Codec_Reset(&packChannels[packCount]);
+        return &packChannels[packCount++];
+    }
+    Codec_Reset(&packSpare);
+    return &packSpare;
+}
+
+static void Stream_PackPut(uint8 signal, const uint8 *token, uint8 len)
+{
+    uint8 *payload = &packRecord[STREAM_HEADER_LEN];
+    uint8 i;
+
+    if(packLen == 0)
+    {
+        Stream_Put32(payload, packBaseMs);
+        packLen = 4;
+    }
+    payload[packLen++] = signal;
+    for(i = 0; i < len; i++) payload[packLen++] = token[i];
+}
+
+static boolean Stream_PackSend(void)
+{
+    uint8 i;
+    boolean sent;
+
+    if(packLen == 0) return TRUE;
+    sent = Stream_Emit(packRecord, STREAM_REC_PACKED, packLen);
+    packLen = 0;
+
+    /* The host lost this state with the record: start again from key frames */
+    if(!sent)
+    {
+        for(i = 0; i < packCount; i++) Codec_Reset(&packChannels[i]);
+    }
+    return sent;
+}
+
+boolean Stream_PackSample(uint8 signal, sint32 value, uint32 timeMs)
+{
+    Codec_Channel *ch = Stream_PackChannel(signal);
+    Codec_Channel next = *ch;
+    uint8 token[CODEC_GROUP_MAX];
+    boolean sent = TRUE;
+    uint8 len;
+
+    if(packLen == 0) packBaseMs = timeMs;
+    len = Codec_Encode(&next, value, timeMs, packBaseMs, token);
+    if(len > 0 && packLen != 0 && packLen + 1 + len > STREAM_MAX_PAYLOAD)
+    {
+        /* A key frame's offset depends on the record: encode it again */
+        sent = Stream_PackSend();
+        packBaseMs = timeMs;
+        next = *ch;
+        len = Codec_Encode(&next, value, timeMs, packBaseMs, token);
+    }
+
+    *ch = next;
+    if(len > 0) Stream_PackPut(signal, token, len);
+    return sent;
+}
+
+boolean Stream_PackFlush(void)
+{
+    uint8 token[CODEC_FLUSH_MAX];
+    boolean sent = TRUE;
+    uint8 i, len;
+
+    for(i = 0; i < packCount; i++)
+    {
+        len = Codec_Flush(&packChannels[i], token);
+        if(len == 0) continue;
+        if(packLen != 0 && packLen + 1 + len > STREAM_MAX_PAYLOAD)
+        {
+            if(!Stream_PackSend()) sent = FALSE;
+        }
+        Stream_PackPut(packIds[i], token, len);
+    }
+    if(!Stream_PackSend()) sent = FALSE;
+    return sent;
+}
+
+uint32 Stream_GetDrops(void)
+{
+    return streamDrops;
+}
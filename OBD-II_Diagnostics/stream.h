@@ -0,0 +1,79 @@
+/******************************************************************************
+ *
+ * Module: Stream
+ *
+ * File Name: stream.h
+ *
+ * Description: Header file for the binary UART0 export of captured CAN
+ * frames and decoded signal samples. The record layout below is shared
+ * with the host decoder (Tools/stream_decode.c).
+ *
+ * Record:  SYNC | LEN | TYPE | SEQ | PAYLOAD[LEN] | CRC16 (LE)
+ *          CRC-16/CCITT-FALSE (crc16.c) over LEN, TYPE, SEQ and PAYLOAD.
+ *          All multi-byte payload fields are little endian.
+ *
+ *******************************************************************************/
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "std_types.h"
+#include "sniffer.h"
+#include "codec.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define STREAM_SYNC                 0xA5
+#define STREAM_HEADER_LEN           4
+#define STREAM_CRC_LEN              2
+#define STREAM_MAX_PAYLOAD          32
+#define STREAM_MAX_RECORD           (STREAM_HEADER_LEN + STREAM_MAX_PAYLOAD + STREAM_CRC_LEN)
+
+/* Record Types */
+#define STREAM_REC_CAN_STD          0x01    /* ts32, id16, data[LEN-6] */
+#define STREAM_REC_CAN_EXT          0x02    /* ts32, id32, data[LEN-8] */
+#define STREAM_REC_SAMPLE           0x03    /* ts32, signal16, value32, decimals8 */
+#define STREAM_REC_STATS            0x04    /* frames32, ringDrops32, hwOverruns32,
+                                               fps16, peakFps16, loadPermille16,
+                                               streamDrops32 */
+#define STREAM_REC_TEXT             0x05    /* ts32, ASCII[LEN-4], no NUL */
+#define STREAM_REC_PACKED           0x06    /* baseMs32, then (signal8, codec token)...
+                                               see codec.h; key frame times are
+                                               ms from baseMs */
+
+#define STREAM_PACK_SIGNALS         16      /* Compressed; more are sent as key frames */
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+void Stream_Init(uint32 baudRate);
+
+/* Each call encodes one record; it is dropped (and counted) if the UART
+ * ring is full, so callers never wait on the serial line. */
+boolean Stream_SendCanFrame(const Sniffer_Frame *frame);
+boolean Stream_SendSample(uint32 timestampUs, uint16 signalId, sint32 value, uint8 decimals);
+boolean Stream_SendSnifferStats(const Sniffer_Stats *stats);
+
+/* A readable "label value" line, e.g. "rpm 1726" or "volt 12.6", for a
+ * terminal or log next to the binary records; the label is cut to fit */
+boolean Stream_SendText(uint32 timestampUs, const char *label, sint32 value, uint8 decimals);
+
+/* Move up to maxFrames frames from the sniffer ring to the UART, only as
+ * far as the TX ring has room; frames left behind stay in the sniffer ring */
+uint16 Stream_Pump(uint16 maxFrames);
+
+/* Compressed samples: tokens collect in one record that goes out when the
+ * next one would not fit. Codec state carries over between records, so
+ * after a dropped record every signal restarts with a key frame (the host
+ * waits for it). FALSE if a record had to be dropped */
+boolean Stream_PackSample(uint8 signal, sint32 value, uint32 timeMs);
+
+/* Send the open record, with the repeats the codec still holds */
+boolean Stream_PackFlush(void);
+
+uint32 Stream_GetDrops(void);
+
+#endif /* STREAM_H_ */
@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ * Module: Time
+ *
+ * File Name: timebase.c
+ *
+ * Description: Source file for the SysTick monotonic time base
+ *
+ *******************************************************************************/
+
+#include "timebase.h"
+#include "tm4c123gh6pm_registers.h"
+#include "clock.h"
+
+static volatile uint32 timeMs = 0;
+static uint32 timeReload = CLOCK_RESET_HZ / TIME_TICK_HZ - 1;
+static uint32 timeCyclesPerUs = CLOCK_RESET_HZ / 1000000;
+
+void Time_Init(void)
+{
+    /* Tick period from the running core clock (80 MHz / 1 kHz fits in 24 bits) */
+    timeReload = Clock_GetHz() / TIME_TICK_HZ - 1;
+    timeCyclesPerUs = Clock_GetHz() / 1000000;
+
+    SYSTICK_CTRL_REG = 0;
+    SYSTICK_RELOAD_REG = timeReload;
+    SYSTICK_CURRENT_REG = 0;
+    NVIC_SYSTEM_PRI3_REG = (NVIC_SYSTEM_PRI3_REG & 0x1FFFFFFF) | ((uint32)TIME_SYSTICK_PRIORITY << 29);
+    SYSTICK_CTRL_REG = SYSTICK_CTRL_ENABLE | SYSTICK_CTRL_INTEN | SYSTICK_CTRL_CLK_SRC;
+}
+
+void SysTick_Handler(void)
+{
+    timeMs++;
+}
+
+uint32 Time_NowMs(void)
+{
+    return timeMs;
+}
+
+uint32 Time_NowUs(void)
+{
+    uint32 ms, count;
+
+    /* Re-read if the tick interrupt ran between the two reads */
+    do
+    {
+        ms = timeMs;
+        count = SYSTICK_CURRENT_REG;
+    } while(ms != timeMs);
+
+    return ms * 1000u + (timeReload - count) / timeCyclesPerUs;
+}
+
+void Time_Sleep(void)
+{
+    __asm("    WFI");
+}
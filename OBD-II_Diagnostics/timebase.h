@@ -0,0 +1,57 @@
+/******************************************************************************
+ *
+ * Module: Time
+ *
+ * File Name: timebase.h
+ *
+ * Description: Header file for the SysTick monotonic time base.
+ * SysTick interrupts every 1 ms; Time_NowUs adds the elapsed part of the
+ * current tick from the SysTick counter. Both counters wrap (ms after
+ * ~49 days, us after ~71 minutes), so compare times only through the
+ * deadline macros below, which are wrap-safe for spans under half the range.
+ *
+ *******************************************************************************/
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+#define TIME_TICK_HZ                1000
+
+/* SysTick Control Bits */
+#define SYSTICK_CTRL_ENABLE         0x00000001
+#define SYSTICK_CTRL_INTEN          0x00000002
+#define SYSTICK_CTRL_CLK_SRC        0x00000004  /* Core clock */
+
+/* SysTick priority (SYSPRI3 bits 31:29) */
+#define TIME_SYSTICK_PRIORITY       1
+
+/* Deadlines: TIME_DEADLINE_MS(100) is "100 ms from now" */
+#define TIME_DEADLINE_MS(ms)        (Time_NowMs() + (uint32)(ms))
+#define TIME_EXPIRED_MS(deadline)   ((sint32)(Time_NowMs() - (uint32)(deadline)) >= 0)
+#define TIME_DEADLINE_US(us)        (Time_NowUs() + (uint32)(us))
+#define TIME_EXPIRED_US(deadline)   ((sint32)(Time_NowUs() - (uint32)(deadline)) >= 0)
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+/* Start the 1 ms SysTick; call after Clock_Init and before anything that
+ * delays or times out */
+void Time_Init(void);
+
+uint32 Time_NowMs(void);
+uint32 Time_NowUs(void);
+
+/* Sleep (WFI) until the next interrupt; at most one tick */
+void Time_Sleep(void);
+
+/* SysTick vector (tm4c123gh6pm_startup_ccs.c) */
+void SysTick_Handler(void);
+
+#endif /* TIMEBASE_H_ */
@@ -10,7 +10,9 @@
 
 MEMORY
 {
-    FLASH (RX) : origin = 0x00000000, length = 0x00040000
+    FLASH (RX) : origin = 0x00000000, length = 0x00010000
+    /* 0x10000-0x3FFFF: signal log pages (log.h), nothing linked there */
+    LOG   (R)  : origin = 0x00010000, length = 0x00030000
     SRAM (RWX) : origin = 0x20000000, length = 0x00008000
 }
 
@@ -0,0 +1,110 @@
+/******************************************************************************
+ *
+ * Module: UART
+ *
+ * File Name: uart.c
+ *
+ * Description: Source file for the interrupt-driven UART0 transmitter
+ * Producer: main context (UART0_Write), consumer: UART0 TX FIFO interrupt
+ *
+ *******************************************************************************/
+
+#include "uart.h"
+#include "tm4c123gh6pm_registers.h"
+#include "clock.h"
+#include "gpio.h"
+
+#define UART_TX_RING_MASK       (UART_TX_RING_SIZE - 1)
+
+static uint8 txRing[UART_TX_RING_SIZE];
+static volatile uint16 txHead = 0;  /* Written by UART0_Write only */
+static volatile uint16 txTail = 0;  /* Written by the FIFO refill only */
+
+static const GPIO_PortConfig uartPinConfig = {
+    GPIO_PORTA, 0u, 0u, PIN0 | PIN1, 0u, 0u, 0u, GPIO_PCTL(0, 1) | GPIO_PCTL(1, 1)
+};
+
+void UART0_Init(uint32 baudRate)
+{
+    uint32 clockHz = Clock_GetHz();
+    uint32 divisor, clkDiv;
+
+    /* 1. Enable Clock for UART0 */
+    SYSCTL_RCGCUART_REG |= 0x01;
+    while((SYSCTL_PRUART_REG & 0x01) == 0);
+
+    /* 2. Configure PA0 (U0RX) and PA1 (U0TX) */
+    GPIO_Configure(&uartPinConfig, 1u);
+
+    /* 3. Baud rate: 8x oversampling keeps 921600 accurate at low clocks */
+    UART0_CTL_REG = 0;
+    clkDiv = (clockHz / (16 * baudRate) < 8) ? 8 : 16;
+
+    /* Divisor in 1/64 units, rounded: BRD = clk / (clkDiv * baud) */
+    divisor = (uint32)((((uint64)clockHz * 128u) / (clkDiv * baudRate) + 1) / 2);
+    UART0_IBRD_REG = divisor >> 6;
+    UART0_FBRD_REG = divisor & 0x3F;
+
+    /* 4. 8N1, FIFOs on; TX interrupt when the FIFO drains to 1/8 */
+    UART0_LCRH_REG = UART_LCRH_WLEN_8 | UART_LCRH_FEN;
+    UART0_IFLS_REG = UART_IFLS_TX_1_8;
+    UART0_CC_REG = 0;   /* System clock */
+    UART0_IM_REG = 0;
+
+    UART0_CTL_REG = UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE |
+                    ((clkDiv == 8) ? UART_CTL_HSE : 0);
+
+    txHead = 0;
+    txTail = 0;
+
+    /* Below the CAN RX interrupt so streaming never delays frame reads */
+    NVIC_PRI1_REG = (NVIC_PRI1_REG & ~0x0000E000) | (3u << 13);
+    NVIC_EN0_REG = (1u << UART0_IRQ);
+}
+
+uint16 UART0_TxFree(void)
+{
+    return (uint16)(UART_TX_RING_MASK - ((txHead - txTail) & UART_TX_RING_MASK));
+}
+
+/* Move ring bytes into the hardware FIFO until it is full */
+static void UART0_FillFifo(void)
+{
+    uint16 tail = txTail;
+
+    while(tail != txHead && (UART0_FR_REG & UART_FR_TXFF) == 0)
+    {
+        UART0_DR_REG = txRing[tail];
+        tail = (tail + 1) & UART_TX_RING_MASK;
+    }
+    txTail = tail;
+
+    if(tail == txHead) UART0_IM_REG &= ~UART_INT_TX;
+    else               UART0_IM_REG |= UART_INT_TX;
+}
+
+boolean UART0_Write(const uint8 *data, uint16 length)
+{
+    uint16 head = txHead;
+    uint16 i;
+
+    if(length > UART0_TxFree()) return FALSE;
+
+    for(i = 0; i < length; i++)
+    {
+        txRing[head] = data[i];
+        head = (head + 1) & UART_TX_RING_MASK;
+    }
+    txHead = head;
+
+    /* Kick the transmitter with the interrupt masked */
+    UART0_IM_REG &= ~UART_INT_TX;
+    UART0_FillFifo();
+    return TRUE;
+}
+
+void UART0_Handler(void)
+{
+    UART0_ICR_REG = UART_INT_TX;
+    UART0_FillFifo();
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ * Module: UART
+ *
+ * File Name: uart.h
+ *
+ * Description: Header file for the interrupt-driven UART0 transmitter
+ * (PA0 = U0RX, PA1 = U0TX, routed to the LaunchPad ICDI virtual COM port)
+ *
+ *******************************************************************************/
+
+#ifndef UART_H_
+#define UART_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* Control / Flag Bits */
+#define UART_CTL_UARTEN         0x00000001
+#define UART_CTL_HSE            0x00000020  /* 8x oversampling */
+#define UART_CTL_TXE            0x00000100
+#define UART_CTL_RXE            0x00000200
+#define UART_LCRH_WLEN_8        0x00000060
+#define UART_LCRH_FEN           0x00000010
+#define UART_FR_TXFF            0x00000020
+#define UART_INT_TX             0x00000020
+#define UART_IFLS_TX_1_8        0x00000000
+
+#define UART0_IRQ               5
+
+#define UART_BAUDRATE_115200    115200
+#define UART_BAUDRATE_921600    921600
+
+/* TX ring capacity (power of two): ~22 ms of data at 921600 baud */
+#define UART_TX_RING_SIZE       2048
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+void UART0_Init(uint32 baudRate);
+
+/* Queue the whole buffer or nothing; never blocks. Returns FALSE if full. */
+boolean UART0_Write(const uint8 *data, uint16 length);
+
+/* Free space in the TX ring */
+uint16 UART0_TxFree(void);
+
+/* UART0 TX interrupt (vector table: UART0 Rx and Tx) */
+void UART0_Handler(void);
+
+#endif /* UART_H_ */
@@ -0,0 +1,196 @@
+/******************************************************************************
+ *
+ * Module: UDS (ISO 14229)
+ *
+ * File Name: uds.c
+ *
+ * Description: Source file for the UDS client
+ * Request/response handling with NRC 0x21/0x78 retries and S3 keepalive
+ *
+ *******************************************************************************/
+
+#include "uds.h"
+#include "isotp.h"
+#include "delay.h"
+
+void UDS_Init(UDS_Client *client, uint32 txId, uint32 rxId,
+              const UDS_DidInfo *didTable, uint8 didCount)
+{
+    client->txId = txId;
+    client->rxId = rxId;
+    client->didTable = didTable;
+    client->didCount = didCount;
+    client->session = UDS_SESSION_DEFAULT;
+    client->lastNrc = 0;
+    client->p2 = UDS_P2_DEFAULT;
+    client->p2Star = UDS_P2_STAR_DEFAULT;
+    client->idleMs = 0;
+}
+
+/* Send one request and wait for its final (non-pending) response */
+static uint8 UDS_Exchange(UDS_Client *client, const uint8 *request, uint16 reqLen,
+                          uint8 *response, uint16 *respLen)
+{
+    ISOTP_Link link;
+    uint32 timeout;
+    uint8 retries = 0;
+
+    client->lastNrc = 0;
+    client->idleMs = 0;
+
+    for(;;)
+    {
+        ISOTP_InitLink(&link, client->txId, client->rxId, client->rxId);
+        if(ISOTP_Send(&link, request, reqLen) != ISOTP_STATUS_OK) return UDS_STATUS_ERROR;
+        timeout = client->p2;
+
+        for(;;)
+        {
+            if(ISOTP_Receive(&link, response, UDS_MAX_RESPONSE_LEN, respLen, timeout) != ISOTP_STATUS_OK)
+            {
+                return UDS_STATUS_TIMEOUT;
+            }
+            if(response[0] != UDS_NEGATIVE_RESPONSE) break;
+            if(*respLen < 3 || response[1] != request[0]) return UDS_STATUS_ERROR;
+
+            client->lastNrc = response[2];
+            if(client->lastNrc != UDS_NRC_RESPONSE_PENDING) break;
+
+            /* 0x78: the ECU extends its deadline to P2* */
+            timeout = client->p2Star;
+        }
+
+        if(response[0] != UDS_NEGATIVE_RESPONSE)
+        {
+            if(response[0] != (uint8)(request[0] + UDS_RESPONSE_OFFSET)) return UDS_STATUS_ERROR;
+            client->lastNrc = 0;
+            return UDS_STATUS_OK;
+        }
+
+        /* 0x21: repeat the same request after a short pause */
+        if(client->lastNrc != UDS_NRC_BUSY_REPEAT || ++retries > UDS_MAX_BUSY_RETRIES)
+        {
+            return UDS_STATUS_NEGATIVE;
+        }
+        Delay_MS(UDS_BUSY_RETRY_DELAY);
+    }
+}
+
+uint8 UDS_SessionControl(UDS_Client *client, uint8 session)
+{
+    uint8 request[2];
+    uint8 response[UDS_MAX_RESPONSE_LEN];
+    uint16 respLen;
+    uint8 status;
+
+    request[0] = UDS_SID_SESSION_CONTROL;
+    request[1] = session;
+
+    status = UDS_Exchange(client, request, 2, response, &respLen);
+    if(status != UDS_STATUS_OK) return status;
+    if(respLen < 2 || response[1] != session) return UDS_STATUS_ERROR;
+
+    client->session = session;
+
+    /* Session parameter record: P2 (1 ms), P2* (10 ms) */
+    if(respLen >= 6)
+    {
+        client->p2 = ((uint16)response[2] << 8) | response[3];
+        client->p2Star = (((uint32)response[4] << 8) | response[5]) * 10u;
+        if(client->p2 == 0) client->p2 = UDS_P2_DEFAULT;
+        if(client->p2Star == 0) client->p2Star = UDS_P2_STAR_DEFAULT;
+    }
+    return UDS_STATUS_OK;
+}
+
+uint8 UDS_TesterPresent(UDS_Client *client)
+{
+    ISOTP_Link link;
+    uint8 request[2];
+
+    request[0] = UDS_SID_TESTER_PRESENT;
+    request[1] = UDS_SUPPRESS_POS_RESPONSE;
+
+    client->idleMs = 0;
+    ISOTP_InitLink(&link, client->txId, client->rxId, client->rxId);
+    return (ISOTP_Send(&link, request, 2) == ISOTP_STATUS_OK) ? UDS_STATUS_OK : UDS_STATUS_ERROR;
+}
+
+void UDS_KeepAlive(UDS_Client *client, uint32 elapsedMs)
+{
+    if(client->session == UDS_SESSION_DEFAULT) return;
+
+    client->idleMs += elapsedMs;
+    if(client->idleMs >= UDS_S3_KEEPALIVE)
+    {
+        UDS_TesterPresent(client);
+    }
+}
+
+const UDS_DidInfo *UDS_GetDidInfo(const UDS_Client *client, uint16 did)
+{
+    uint8 i;
+    for(i = 0; i < client->didCount; i++)
+    {
+        if(client->didTable[i].did == did) return &client->didTable[i];
+    }
+    return NULL_PTR;
+}
+
+uint8 UDS_DecodeDid(const UDS_Client *client, const UDS_DidValue *value, sint32 *scaled)
+{
+    const UDS_DidInfo *info = UDS_GetDidInfo(client, value->did);
+    uint32 raw = 0;
+    uint8 i;
+
+    if(info == NULL_PTR || value->length != info->length || info->length > 4) return UDS_STATUS_ERROR;
+
+    for(i = 0; i < info->length; i++) raw = (raw << 8) | value->data[i];
+    *scaled = (sint32)((raw * info->mul) / info->div) + info->offset;
+    return UDS_STATUS_OK;
+}
+
+uint8 UDS_ReadDataByIdentifier(UDS_Client *client, const uint16 *dids, uint8 count,
+                               UDS_DidValue *values, uint8 *found)
+{
+    uint8 request[1 + 2 * UDS_MAX_DIDS_PER_REQUEST];
+    uint8 response[UDS_MAX_RESPONSE_LEN];
+    const UDS_DidInfo *info;
+    uint16 respLen, pos, did;
+    uint16 reqLen = 1;
+    uint8 status, i;
+
+    *found = 0;
+    if(count == 0 || count > UDS_MAX_DIDS_PER_REQUEST) return UDS_STATUS_ERROR;
+
+    /* 1. Build request: [22 DID_hi DID_lo ...] */
+    request[0] = UDS_SID_READ_DATA_BY_ID;
+    for(i = 0; i < count; i++)
+    {
+        if(UDS_GetDidInfo(client, dids[i]) == NULL_PTR) return UDS_STATUS_ERROR;
+        request[reqLen++] = (uint8)(dids[i] >> 8);
+        request[reqLen++] = (uint8)dids[i];
+    }
+
+    status = UDS_Exchange(client, request, reqLen, response, &respLen);
+    if(status != UDS_STATUS_OK) return status;
+
+    /* 2. Split [62 DID data DID data ...] using the DID table lengths */
+    pos = 1;
+    while(pos + 2 <= respLen && *found < count)
+    {
+        did = ((uint16)response[pos] << 8) | response[pos + 1];
+        pos += 2;
+
+        info = UDS_GetDidInfo(client, did);
+        if(info == NULL_PTR || info->length > UDS_MAX_DID_DATA || pos + info->length > respLen) break;
+
+        values[*found].did = did;
+        values[*found].length = info->length;
+        for(i = 0; i < info->length; i++) values[*found].data[i] = response[pos + i];
+        (*found)++;
+        pos += info->length;
+    }
+
+    return (*found > 0) ? UDS_STATUS_OK : UDS_STATUS_ERROR;
+}
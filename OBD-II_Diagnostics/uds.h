@@ -0,0 +1,112 @@
+/******************************************************************************
+ *
+ * Module: UDS (ISO 14229)
+ *
+ * File Name: uds.h
+ *
+ * Description: Header file for the UDS client (0x10, 0x22, 0x3E) running on
+ * top of the ISO-TP layer with physical addressing
+ *
+ *******************************************************************************/
+
+#ifndef UDS_H_
+#define UDS_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ * Definitions                                   *
+ *******************************************************************************/
+
+/* Default physical addressing of the engine ECU */
+#define UDS_ECU_REQUEST_ID          0x7E0
+#define UDS_ECU_RESPONSE_ID         0x7E8
+
+/* Services */
+#define UDS_SID_SESSION_CONTROL     0x10
+#define UDS_SID_READ_DATA_BY_ID     0x22
+#define UDS_SID_TESTER_PRESENT      0x3E
+#define UDS_RESPONSE_OFFSET         0x40
+#define UDS_NEGATIVE_RESPONSE       0x7F
+#define UDS_SUPPRESS_POS_RESPONSE   0x80
+
+/* Sessions */
+#define UDS_SESSION_DEFAULT         0x01
+#define UDS_SESSION_PROGRAMMING     0x02
+#define UDS_SESSION_EXTENDED        0x03
+
+/* Negative Response Codes */
+#define UDS_NRC_BUSY_REPEAT         0x21
+#define UDS_NRC_REQUEST_OUT_OF_RANGE 0x31
+#define UDS_NRC_RESPONSE_PENDING    0x78
+
+/* Timing (ms) */
+#define UDS_P2_DEFAULT              50
+#define UDS_P2_STAR_DEFAULT         5000
+#define UDS_S3_KEEPALIVE            2000    /* TesterPresent period (S3 = 5000) */
+#define UDS_BUSY_RETRY_DELAY        10
+#define UDS_MAX_BUSY_RETRIES        3
+
+/* Limits */
+#define UDS_MAX_DIDS_PER_REQUEST    8
+#define UDS_MAX_DID_DATA            8
+#define UDS_MAX_RESPONSE_LEN        128
+
+/* Status Codes */
+#define UDS_STATUS_OK               0
+#define UDS_STATUS_ERROR            1
+#define UDS_STATUS_TIMEOUT          2
+#define UDS_STATUS_NEGATIVE         3   /* See client->lastNrc */
+
+/* DID table entry: value = raw * mul / div + offset, in units of 10^-decimals */
+typedef struct {
+    uint16 did;
+    uint8  length;
+    uint16 mul;
+    uint16 div;
+    sint16 offset;
+    uint8  decimals;
+} UDS_DidInfo;
+
+typedef struct {
+    uint16 did;
+    uint8  length;
+    uint8  data[UDS_MAX_DID_DATA];
+} UDS_DidValue;
+
+typedef struct {
+    uint32 txId;
+    uint32 rxId;
+    const UDS_DidInfo *didTable;    /* Manufacturer specific DID layout */
+    uint8  didCount;
+    uint8  session;
+    uint8  lastNrc;
+    uint16 p2;                      /* Reported by the ECU in the session response */
+    uint32 p2Star;                  /* 10 ms units on the wire: up to 655 s */
+    uint32 idleMs;                  /* Time since the last request (S3) */
+} UDS_Client;
+
+/*******************************************************************************
+ * Function Prototypes                               *
+ *******************************************************************************/
+
+void UDS_Init(UDS_Client *client, uint32 txId, uint32 rxId,
+              const UDS_DidInfo *didTable, uint8 didCount);
+
+/* 0x10 DiagnosticSessionControl */
+uint8 UDS_SessionControl(UDS_Client *client, uint8 session);
+
+/* 0x3E TesterPresent (suppressed positive response) */
+uint8 UDS_TesterPresent(UDS_Client *client);
+
+/* Call periodically; sends TesterPresent while a non-default session is open */
+void UDS_KeepAlive(UDS_Client *client, uint32 elapsedMs);
+
+/* 0x22 ReadDataByIdentifier with several DIDs per request */
+uint8 UDS_ReadDataByIdentifier(UDS_Client *client, const uint16 *dids, uint8 count,
+                               UDS_DidValue *values, uint8 *found);
+
+const UDS_DidInfo *UDS_GetDidInfo(const UDS_Client *client, uint16 did);
+uint8 UDS_DecodeDid(const UDS_Client *client, const UDS_DidValue *value, sint32 *scaled);
+
+#endif /* UDS_H_ */
@@ -0,0 +1,305 @@
+/******************************************************************************
+ *
+ * Tool: CAN Trace Replay (Linux host)
+ *
+ * File Name: can_replay.c
+ *
+ * Description: Feeds candump / Vector ASC traces through the simulated
+ * MCP2515 into the unmodified firmware driver stack (mcp2515.c, isotp.c,
+ * obd.c) and reports throughput.
+ *
+ *   raw  MCP2515_Receive only: driver + SPI command throughput
+ *   obd  ISOTP_Receive on 0x7E8-0x7EF, positive 0x41/0x42 responses split
+ *        with OBD_ParseResponse and scaled with OBD_DecodePid. The decoded
+ *        lines are stable across runs, so diffing them against a stored
+ *        copy regression-tests the decoder table on real-car traces.
+ *
+ * -z runs every decoded Mode 01 value through the sample codec (codec.c)
+ * as the flash log and the UART stream would, and reports the size against
+ * a fixed 9-byte record (time32, signal8, value32).
+ *
+ * By default frames are replayed as fast as the driver drains them (no
+ * overruns, virtual time). -r paces frames on the wall clock at their
+ * recorded timestamps, so RX overruns show where the polled path falls
+ * behind a real bus. -l repeats the trace to build multi-million frame runs.
+ *
+ * Build:  gcc -O2 -I../OBD-II_Diagnostics -I. -o can_replay can_replay.c \
+ *             trace.c sim_mcp2515.c host_port.c \
+ *             ../OBD-II_Diagnostics/mcp2515.c ../OBD-II_Diagnostics/isotp.c \
+ *             ../OBD-II_Diagnostics/obd.c ../OBD-II_Diagnostics/codec.c
+ *
+ * Usage:  can_replay [-m raw|obd] [-r] [-q] [-z] [-l loops] <trace|->
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_port.h"
+#include "sim_mcp2515.h"
+#include "trace.h"
+#include "mcp2515.h"
+#include "isotp.h"
+#include "obd.h"
+#include "codec.h"
+
+#define REPLAY_RX_TIMEOUT_MS    1000
+#define REPLAY_LOOP_GAP_US      100000ULL   /* Idle bus between repetitions */
+#define REPLAY_MAX_MESSAGE      4095
+#define REPLAY_FIXED_RECORD     9           /* time32, signal8, value32 */
+
+typedef enum { MODE_RAW, MODE_OBD } ReplayMode;
+
+typedef struct {
+    Trace_Reader reader;
+    const char *path;
+    long loopsLeft;
+} ReplaySource;
+
+static int quiet = 0;
+
+static unsigned long isotpMessages = 0;
+static unsigned long isotpBytes = 0;
+static unsigned long isotpErrors = 0;
+static unsigned long obdResponses = 0;
+static unsigned long obdValues = 0;
+static unsigned long obdUnknown = 0;
+
+/* -z: codec size of the decoded values, one channel per PID */
+static int codecStats = 0;
+static Codec_Channel codecChannels[256];
+static int codecStarted = 0;
+static uint32 codecBaseMs;
+static unsigned long codecSamples = 0;
+static unsigned long codecBytes = 0;
+
+/* Trace source that rewinds for -l, keeping timestamps monotonic */
+static int Replay_Next(void *ctx, SimCan_Frame *frame)
+{
+    ReplaySource *src = (ReplaySource *)ctx;
+    uint64_t offset;
+
+    for(;;)
+    {
+        if(Trace_Next(&src->reader, frame)) return 1;
+        if(--src->loopsLeft <= 0 || src->reader.fp == stdin || src->reader.frames == 0) return 0;
+
+        offset = Trace_LastTimeUs(&src->reader) + REPLAY_LOOP_GAP_US;
+        Trace_Close(&src->reader);
+        if(!Trace_Open(&src->reader, src->path)) return 0;
+        src->reader.offsetUs = offset;
+    }
+}
+
+static void Replay_DiscardTx(void *ctx, const MCP2515_Message *msg)
+{
+    (void)ctx;
+    (void)msg;
+}
+
+static void Replay_Raw(void)
+{
+    MCP2515_Message msg;
+
+    while(!SimMcp_Idle())
+    {
+        if(MCP2515_Receive(&msg) != MCP2515_STATUS_OK && Host_IsRealtime()) usleep(50);
+    }
+}
+
+static void Replay_PrintValue(uint64_t timeUs, uint32 ecu, uint8 service, const OBD_PidValue *value)
+{
+    const OBD_PidInfo *info = OBD_GetPidInfo(value->pid);
+    sint32 scaled;
+    uint8 i;
+
+    if(quiet) return;
+    printf("%llu.%06llu %03lX %02X %02X ", (unsigned long long)(timeUs / 1000000ULL),
+           (unsigned long long)(timeUs % 1000000ULL), (unsigned long)ecu, service, value->pid);
+    for(i = 0; i < value->length; i++) printf("%02X", value->data[i]);
+    if(info != NULL_PTR && OBD_DecodePid(value, &scaled) == OBD_STATUS_OK)
+    {
+        printf(" %ld", (long)scaled);
+        if(info->decimals) printf("e-%u", info->decimals);
+    }
+    printf("\n");
+}
+
+static void Replay_Compress(uint64_t timeUs, const OBD_PidValue *value)
+{
+    uint8 token[CODEC_GROUP_MAX];
+    uint32 timeMs = (uint32)(timeUs / 1000ULL);
+    sint32 scaled;
+    uint8 len;
+
+    if(OBD_DecodePid(value, &scaled) != OBD_STATUS_OK) return;
+    if(!codecStarted)
+    {
+        codecBaseMs = timeMs;
+        codecStarted = 1;
+    }
+
+    /* Signal byte + token, as in a log page or a packed stream record */
+    len = Codec_Encode(&codecChannels[value->pid], scaled, timeMs, codecBaseMs, token);
+    if(len > 0) codecBytes += 1u + len;
+    codecSamples++;
+}
+
+/* Repeats still held in runs count too */
+static void Replay_CompressFlush(void)
+{
+    uint8 token[CODEC_FLUSH_MAX];
+    uint8 len;
+    int pid;
+
+    for(pid = 0; pid < 256; pid++)
+    {
+        len = Codec_Flush(&codecChannels[pid], token);
+        if(len > 0) codecBytes += 1u + len;
+    }
+}
+
+static void Replay_DecodeObd(uint64_t timeUs, uint32 ecu, const uint8 *msg, uint16 len)
+{
+    OBD_PidValue values[OBD_FREEZE_FRAME_MAX_PIDS];
+    uint8 service, frame, found, i;
+
+    if(len < 2) return;
+    if(msg[0] == OBD_MODE_CURRENT + OBD_RESPONSE_OFFSET) service = OBD_MODE_CURRENT;
+    else if(msg[0] == OBD_MODE_FREEZE_FRAME + OBD_RESPONSE_OFFSET) service = OBD_MODE_FREEZE_FRAME;
+    else return;
+
+    /* Mode 02 repeats the frame number after every PID */
+    frame = (service == OBD_MODE_FREEZE_FRAME && len >= 3) ? msg[2] : 0;
+
+    obdResponses++;
+    if(OBD_ParseResponse(service, frame, msg, len, values, OBD_FREEZE_FRAME_MAX_PIDS, &found) != OBD_STATUS_OK)
+    {
+        obdUnknown++;
+        return;
+    }
+    for(i = 0; i < found; i++)
+    {
+        Replay_PrintValue(timeUs, ecu, service, &values[i]);
+        if(codecStats && service == OBD_MODE_CURRENT) Replay_Compress(timeUs, &values[i]);
+    }
+    obdValues += found;
+}
+
+static void Replay_Obd(void)
+{
+    static uint8 buffer[REPLAY_MAX_MESSAGE];
+    ISOTP_Link link;
+    uint16 len;
+    uint8 status;
+
+    while(!SimMcp_Idle())
+    {
+        ISOTP_InitLink(&link, OBD_REQUEST_ID, OBD_RESPONSE_ID_MIN, OBD_RESPONSE_ID_MAX);
+        status = ISOTP_Receive(&link, buffer, sizeof(buffer), &len, REPLAY_RX_TIMEOUT_MS);
+        if(status == ISOTP_STATUS_OK)
+        {
+            isotpMessages++;
+            isotpBytes += len;
+            Replay_DecodeObd(SimMcp_LastRxTimeUs(), link.rxId, buffer, len);
+        }
+        else if(status != ISOTP_STATUS_TIMEOUT)
+        {
+            isotpErrors++;
+        }
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-m raw|obd] [-r] [-q] [-z] [-l loops] <trace|->\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static ReplaySource src;
+    const SimMcp_Stats *st;
+    MCP2515_Config cfg;
+    ReplayMode mode = MODE_OBD;
+    double t0, elapsed;
+    int realtime = 0;
+    int opt;
+
+    src.loopsLeft = 1;
+    while((opt = getopt(argc, argv, "m:rqzl:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'm': mode = (strcmp(optarg, "raw") == 0) ? MODE_RAW : MODE_OBD; break;
+            case 'r': realtime = 1; break;
+            case 'q': quiet = 1; break;
+            case 'z': codecStats = 1; break;
+            case 'l': src.loopsLeft = strtol(optarg, NULL, 10); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc || src.loopsLeft < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    src.path = argv[optind];
+    if(!Trace_Open(&src.reader, src.path))
+    {
+        perror(src.path);
+        return 1;
+    }
+
+    /* Bring the driver up exactly as the firmware does, then join the bus:
+     * Normal in obd mode so ISO-TP flow control goes out (and is discarded),
+     * Listen-only in raw mode like the sniffer */
+    Host_SetRealtime(0);
+    SimMcp_Reset();
+    cfg.baudRate = MCP2515_BAUD_500KBPS;
+    cfg.loopbackMode = FALSE;
+    if(MCP2515_Init(&cfg) != MCP2515_STATUS_OK ||
+       MCP2515_SetMode(mode == MODE_RAW ? MCP2515_MODE_LISTEN_ONLY : MCP2515_MODE_NORMAL) != MCP2515_STATUS_OK)
+    {
+        fprintf(stderr, "MCP2515 init failed\n");
+        return 1;
+    }
+    SimMcp_SetTxHook(Replay_DiscardTx, NULL);
+
+    Host_SetRealtime(realtime);
+    SimMcp_SetPaced(realtime);
+    SimMcp_SetSource(Replay_Next, &src);
+
+    t0 = Host_WallSeconds();
+    if(mode == MODE_RAW) Replay_Raw();
+    else Replay_Obd();
+    elapsed = Host_WallSeconds() - t0;
+    if(elapsed <= 0.0) elapsed = 1e-9;
+
+    st = SimMcp_GetStats();
+    fprintf(stderr, "trace: %lu frames, %lu lines skipped, %.3f s of bus time\n",
+            st->framesIn, src.reader.skipped, Trace_LastTimeUs(&src.reader) / 1e6);
+    fprintf(stderr, "driver: %lu frames read, %lu overruns, %lu SPI transactions (%.1f per frame), %lu TX\n",
+            st->framesRead, st->overruns, st->spiTransactions,
+            st->framesRead ? (double)st->spiTransactions / st->framesRead : 0.0, st->framesTx);
+    fprintf(stderr, "wall: %.3f s, %.0f frames/s, %.3f us/frame\n",
+            elapsed, st->framesRead / elapsed, st->framesRead ? elapsed * 1e6 / st->framesRead : 0.0);
+    if(mode == MODE_OBD)
+    {
+        fprintf(stderr, "isotp: %lu messages (%.0f msg/s, %lu bytes), %lu errors\n",
+                isotpMessages, isotpMessages / elapsed, isotpBytes, isotpErrors);
+        fprintf(stderr, "obd: %lu responses, %lu values, %lu unparsed\n", obdResponses, obdValues, obdUnknown);
+    }
+    if(mode == MODE_OBD && codecStats && codecSamples > 0)
+    {
+        Replay_CompressFlush();
+        fprintf(stderr, "codec: %lu samples, %lu bytes (%.2f per sample), %.1fx smaller than %d-byte records\n",
+                codecSamples, codecBytes, (double)codecBytes / codecSamples,
+                (double)codecSamples * REPLAY_FIXED_RECORD / (codecBytes ? codecBytes : 1), REPLAY_FIXED_RECORD);
+    }
+
+    Trace_Close(&src.reader);
+    return 0;
+}
@@ -0,0 +1,395 @@
+/******************************************************************************
+ *
+ * Tool: Virtual ECU Bench (Linux host)
+ *
+ * File Name: ecu_bench.c
+ *
+ * Description: Runs the unmodified obd.c / isotp.c / mcp2515.c against the
+ * virtual ECUs of sim_ecu.c in virtual time and checks every decoded value
+ * against what the ECU actually encoded. The workload follows main.c's
+ * polling order (RPM, speed, coolant, voltage) plus a six-PID
+ * OBD_RequestPids batch, a supported-PID scan every 100 cycles and a
+ * freeze-frame read every 1000 cycles. With -a the batch goes through
+ * OBD_StartRequest / OBD_PollResponse instead, one poll per 1 ms tick as
+ * in main.c's scheduler, and the longest single poll is reported.
+ *
+ * Reported: result counts per call (ok / timeout / error / mismatch),
+ * request latency in simulated time (mean, p50, p99, max), SPI
+ * transactions per request, ECU-side fault counters and host throughput.
+ *
+ * Build:  gcc -O2 -I../OBD-II_Diagnostics -I. -o ecu_bench ecu_bench.c \
+ *             sim_ecu.c sim_mcp2515.c host_port.c \
+ *             ../OBD-II_Diagnostics/mcp2515.c ../OBD-II_Diagnostics/isotp.c \
+ *             ../OBD-II_Diagnostics/obd.c -lm
+ *
+ * Usage:  ecu_bench [-n requests] [-e ecus] [-l minUs:maxUs] [-t permille:us]
+ *                   [-N permille[:nrc]] [-P permille:us] [-d permille]
+ *                   [-s seed] [-a] [-v]
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "host_port.h"
+#include "sim_mcp2515.h"
+#include "sim_ecu.h"
+#include "mcp2515.h"
+#include "obd.h"
+#include "timebase.h"
+
+#define BENCH_HIST_BIN_US       100
+#define BENCH_HIST_BINS         20000       /* 2 s */
+
+typedef enum {
+    OP_RPM, OP_SPEED, OP_COOLANT, OP_VOLTAGE, OP_BATCH, OP_SUPPORTED, OP_FREEZE, OP_COUNT
+} BenchOp;
+
+static const char *opNames[OP_COUNT] = {
+    "GetEngineRPM", "GetVehicleSpeed", "GetCoolantTemp", "GetBatteryVoltage",
+    "RequestPids x6", "GetSupportedPids", "ReadFreezeFrame"
+};
+
+typedef struct {
+    unsigned long calls;
+    unsigned long ok;
+    unsigned long timeout;
+    unsigned long error;
+    unsigned long mismatch;
+} OpStats;
+
+static OpStats opStats[OP_COUNT];
+static unsigned long latencyHist[BENCH_HIST_BINS + 1];
+static uint64_t latencyMax = 0;
+static double latencySum = 0.0;
+static unsigned long latencyCount = 0;
+static int verbose = 0;
+static int ecuCount = 1;
+static int asyncBatch = 0;
+static uint64_t pollMaxUs = 0;
+
+/* Engine ECU: fast-moving signals on every shape */
+static const SimEcu_Signal engineSignals[] = {
+    { 0x04, SIMECU_WAVE_NOISE,   10.0,   90.0,      0 },
+    { 0x05, SIMECU_WAVE_RAMP,   -40.0,  120.0, 120000 },
+    { 0x06, SIMECU_WAVE_SINE,   -10.0,   10.0,   3000 },
+    { 0x0B, SIMECU_WAVE_SINE,    30.0,  250.0,   7000 },
+    { 0x0C, SIMECU_WAVE_SINE,   750.0, 6500.0,  10000 },
+    { 0x0D, SIMECU_WAVE_RAMP,     0.0,  255.0,  60000 },
+    { 0x0E, SIMECU_WAVE_SQUARE,  -5.0,   35.0,   2000 },
+    { 0x0F, SIMECU_WAVE_CONST,   25.0,   25.0,      0 },
+    { 0x10, SIMECU_WAVE_SINE,     2.0,  180.0,   9000 },
+    { 0x11, SIMECU_WAVE_NOISE,    0.0,  100.0,      0 },
+    { 0x1F, SIMECU_WAVE_RAMP,     0.0, 65535.0, 65535000 },
+    { 0x2F, SIMECU_WAVE_RAMP,   100.0,    5.0, 600000 },
+    { 0x33, SIMECU_WAVE_CONST,  101.0,  101.0,      0 },
+    { 0x42, SIMECU_WAVE_SINE,    11.5,   14.7,   5000 },
+    { 0x46, SIMECU_WAVE_CONST,   18.0,   18.0,      0 },
+    { 0x5C, SIMECU_WAVE_RAMP,    20.0,  130.0, 300000 },
+};
+
+/* Other ECUs (transmission, ...) answer a small overlapping set */
+static const SimEcu_Signal auxSignals[] = {
+    { 0x0D, SIMECU_WAVE_RAMP,     0.0,  255.0,  60000 },
+    { 0x42, SIMECU_WAVE_SINE,    11.5,   14.7,   5000 },
+    { 0x46, SIMECU_WAVE_CONST,   18.0,   18.0,      0 },
+};
+
+static SimEcu_Config ecuConfig[SIMECU_MAX_ECUS];
+
+static void Bench_RecordLatency(uint64_t us)
+{
+    unsigned long bin = (unsigned long)(us / BENCH_HIST_BIN_US);
+    if(bin > BENCH_HIST_BINS) bin = BENCH_HIST_BINS;
+    latencyHist[bin]++;
+    latencySum += (double)us;
+    latencyCount++;
+    if(us > latencyMax) latencyMax = us;
+}
+
+static double Bench_Percentile(double p)
+{
+    unsigned long target = (unsigned long)ceil(p * latencyCount);
+    unsigned long seen = 0;
+    int i;
+
+    for(i = 0; i <= BENCH_HIST_BINS; i++)
+    {
+        seen += latencyHist[i];
+        if(seen >= target && seen > 0) return (i + 1) * BENCH_HIST_BIN_US / 1000.0;
+    }
+    return 0.0;
+}
+
+/* Does any ECU's last encoding of pid match the decoded value? */
+static int Bench_Matches(uint8 pid, double decoded, double tolerance)
+{
+    double expected;
+    int i;
+
+    for(i = 0; i < ecuCount; i++)
+    {
+        if(SimEcu_LastSent((uint8_t)i, pid, &expected) && fabs(decoded - expected) <= tolerance) return 1;
+    }
+    return 0;
+}
+
+static void Bench_Result(BenchOp op, uint8 status, int match, uint8 pid, double decoded)
+{
+    OpStats *s = &opStats[op];
+
+    if(status == OBD_STATUS_TIMEOUT) s->timeout++;
+    else if(status != OBD_STATUS_OK) s->error++;
+    else if(!match)
+    {
+        s->mismatch++;
+        if(verbose)
+        {
+            fprintf(stderr, "%.6f mismatch %s pid %02X decoded %g\n", Host_NowUs() / 1e6,
+                    opNames[op], pid, decoded);
+        }
+    }
+    else s->ok++;
+}
+
+/* The scheduler's path: start the request, then poll once per tick */
+static uint8 Bench_RequestAsync(const uint8 *pids, uint8 count, OBD_PidValue *values, uint8 *found)
+{
+    uint64_t start;
+    uint8 status;
+
+    *found = 0;
+    if(OBD_StartRequest(OBD_MODE_CURRENT, 0, pids, count) != OBD_STATUS_OK) return OBD_STATUS_ERROR;
+    for(;;)
+    {
+        start = Host_NowUs();
+        status = OBD_PollResponse(values, count, found);
+        if(Host_NowUs() - start > pollMaxUs) pollMaxUs = Host_NowUs() - start;
+        if(status != OBD_STATUS_PENDING) return status;
+        Time_Sleep();
+    }
+}
+
+static void Bench_Batch(void)
+{
+    static const uint8 pids[OBD_MAX_PIDS_MODE01] = { 0x04, 0x0B, 0x0C, 0x10, 0x11, 0x42 };
+    OBD_PidValue values[OBD_MAX_PIDS_MODE01];
+    const OBD_PidInfo *info;
+    sint32 scaled;
+    double decoded = 0.0;
+    uint8 status, found, i;
+    int match = 1;
+    uint8 badPid = 0;
+
+    if(asyncBatch) status = Bench_RequestAsync(pids, OBD_MAX_PIDS_MODE01, values, &found);
+    else status = OBD_RequestPids(OBD_MODE_CURRENT, 0, pids, OBD_MAX_PIDS_MODE01, values, &found);
+    if(status == OBD_STATUS_OK)
+    {
+        for(i = 0; i < found && match; i++)
+        {
+            info = OBD_GetPidInfo(values[i].pid);
+            if(info == NULL_PTR || OBD_DecodePid(&values[i], &scaled) != OBD_STATUS_OK)
+            {
+                match = 0;
+                badPid = values[i].pid;
+                break;
+            }
+            /* Integer decode truncates: allow one unit of the reported resolution */
+            decoded = scaled / pow(10.0, info->decimals);
+            if(!Bench_Matches(values[i].pid, decoded, pow(10.0, -info->decimals) + 1e-9))
+            {
+                match = 0;
+                badPid = values[i].pid;
+            }
+        }
+    }
+    Bench_Result(OP_BATCH, status, match, badPid, decoded);
+}
+
+static void Bench_Supported(void)
+{
+    uint32 supported[8];
+    uint32_t expected[8];
+    uint8 status;
+    int match = 0;
+    int e, w;
+
+    status = OBD_GetSupportedPids(OBD_MODE_CURRENT, 0, supported);
+    for(e = 0; e < ecuCount && status == OBD_STATUS_OK && !match; e++)
+    {
+        SimEcu_GetSupported((uint8_t)e, OBD_MODE_CURRENT, expected);
+        match = 1;
+        for(w = 0; w < 8; w++) if(supported[w] != expected[w]) match = 0;
+    }
+    Bench_Result(OP_SUPPORTED, status, match, 0, 0.0);
+}
+
+static void Bench_Freeze(void)
+{
+    static OBD_FreezeFrame ff;
+    uint8 status;
+    int match = 0;
+    int e;
+
+    status = OBD_ReadFreezeFrame(0, &ff);
+    for(e = 0; e < ecuCount && status == OBD_STATUS_OK; e++)
+    {
+        if(SimEcu_FreezeDtc((uint8_t)e) == ff.dtc) match = 1;
+    }
+    Bench_Result(OP_FREEZE, status, match, OBD_PID_FREEZE_DTC, ff.dtc);
+}
+
+static void Bench_Step(unsigned long n)
+{
+    uint16 rpm;
+    uint8 speed;
+    sint8 temp;
+    float32 volt;
+    uint8 status;
+    BenchOp op = (BenchOp)(n % 5);
+    uint64_t start = Host_NowUs();
+
+    if(n % 1000 == 999) op = OP_FREEZE;
+    else if(n % 100 == 99) op = OP_SUPPORTED;
+
+    opStats[op].calls++;
+    switch(op)
+    {
+        case OP_RPM:
+            status = OBD_GetEngineRPM(&rpm);
+            Bench_Result(op, status, Bench_Matches(OBD_PID_RPM, rpm, 1.0), OBD_PID_RPM, rpm);
+            break;
+        case OP_SPEED:
+            status = OBD_GetVehicleSpeed(&speed);
+            Bench_Result(op, status, Bench_Matches(OBD_PID_SPEED, speed, 0.0), OBD_PID_SPEED, speed);
+            break;
+        case OP_COOLANT:
+            status = OBD_GetCoolantTemp(&temp);
+            Bench_Result(op, status, Bench_Matches(OBD_PID_COOLANT, temp, 0.0), OBD_PID_COOLANT, temp);
+            break;
+        case OP_VOLTAGE:
+            status = OBD_GetBatteryVoltage(&volt);
+            Bench_Result(op, status, Bench_Matches(OBD_PID_VOLTAGE, volt, 0.0015), OBD_PID_VOLTAGE, volt);
+            break;
+        case OP_BATCH:
+            Bench_Batch();
+            break;
+        case OP_SUPPORTED:
+            Bench_Supported();
+            break;
+        default:
+            Bench_Freeze();
+            break;
+    }
+    Bench_RecordLatency(Host_NowUs() - start);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n requests] [-e ecus] [-l minUs:maxUs] [-t permille:us]\n"
+                    "          [-N permille[:nrc]] [-P permille:us] [-d permille] [-s seed] [-a] [-v]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    SimEcu_Config base;
+    const SimMcp_Stats *spi;
+    const SimEcu_Stats *es;
+    unsigned long requests = 100000, n;
+    unsigned long seed = 1;
+    unsigned a, b;
+    double t0, elapsed;
+    int opt, i;
+
+    memset(&base, 0, sizeof(base));
+    base.latencyMinUs = 1000;
+    base.latencyMaxUs = 5000;
+    base.negativeNrc = 0x22;
+    base.pendingUs = 20000;
+
+    while((opt = getopt(argc, argv, "n:e:l:t:N:P:d:s:av")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': requests = strtoul(optarg, NULL, 10); break;
+            case 'e': ecuCount = atoi(optarg); break;
+            case 'l': if(sscanf(optarg, "%u:%u", &a, &b) == 2) { base.latencyMinUs = a; base.latencyMaxUs = b; } break;
+            case 't': if(sscanf(optarg, "%u:%u", &a, &b) == 2) { base.tailPermille = (uint16_t)a; base.tailUs = b; } break;
+            case 'N':
+                i = sscanf(optarg, "%u:%x", &a, &b);
+                if(i >= 1) base.negativePermille = (uint16_t)a;
+                if(i == 2) base.negativeNrc = (uint8_t)b;
+                break;
+            case 'P': if(sscanf(optarg, "%u:%u", &a, &b) == 2) { base.pendingPermille = (uint16_t)a; base.pendingUs = b; } break;
+            case 'd': base.dropPermille = (uint16_t)atoi(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            case 'a': asyncBatch = 1; break;
+            case 'v': verbose = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(ecuCount < 1 || ecuCount > SIMECU_MAX_ECUS || base.latencyMaxUs < base.latencyMinUs)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* Bring the stack up the way main.c does; OBD_Init leaves the
+     * controller in loopback, so join the (virtual) bus afterwards */
+    Host_SetRealtime(0);
+    SimMcp_Reset();
+    SimMcp_SetPaced(1);
+    SimEcu_Init((uint32_t)seed);
+    for(i = 0; i < ecuCount; i++)
+    {
+        ecuConfig[i] = base;
+        ecuConfig[i].signals = (i == 0) ? engineSignals : auxSignals;
+        ecuConfig[i].signalCount = (uint8_t)((i == 0) ? sizeof(engineSignals) / sizeof(engineSignals[0])
+                                                      : sizeof(auxSignals) / sizeof(auxSignals[0]));
+        ecuConfig[i].freezeDtc = (i == 0) ? 0x0301 : 0;
+        SimEcu_Add((uint8_t)i, &ecuConfig[i]);
+    }
+    if(OBD_Init() != OBD_STATUS_OK || MCP2515_SetMode(MCP2515_MODE_NORMAL) != MCP2515_STATUS_OK)
+    {
+        fprintf(stderr, "OBD_Init failed\n");
+        return 1;
+    }
+
+    t0 = Host_WallSeconds();
+    for(n = 0; n < requests; n++) Bench_Step(n);
+    elapsed = Host_WallSeconds() - t0;
+    if(elapsed <= 0.0) elapsed = 1e-9;
+
+    printf("%-18s %10s %10s %10s %10s %10s\n", "call", "calls", "ok", "timeout", "error", "mismatch");
+    for(i = 0; i < OP_COUNT; i++)
+    {
+        printf("%-18s %10lu %10lu %10lu %10lu %10lu\n", opNames[i], opStats[i].calls, opStats[i].ok,
+               opStats[i].timeout, opStats[i].error, opStats[i].mismatch);
+    }
+
+    printf("\nlatency (simulated): mean %.2f ms, p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           latencyCount ? latencySum / latencyCount / 1000.0 : 0.0,
+           Bench_Percentile(0.50), Bench_Percentile(0.99), latencyMax / 1000.0);
+    if(asyncBatch) printf("poll: longest OBD_PollResponse %.1f ms\n", pollMaxUs / 1000.0);
+
+    spi = SimMcp_GetStats();
+    printf("driver: %.1f SPI transactions/request, %lu frames read, %lu overruns, %lu TX\n",
+           requests ? (double)spi->spiTransactions / requests : 0.0,
+           spi->framesRead, spi->overruns, spi->framesTx);
+
+    for(i = 0; i < ecuCount; i++)
+    {
+        es = SimEcu_GetStats((uint8_t)i);
+        printf("ecu %03X: %lu requests, %lu positive, %lu negative, %lu pending, "
+               "%lu frames sent, %lu dropped, %lu FC timeouts\n",
+               0x7E8 + i, es->requests, es->responses, es->negatives, es->pendings,
+               es->framesSent, es->framesDropped, es->fcTimeouts);
+    }
+
+    printf("host: %lu requests in %.3f s wall (%.0f requests/min), %.1f s simulated\n",
+           requests, elapsed, requests / elapsed * 60.0, Host_NowUs() / 1e6);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+ *
+ * Tool: Fmt Check (Linux host)
+ *
+ * File Name: fmt_check.c
+ *
+ * Description: Checks fmt.c on the host. The reciprocal multiply behind
+ * FMT_DIV100 is compared with n / 100 for every 32-bit n (a few seconds),
+ * then Fmt_UInt and Fmt_Fixed are compared with snprintf: every value up
+ * to 10^6 (and down to -10^6), both sides of every power of ten, the
+ * 32-bit limits and a pseudo-random sample of the full range, each at
+ * every decimals count, at several widths and with every flag.
+ * fmt.c is included rather than linked so the static macro is reachable.
+ * Exits with 1 on the first mismatches, so it can gate a change to fmt.c.
+ *
+ * Build:  gcc -O2 -I../OBD-II_Diagnostics -o fmt_check fmt_check.c
+ *
+ * Usage:  fmt_check [-n samples] [-s seed]
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fmt.c"
+
+#define CHECK_MAX_REPORTS   10
+
+static unsigned long failures = 0;
+static unsigned long checks = 0;
+static unsigned long long rngState = 1;
+
+/* xorshift64: repeatable samples for a given seed */
+static unsigned long long Check_Random(void)
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static void Check_Fail(const char *what, long long value, unsigned decimals, unsigned width,
+                       unsigned flags, const char *expected, const char *got)
+{
+    failures++;
+    if(failures <= CHECK_MAX_REPORTS)
+    {
+        fprintf(stderr, "%s(%lld, dec %u, width %u, flags %u): expected \"%s\", got \"%s\"\n",
+                what, value, decimals, width, flags, expected, got);
+    }
+}
+
+/* The documented output, built with snprintf; returns its length */
+static unsigned Check_Expected(char *out, long long value, unsigned decimals, unsigned width, unsigned flags)
+{
+    char natural[32];
+    unsigned long long magnitude = (value < 0) ? (unsigned long long)-value : (unsigned long long)value;
+    unsigned long long scale = 1;
+    const char *digits;
+    unsigned len, pad, i;
+    char *p = out;
+
+    for(i = 0; i < decimals; i++) scale *= 10;
+    if(decimals > 0)
+    {
+        snprintf(natural, sizeof(natural), "%s%llu.%0*llu", (value < 0) ? "-" : "",
+                 magnitude / scale, (int)decimals, magnitude % scale);
+    }
+    else
+    {
+        snprintf(natural, sizeof(natural), "%s%llu", (value < 0) ? "-" : "", magnitude);
+    }
+
+    len = (unsigned)strlen(natural);
+    if(width == 0) width = len;
+    if(len > width)
+    {
+        memset(out, FMT_OVERFLOW_CHAR, width);
+        out[width] = '\0';
+        return width;
+    }
+    pad = width - len;
+
+    if(flags & FMT_LEFT)
+    {
+        p += sprintf(p, "%s%*s", natural, (int)pad, "");
+    }
+    else if(flags & FMT_ZERO_PAD)
+    {
+        digits = natural;
+        if(value < 0) *p++ = *digits++;
+        for(i = 0; i < pad; i++) *p++ = '0';
+        p += sprintf(p, "%s", digits);
+    }
+    else
+    {
+        p += sprintf(p, "%*s%s", (int)pad, "", natural);
+    }
+    return (unsigned)(p - out);
+}
+
+/* Every decimals count; with 'full', every flag at the natural width, one
+ * short of it and a few fixed widths (else the natural output only) */
+static void Check_Value(long long value, int isUnsigned, int full)
+{
+    char expected[32];
+    char got[32];
+    unsigned widths[7];
+    unsigned decimals, w, flags, width, len, maxDecimals;
+    unsigned widthCount, maxFlags;
+
+    maxDecimals = isUnsigned ? 0 : FMT_MAX_DECIMALS;
+    maxFlags = full ? (FMT_ZERO_PAD | FMT_LEFT) : 0;
+    for(decimals = 0; decimals <= maxDecimals; decimals++)
+    {
+        widthCount = 0;
+        widths[widthCount++] = 0;
+        if(full)
+        {
+            widths[widthCount] = Check_Expected(expected, value, decimals, 0, 0);
+            widths[widthCount + 1] = widths[widthCount] - 1;
+            widthCount += 2;
+            widths[widthCount++] = 1;
+            widths[widthCount++] = 5;
+            widths[widthCount++] = 11;
+            widths[widthCount++] = FMT_BUFFER_SIZE - 1;
+        }
+
+        for(w = 0; w < widthCount; w++)
+        {
+            width = widths[w];
+            for(flags = 0; flags <= maxFlags; flags++)
+            {
+                Check_Expected(expected, value, decimals, width, flags);
+                memset(got, 'x', sizeof(got));
+                if(isUnsigned) len = Fmt_UInt(got, (uint32)value, (uint8)width, (uint8)flags);
+                else len = Fmt_Fixed(got, (sint32)value, (uint8)decimals, (uint8)width, (uint8)flags);
+
+                checks++;
+                if(strcmp(expected, got) != 0 || len != strlen(expected))
+                {
+                    Check_Fail(isUnsigned ? "Fmt_UInt" : "Fmt_Fixed", value, decimals, width, flags,
+                               expected, got);
+                }
+            }
+        }
+    }
+}
+
+static void Check_Div100(void)
+{
+    unsigned long long n;
+    unsigned long bad = 0;
+
+    for(n = 0; n <= 0xFFFFFFFFull; n++)
+    {
+        if(FMT_DIV100(n) != n / 100)
+        {
+            if(++bad <= CHECK_MAX_REPORTS) fprintf(stderr, "FMT_DIV100(%llu) = %lu\n", n, (unsigned long)FMT_DIV100(n));
+        }
+    }
+    failures += bad;
+    printf("FMT_DIV100: 4294967296 values, %lu wrong\n", bad);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long samples = 100000, i;
+    unsigned long long power;
+    long long v;
+    int opt, d;
+
+    while((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': samples = strtoul(optarg, NULL, 10); break;
+            case 's': rngState = strtoull(optarg, NULL, 10) | 1u; break;
+            default:
+                fprintf(stderr, "usage: %s [-n samples] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    /* 1. The divide every digit pair goes through */
+    Check_Div100();
+
+    /* 2. Dense small values, where lengths and decimals change most */
+    for(v = 0; v <= 1000000; v++)
+    {
+        Check_Value(v, 1, v <= 10000);
+        Check_Value(v, 0, v <= 10000);
+        Check_Value(-v, 0, v <= 10000);
+    }
+
+    /* 3. Both sides of every power of ten and the 32-bit limits */
+    for(power = 10; power <= 0xFFFFFFFFull; power *= 10)
+    {
+        for(d = -1; d <= 1; d++)
+        {
+            v = (long long)power + d;
+            Check_Value(v, 1, 1);
+            if(v <= 0x7FFFFFFF) Check_Value(v, 0, 1);
+            if(-v >= -0x80000000LL) Check_Value(-v, 0, 1);
+        }
+    }
+    Check_Value(0xFFFFFFFFLL, 1, 1);
+    Check_Value(0x7FFFFFFFLL, 0, 1);
+    Check_Value(-0x80000000LL, 0, 1);
+
+    /* 4. The rest of the range by sample */
+    for(i = 0; i < samples; i++)
+    {
+        v = (long long)(Check_Random() & 0xFFFFFFFFull);
+        Check_Value(v, 1, 1);
+        Check_Value((long long)(int)(unsigned)v, 0, 1);
+    }
+
+    printf("Fmt_UInt / Fmt_Fixed: %lu outputs, %lu total failures\n", checks, failures);
+    return (failures != 0) ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+/******************************************************************************
+ *
+ * Tool: Host Port
+ *
+ * File Name: host_port.c
+ *
+ * Description: Host implementation of delay.h and timebase.h plus the
+ * simulation clock
+ *
+ *******************************************************************************/
+
+#include <time.h>
+
+#include "host_port.h"
+#include "delay.h"
+#include "timebase.h"
+
+static int hostRealtime = 0;
+static uint64_t virtualUs = 0;
+static double wallStart = 0.0;
+
+double Host_WallSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void Host_SetRealtime(int realtime)
+{
+    hostRealtime = realtime;
+    Host_ResetClock();
+}
+
+int Host_IsRealtime(void)
+{
+    return hostRealtime;
+}
+
+void Host_ResetClock(void)
+{
+    virtualUs = 0;
+    wallStart = Host_WallSeconds();
+}
+
+uint64_t Host_NowUs(void)
+{
+    if(hostRealtime) return (uint64_t)((Host_WallSeconds() - wallStart) * 1e6);
+    return virtualUs;
+}
+
+void Host_AdvanceUs(uint64_t us)
+{
+    virtualUs += us;
+}
+
+void Delay_MS(unsigned long long n)
+{
+    struct timespec ts;
+
+    if(!hostRealtime)
+    {
+        virtualUs += n * 1000ULL;
+        return;
+    }
+    ts.tv_sec = (time_t)(n / 1000ULL);
+    ts.tv_nsec = (long)((n % 1000ULL) * 1000000L);
+    nanosleep(&ts, NULL);
+}
+
+void Time_Init(void)
+{
+}
+
+uint32 Time_NowMs(void)
+{
+    return (uint32)(Host_NowUs() / 1000ULL);
+}
+
+uint32 Time_NowUs(void)
+{
+    return (uint32)Host_NowUs();
+}
+
+/* Stands in for WFI: the next wake-up is at worst the next 1 ms tick */
+void Time_Sleep(void)
+{
+    uint64_t now = Host_NowUs();
+    uint64_t wait = 1000ULL - (now % 1000ULL);
+    struct timespec ts;
+
+    if(!hostRealtime)
+    {
+        virtualUs += wait;
+        return;
+    }
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)(wait * 1000ULL);
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,33 @@
+/******************************************************************************
+ *
+ * Tool: Host Port
+ *
+ * File Name: host_port.h
+ *
+ * Description: Linux replacements for the board-specific pieces of the
+ * firmware (delay.c, timebase.c) used by the host builds in this directory.
+ * Time is either virtual (Delay_MS and Time_Sleep only advance a counter,
+ * for as-fast-as-possible runs) or real (they sleep, for timing-accurate
+ * replay).
+ *
+ *******************************************************************************/
+
+#ifndef HOST_PORT_H_
+#define HOST_PORT_H_
+
+#include <stdint.h>
+
+void Host_SetRealtime(int realtime);
+int Host_IsRealtime(void);
+
+/* Microseconds since Host_ResetClock (virtual or wall clock) */
+uint64_t Host_NowUs(void);
+void Host_ResetClock(void);
+
+/* Advance virtual time (no effect in real-time mode) */
+void Host_AdvanceUs(uint64_t us);
+
+/* Wall-clock seconds, for throughput figures */
+double Host_WallSeconds(void);
+
+#endif /* HOST_PORT_H_ */
@@ -0,0 +1,122 @@
+/******************************************************************************
+ *
+ * Tool: I2C Timing Check (Linux host)
+ *
+ * File Name: i2c_timing.c
+ *
+ * Description: Evaluates the I2C1 TPR arithmetic from i2c.h for every
+ * supported core clock and bus mode: the SCL frequency actually produced,
+ * the nominal SCL low/high times against the I2C specification minimums,
+ * and what that means for the LCD (bytes and time per 16-char line).
+ * Exits with 1 if any configuration runs faster than requested or outside
+ * the specification, so it can gate a clock or rate change.
+ *
+ * Build:  gcc -O2 -I../OBD-II_Diagnostics -o i2c_timing i2c_timing.c
+ *
+ * Usage:  i2c_timing [-c clockHz] [-r sclHz]
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "i2c.h"
+#include "clock.h"
+#include "lcd.h"
+
+typedef struct {
+    const char *name;
+    unsigned long hz;
+    double minLowUs;            /* UM10204 tLOW / tHIGH minimums */
+    double minHighUs;
+} BusMode;
+
+static const BusMode busModes[] = {
+    { "Sm",  I2C_BAUDRATE_100K, 4.7,  4.0  },
+    { "Fm",  I2C_BAUDRATE_400K, 1.3,  0.6  },
+    { "Fm+", I2C_BAUDRATE_1M,   0.5,  0.26 },
+};
+
+static const unsigned long clocks[] = { CLOCK_80MHZ, CLOCK_50MHZ, CLOCK_40MHZ, CLOCK_16MHZ };
+
+#define COUNT(a)    (sizeof(a) / sizeof((a)[0]))
+
+/* Same padding rule as LCD_Init */
+static unsigned long lcdNibbleBytes(unsigned long byteUs)
+{
+    unsigned long n = (LCD_EXEC_US + 2 * byteUs - 1) / (2 * byteUs);
+    return (n < 2) ? 2 : n;
+}
+
+/* One line; returns 1 on a violation */
+static int check(unsigned long clk, const BusMode *mode)
+{
+    unsigned long tpr = I2C_TPR(clk, mode->hz);
+    unsigned long scl = I2C_SCL_HZ(clk, tpr);
+    double lowUs = I2C_SCL_LOW_CLOCKS(tpr) * 1e6 / clk;
+    double highUs = I2C_SCL_HIGH_CLOCKS(tpr) * 1e6 / clk;
+    unsigned long byteUs = (9 * 1000000UL + scl - 1) / scl;
+    unsigned long lineBytes = 17 * 2 * lcdNibbleBytes(byteUs);
+    double lineMs = (lineBytes + 1) * 9 * 1e3 / scl;
+    const char *verdict = "ok";
+    int bad = 0;
+
+    /* A mode's timing minimums apply to the mode the bus actually runs in */
+    if(scl > mode->hz) { verdict = "FAST"; bad = 1; }
+    else if(lowUs < mode->minLowUs || highUs < mode->minHighUs) { verdict = "SPEC"; bad = 1; }
+    else if(scl * 10 < mode->hz * 9) verdict = "slow";
+
+    printf("%4lu MHz  %-3s %7lu  %3lu  %7lu  %+6.1f%%  %5.2f  %5.2f  %4lu  %6.2f  %s\n",
+           clk / 1000000, mode->name, mode->hz, tpr, scl,
+           100.0 * ((double)scl - mode->hz) / mode->hz,
+           lowUs, highUs, lineBytes, lineMs, verdict);
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long clk = 0, rate = 0;
+    unsigned int c, m;
+    int opt, bad = 0, matched = 0;
+
+    while((opt = getopt(argc, argv, "c:r:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'c': clk = strtoul(optarg, NULL, 10); break;
+            case 'r': rate = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-c clockHz] [-r sclHz]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf(" clock   mode  target  TPR   actual   error   tLOW  tHIGH  line  line_ms\n");
+    for(c = 0; c < COUNT(clocks); c++)
+    {
+        if(clk != 0 && clk != clocks[c]) continue;
+        for(m = 0; m < COUNT(busModes); m++)
+        {
+            if(rate != 0 && rate != busModes[m].hz) continue;
+            bad |= check(clocks[c], &busModes[m]);
+            matched++;
+        }
+    }
+
+    /* A clock or rate outside the tables: check it as given */
+    if(matched == 0 && clk != 0 && rate != 0)
+    {
+        BusMode custom = busModes[0];
+        for(m = 0; m < COUNT(busModes); m++)
+        {
+            if(rate > busModes[m].hz / 2) custom = busModes[m];
+        }
+        custom.hz = rate;
+        bad |= check(clk, &custom);
+    }
+
+    printf("tLOW/tHIGH are nominal (us); rise time and clock stretching lengthen them.\n"
+           "line = bytes for a 16-char LCD line plus its cursor command.\n");
+    return bad;
+}
@@ -0,0 +1,538 @@
+/******************************************************************************
+ *
+ * Tool: Virtual J1979 ECU
+ *
+ * File Name: sim_ecu.c
+ *
+ * Description: Request handling, ISO-TP segmentation and the timed output
+ * queue feeding the simulated MCP2515
+ *
+ *******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "sim_ecu.h"
+#include "host_port.h"
+
+#define ECU_REQUEST_ID_FUNCTIONAL   0x7DF
+#define ECU_REQUEST_ID_BASE         0x7E0
+#define ECU_RESPONSE_ID_BASE        0x7E8
+#define ECU_N_BS_US                 1000000ULL  /* Wait for tester FC */
+#define ECU_FRAME_US                250         /* 8-byte frame at 500 kbps */
+#define ECU_PAD                     0xAA
+#define ECU_QUEUE_SIZE              512
+
+/* J1979 scaling, engineering = raw * scale + offset (independent of obd.c) */
+typedef struct {
+    uint8_t pid;
+    uint8_t length;
+    double scale;
+    double offset;
+} EcuFormat;
+
+static const EcuFormat ecuFormats[] = {
+    { 0x03, 2, 1.0,            0.0 },
+    { 0x04, 1, 100.0 / 255.0,  0.0 },
+    { 0x05, 1, 1.0,          -40.0 },
+    { 0x06, 1, 100.0 / 128.0, -100.0 },
+    { 0x07, 1, 100.0 / 128.0, -100.0 },
+    { 0x0B, 1, 1.0,            0.0 },
+    { 0x0C, 2, 0.25,           0.0 },
+    { 0x0D, 1, 1.0,            0.0 },
+    { 0x0E, 1, 0.5,          -64.0 },
+    { 0x0F, 1, 1.0,          -40.0 },
+    { 0x10, 2, 0.01,           0.0 },
+    { 0x11, 1, 100.0 / 255.0,  0.0 },
+    { 0x1F, 2, 1.0,            0.0 },
+    { 0x2F, 1, 100.0 / 255.0,  0.0 },
+    { 0x33, 1, 1.0,            0.0 },
+    { 0x42, 2, 0.001,          0.0 },
+    { 0x46, 1, 1.0,          -40.0 },
+    { 0x5C, 1, 1.0,          -40.0 },
+};
+
+#define ECU_FORMAT_COUNT    (sizeof(ecuFormats) / sizeof(ecuFormats[0]))
+
+typedef struct {
+    int active;
+    uint8_t index;
+    const SimEcu_Config *cfg;
+    uint32_t supported01[8];
+    uint32_t supported02[8];
+    double snapshot[SIMECU_MAX_SIGNALS];
+    double lastSent[256];
+    uint8_t lastValid[256];
+
+    /* Multi-frame response in progress */
+    uint8_t tx[SIMECU_MAX_RESPONSE];
+    uint16_t txLen;
+    uint16_t txOffset;
+    uint8_t txSeq;
+    int waitFc;
+    uint64_t fcDeadline;
+    uint64_t lastQueuedUs;
+
+    SimEcu_Stats stats;
+} Ecu;
+
+static Ecu ecus[SIMECU_MAX_ECUS];
+
+static SimCan_Frame queue[ECU_QUEUE_SIZE];
+static int queueCount = 0;
+
+static uint64_t rngState = 1;
+
+/*******************************************************************************
+ * Helpers
+ *******************************************************************************/
+
+static uint32_t Ecu_Random(void)
+{
+    /* xorshift64* */
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (uint32_t)((rngState * 2685821657736338717ULL) >> 32);
+}
+
+static int Ecu_Roll(uint16_t permille)
+{
+    return permille != 0 && (Ecu_Random() % 1000u) < permille;
+}
+
+static const EcuFormat *Ecu_Format(uint8_t pid)
+{
+    unsigned i;
+    for(i = 0; i < ECU_FORMAT_COUNT; i++)
+    {
+        if(ecuFormats[i].pid == pid) return &ecuFormats[i];
+    }
+    return NULL;
+}
+
+static const SimEcu_Signal *Ecu_Signal(const Ecu *ecu, uint8_t pid, int *slot)
+{
+    uint8_t i;
+    for(i = 0; i < ecu->cfg->signalCount; i++)
+    {
+        if(ecu->cfg->signals[i].pid == pid)
+        {
+            if(slot) *slot = i;
+            return &ecu->cfg->signals[i];
+        }
+    }
+    return NULL;
+}
+
+static double Ecu_Wave(const SimEcu_Signal *s, uint64_t nowUs)
+{
+    double phase = 0.0;
+
+    if(s->periodMs != 0) phase = fmod(nowUs / 1000.0, (double)s->periodMs) / s->periodMs;
+
+    switch(s->wave)
+    {
+        case SIMECU_WAVE_SINE:   return (s->min + s->max) / 2 + (s->max - s->min) / 2 * sin(2 * M_PI * phase);
+        case SIMECU_WAVE_RAMP:   return s->min + (s->max - s->min) * phase;
+        case SIMECU_WAVE_SQUARE: return (phase < 0.5) ? s->min : s->max;
+        case SIMECU_WAVE_NOISE:  return s->min + (s->max - s->min) * (Ecu_Random() / 4294967295.0);
+        default:                 return s->min;
+    }
+}
+
+static void Ecu_SetBit(uint32_t supported[8], uint8_t pid)
+{
+    pid--;
+    supported[pid >> 5] |= 1u << (31 - (pid & 0x1F));
+}
+
+static int Ecu_TestBit(const uint32_t supported[8], uint8_t pid)
+{
+    if(pid == 0) return 1;
+    pid--;
+    return (supported[pid >> 5] >> (31 - (pid & 0x1F))) & 1u;
+}
+
+/* Range PID 0x20*n is announced by the last bit of range n-1 */
+static void Ecu_ChainRanges(uint32_t supported[8])
+{
+    int r;
+    for(r = 7; r >= 1; r--)
+    {
+        if(supported[r] != 0) Ecu_SetBit(supported, (uint8_t)(r << 5));
+    }
+}
+
+/* Append pid's raw encoding of value; returns bytes written */
+static int Ecu_Encode(Ecu *ecu, uint8_t pid, double value, uint8_t *out)
+{
+    const EcuFormat *fmt = Ecu_Format(pid);
+    double maxRaw;
+    double raw;
+    uint32_t r;
+    int i;
+
+    if(fmt == NULL) return 0;
+    maxRaw = (fmt->length == 1) ? 255.0 : 65535.0;
+    raw = floor((value - fmt->offset) / fmt->scale + 0.5);
+    if(raw < 0) raw = 0;
+    if(raw > maxRaw) raw = maxRaw;
+    r = (uint32_t)raw;
+
+    for(i = 0; i < fmt->length; i++) out[i] = (uint8_t)(r >> (8 * (fmt->length - 1 - i)));
+    ecu->lastSent[pid] = r * fmt->scale + fmt->offset;
+    ecu->lastValid[pid] = 1;
+    return fmt->length;
+}
+
+/*******************************************************************************
+ * Output queue (time ordered)
+ *******************************************************************************/
+
+static void Ecu_Queue(Ecu *ecu, uint64_t timeUs, const uint8_t *data, uint8_t dlc)
+{
+    SimCan_Frame *f;
+    int pos;
+
+    if(timeUs < ecu->lastQueuedUs + ECU_FRAME_US) timeUs = ecu->lastQueuedUs + ECU_FRAME_US;
+    ecu->lastQueuedUs = timeUs;
+
+    if(Ecu_Roll(ecu->cfg->dropPermille) || queueCount == ECU_QUEUE_SIZE)
+    {
+        ecu->stats.framesDropped++;
+        return;
+    }
+
+    pos = queueCount++;
+    while(pos > 0 && queue[pos - 1].timeUs > timeUs)
+    {
+        queue[pos] = queue[pos - 1];
+        pos--;
+    }
+    f = &queue[pos];
+    f->timeUs = timeUs;
+    f->msg.id = ECU_RESPONSE_ID_BASE + ecu->index;
+    f->msg.idType = MCP2515_FRAME_STD;
+    f->msg.dlc = 8;
+    memset(f->msg.data, ECU_PAD, 8);
+    memcpy(f->msg.data, data, dlc);
+    ecu->stats.framesSent++;
+}
+
+static int Ecu_Source(void *ctx, SimCan_Frame *frame)
+{
+    (void)ctx;
+    if(queueCount == 0 || queue[0].timeUs > Host_NowUs()) return SIMMCP_SOURCE_WAIT;
+
+    *frame = queue[0];
+    queueCount--;
+    memmove(&queue[0], &queue[1], (size_t)queueCount * sizeof(queue[0]));
+    return 1;
+}
+
+/*******************************************************************************
+ * ISO-TP (server side)
+ *******************************************************************************/
+
+static void Ecu_Send(Ecu *ecu, const uint8_t *resp, uint16_t len, uint64_t timeUs)
+{
+    uint8_t frame[8];
+
+    if(ecu->waitFc) ecu->stats.fcTimeouts++;
+    ecu->waitFc = 0;
+
+    if(len <= 7)
+    {
+        frame[0] = (uint8_t)len;
+        memcpy(&frame[1], resp, len);
+        Ecu_Queue(ecu, timeUs, frame, (uint8_t)(len + 1));
+        return;
+    }
+
+    memcpy(ecu->tx, resp, len);
+    ecu->txLen = len;
+    frame[0] = (uint8_t)(0x10 | (len >> 8));
+    frame[1] = (uint8_t)len;
+    memcpy(&frame[2], resp, 6);
+    ecu->txOffset = 6;
+    ecu->txSeq = 1;
+    ecu->waitFc = 1;
+    ecu->fcDeadline = timeUs + ECU_N_BS_US;
+    Ecu_Queue(ecu, timeUs, frame, 8);
+}
+
+static void Ecu_FlowControl(Ecu *ecu, const MCP2515_Message *msg)
+{
+    uint64_t now = Host_NowUs();
+    uint8_t frame[8];
+    uint32_t stMinUs;
+    uint8_t bs, stMin, chunk, sent = 0;
+
+    if(!ecu->waitFc) return;
+    if(now > ecu->fcDeadline)
+    {
+        ecu->waitFc = 0;
+        ecu->stats.fcTimeouts++;
+        return;
+    }
+
+    switch(msg->data[0] & 0x0F)
+    {
+        case 0x01:  /* WAIT */
+            ecu->fcDeadline = now + ECU_N_BS_US;
+            return;
+        case 0x00:  /* CTS */
+            break;
+        default:    /* OVERFLOW / invalid */
+            ecu->waitFc = 0;
+            return;
+    }
+
+    bs = msg->data[1];
+    stMin = msg->data[2];
+    if(stMin <= 0x7F) stMinUs = stMin * 1000u;
+    else if(stMin >= 0xF1 && stMin <= 0xF9) stMinUs = (stMin - 0xF0) * 100u;
+    else stMinUs = 127000u;
+
+    ecu->waitFc = 0;
+    if(ecu->lastQueuedUs < now) ecu->lastQueuedUs = now;
+    while(ecu->txOffset < ecu->txLen)
+    {
+        chunk = (ecu->txLen - ecu->txOffset > 7) ? 7 : (uint8_t)(ecu->txLen - ecu->txOffset);
+        frame[0] = (uint8_t)(0x20 | (ecu->txSeq++ & 0x0F));
+        memcpy(&frame[1], &ecu->tx[ecu->txOffset], chunk);
+        ecu->txOffset += chunk;
+        Ecu_Queue(ecu, ecu->lastQueuedUs + stMinUs, frame, (uint8_t)(chunk + 1));
+
+        if(bs != 0 && ++sent == bs && ecu->txOffset < ecu->txLen)
+        {
+            ecu->waitFc = 1;
+            ecu->fcDeadline = ecu->lastQueuedUs + ECU_N_BS_US;
+            return;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Services
+ *******************************************************************************/
+
+/* Returns the positive response length, 0 for "no response" */
+static uint16_t Ecu_BuildResponse(Ecu *ecu, const uint8_t *req, uint8_t len, uint8_t *resp)
+{
+    uint64_t now = Host_NowUs();
+    const SimEcu_Signal *sig;
+    uint16_t pos = 1;
+    uint8_t pid, frame, i, r;
+    int slot = 0;
+
+    resp[0] = (uint8_t)(req[0] + 0x40);
+
+    if(req[0] == 0x01)
+    {
+        for(i = 1; i < len; i++)
+        {
+            pid = req[i];
+            if(pos + 5 > SIMECU_MAX_RESPONSE) break;
+            if((pid & 0x1F) == 0)
+            {
+                if(!Ecu_TestBit(ecu->supported01, pid)) continue;
+                resp[pos++] = pid;
+                for(r = 0; r < 4; r++) resp[pos++] = (uint8_t)(ecu->supported01[pid >> 5] >> (24 - 8 * r));
+            }
+            else if((sig = Ecu_Signal(ecu, pid, NULL)) != NULL)
+            {
+                resp[pos++] = pid;
+                pos += (uint16_t)Ecu_Encode(ecu, pid, Ecu_Wave(sig, now), &resp[pos]);
+            }
+        }
+    }
+    else if(req[0] == 0x02)
+    {
+        if(ecu->cfg->freezeDtc == 0) return 0;
+        for(i = 1; i + 1 < len; i += 2)
+        {
+            pid = req[i];
+            frame = req[i + 1];
+            if(frame != 0 || pos + 6 > SIMECU_MAX_RESPONSE) continue;
+            if((pid & 0x1F) == 0)
+            {
+                if(!Ecu_TestBit(ecu->supported02, pid)) continue;
+                resp[pos++] = pid;
+                resp[pos++] = frame;
+                for(r = 0; r < 4; r++) resp[pos++] = (uint8_t)(ecu->supported02[pid >> 5] >> (24 - 8 * r));
+            }
+            else if(pid == 0x02)
+            {
+                resp[pos++] = pid;
+                resp[pos++] = frame;
+                resp[pos++] = (uint8_t)(ecu->cfg->freezeDtc >> 8);
+                resp[pos++] = (uint8_t)ecu->cfg->freezeDtc;
+            }
+            else if(Ecu_Signal(ecu, pid, &slot) != NULL)
+            {
+                resp[pos++] = pid;
+                resp[pos++] = frame;
+                pos += (uint16_t)Ecu_Encode(ecu, pid, ecu->snapshot[slot], &resp[pos]);
+            }
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    return (pos > 1) ? pos : 0;
+}
+
+static void Ecu_Request(Ecu *ecu, const MCP2515_Message *msg, int functional)
+{
+    const SimEcu_Config *cfg = ecu->cfg;
+    uint8_t resp[SIMECU_MAX_RESPONSE];
+    uint8_t nrc[3];
+    uint64_t t;
+    uint16_t len;
+    uint8_t reqLen = msg->data[0] & 0x0F;
+
+    /* Only Single Frame requests (every J1979 request fits in one) */
+    if((msg->data[0] & 0xF0) != 0x00 || reqLen == 0 || reqLen >= msg->dlc) return;
+    ecu->stats.requests++;
+
+    t = Host_NowUs() + cfg->latencyMinUs;
+    if(cfg->latencyMaxUs > cfg->latencyMinUs) t += Ecu_Random() % (cfg->latencyMaxUs - cfg->latencyMinUs + 1);
+    if(Ecu_Roll(cfg->tailPermille)) t = Host_NowUs() + cfg->tailUs;
+
+    nrc[0] = 0x7F;
+    nrc[1] = msg->data[1];
+
+    len = Ecu_BuildResponse(ecu, &msg->data[1], reqLen, resp);
+    if(len == 0)
+    {
+        /* Functional requests for unsupported services/PIDs stay silent */
+        if(functional || msg->data[1] == 0x01 || msg->data[1] == 0x02) return;
+        nrc[2] = 0x11;
+        ecu->stats.negatives++;
+        Ecu_Send(ecu, nrc, 3, t);
+        return;
+    }
+
+    if(Ecu_Roll(cfg->negativePermille))
+    {
+        nrc[2] = cfg->negativeNrc;
+        ecu->stats.negatives++;
+        Ecu_Send(ecu, nrc, 3, t);
+        return;
+    }
+    if(Ecu_Roll(cfg->pendingPermille))
+    {
+        nrc[2] = 0x78;
+        ecu->stats.pendings++;
+        Ecu_Send(ecu, nrc, 3, t);
+        t += cfg->pendingUs;
+    }
+    ecu->stats.responses++;
+    Ecu_Send(ecu, resp, len, t);
+}
+
+static void Ecu_TesterFrame(void *ctx, const MCP2515_Message *msg)
+{
+    uint8_t i;
+    (void)ctx;
+
+    if(msg->idType != MCP2515_FRAME_STD) return;
+
+    if(msg->id == ECU_REQUEST_ID_FUNCTIONAL)
+    {
+        for(i = 0; i < SIMECU_MAX_ECUS; i++)
+        {
+            if(ecus[i].active) Ecu_Request(&ecus[i], msg, 1);
+        }
+        return;
+    }
+
+    if(msg->id >= ECU_REQUEST_ID_BASE && msg->id < ECU_REQUEST_ID_BASE + SIMECU_MAX_ECUS)
+    {
+        i = (uint8_t)(msg->id - ECU_REQUEST_ID_BASE);
+        if(!ecus[i].active) return;
+        if((msg->data[0] & 0xF0) == 0x30) Ecu_FlowControl(&ecus[i], msg);
+        else Ecu_Request(&ecus[i], msg, 0);
+    }
+}
+
+/*******************************************************************************
+ * API
+ *******************************************************************************/
+
+void SimEcu_Init(uint32_t seed)
+{
+    memset(ecus, 0, sizeof(ecus));
+    queueCount = 0;
+    rngState = ((uint64_t)seed << 1) | 1u;
+    SimMcp_SetSource(Ecu_Source, NULL);
+    SimMcp_SetTxHook(Ecu_TesterFrame, NULL);
+}
+
+int SimEcu_Add(uint8_t index, const SimEcu_Config *config)
+{
+    Ecu *ecu;
+    uint8_t i, pid;
+
+    if(index >= SIMECU_MAX_ECUS || config->signalCount > SIMECU_MAX_SIGNALS) return 0;
+
+    ecu = &ecus[index];
+    memset(ecu, 0, sizeof(*ecu));
+    ecu->active = 1;
+    ecu->index = index;
+    ecu->cfg = config;
+
+    for(i = 0; i < config->signalCount; i++)
+    {
+        pid = config->signals[i].pid;
+        if((pid & 0x1F) == 0 || Ecu_Format(pid) == NULL) return 0;
+        Ecu_SetBit(ecu->supported01, pid);
+        ecu->snapshot[i] = Ecu_Wave(&config->signals[i], Host_NowUs());
+    }
+    memcpy(ecu->supported02, ecu->supported01, sizeof(ecu->supported02));
+    Ecu_SetBit(ecu->supported02, 0x02);
+    Ecu_ChainRanges(ecu->supported01);
+    Ecu_ChainRanges(ecu->supported02);
+    return 1;
+}
+
+double SimEcu_SignalValue(uint8_t index, uint8_t pid)
+{
+    const SimEcu_Signal *sig;
+
+    if(index >= SIMECU_MAX_ECUS || !ecus[index].active) return 0.0;
+    sig = Ecu_Signal(&ecus[index], pid, NULL);
+    return (sig != NULL) ? Ecu_Wave(sig, Host_NowUs()) : 0.0;
+}
+
+int SimEcu_LastSent(uint8_t index, uint8_t pid, double *value)
+{
+    if(index >= SIMECU_MAX_ECUS || !ecus[index].active || !ecus[index].lastValid[pid]) return 0;
+    *value = ecus[index].lastSent[pid];
+    return 1;
+}
+
+void SimEcu_GetSupported(uint8_t index, uint8_t service, uint32_t supported[8])
+{
+    if(index >= SIMECU_MAX_ECUS || !ecus[index].active)
+    {
+        memset(supported, 0, 8 * sizeof(uint32_t));
+        return;
+    }
+    memcpy(supported, (service == 0x02) ? ecus[index].supported02 : ecus[index].supported01,
+           8 * sizeof(uint32_t));
+}
+
+uint16_t SimEcu_FreezeDtc(uint8_t index)
+{
+    if(index >= SIMECU_MAX_ECUS || !ecus[index].active) return 0;
+    return ecus[index].cfg->freezeDtc;
+}
+
+const SimEcu_Stats *SimEcu_GetStats(uint8_t index)
+{
+    return &ecus[index % SIMECU_MAX_ECUS].stats;
+}
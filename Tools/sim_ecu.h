@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ * Tool: Virtual J1979 ECU
+ *
+ * File Name: sim_ecu.h
+ *
+ * Description: Configurable OBD-II responders for host builds. The ECUs sit
+ * on the far side of the simulated MCP2515 (sim_mcp2515.h): tester frames
+ * arrive through the TX hook and responses are queued with a simulated
+ * latency, then handed to the MCP2515 model once the host clock reaches
+ * them. Each ECU answers on 0x7E8 + index and listens on 0x7DF and
+ * 0x7E0 + index.
+ *
+ * Supported: Mode 01 (multi-PID, supported-PID bitmaps built from the
+ * configured signals), Mode 02 frame 0 (snapshot taken at SimEcu_Init, PID 02
+ * = stored DTC), ISO-TP multi-frame responses honouring the tester's BS and
+ * STmin, NRC 0x11 for other services on physical requests.
+ * Fault injection (per mille, from a seeded PRNG): negative response,
+ * response-pending (0x78) before the real answer, dropped frames.
+ *
+ * Signal values are encoded with the ECU's own J1979 scaling table, kept
+ * independent of obd.c so decoder regressions show up as mismatches.
+ *
+ *******************************************************************************/
+
+#ifndef SIM_ECU_H_
+#define SIM_ECU_H_
+
+#include <stdint.h>
+
+#include "sim_mcp2515.h"
+
+#define SIMECU_MAX_ECUS         8
+#define SIMECU_MAX_SIGNALS      24
+#define SIMECU_MAX_RESPONSE     64
+
+typedef enum {
+    SIMECU_WAVE_CONST,
+    SIMECU_WAVE_SINE,
+    SIMECU_WAVE_RAMP,       /* min -> max, then jump back */
+    SIMECU_WAVE_SQUARE,
+    SIMECU_WAVE_NOISE       /* uniform in [min, max] on every read */
+} SimEcu_Wave;
+
+typedef struct {
+    uint8_t pid;
+    SimEcu_Wave wave;
+    double min;
+    double max;
+    uint32_t periodMs;
+} SimEcu_Signal;
+
+typedef struct {
+    const SimEcu_Signal *signals;
+    uint8_t signalCount;
+    uint16_t freezeDtc;             /* 0 = no freeze frame stored */
+
+    /* Response latency: uniform in [min, max], or tailUs with tailPermille */
+    uint32_t latencyMinUs;
+    uint32_t latencyMaxUs;
+    uint16_t tailPermille;
+    uint32_t tailUs;
+
+    /* Fault injection */
+    uint16_t negativePermille;      /* Answer with 7F <sid> negativeNrc */
+    uint8_t negativeNrc;
+    uint16_t pendingPermille;       /* 7F <sid> 78, real answer pendingUs later */
+    uint32_t pendingUs;
+    uint16_t dropPermille;          /* Any single frame the ECU sends */
+} SimEcu_Config;
+
+typedef struct {
+    unsigned long requests;         /* Requests addressed to this ECU */
+    unsigned long responses;        /* Positive responses started */
+    unsigned long negatives;
+    unsigned long pendings;
+    unsigned long framesSent;
+    unsigned long framesDropped;
+    unsigned long fcTimeouts;       /* Multi-frame answers abandoned (no FC) */
+} SimEcu_Stats;
+
+/* Reset all ECUs and attach them to the simulated MCP2515 (source + TX hook) */
+void SimEcu_Init(uint32_t seed);
+
+/* Add ECU number index (response ID 0x7E8 + index); config must stay valid */
+int SimEcu_Add(uint8_t index, const SimEcu_Config *config);
+
+/* Engineering value of a signal at the current host time */
+double SimEcu_SignalValue(uint8_t index, uint8_t pid);
+
+/* Engineering value of the last raw bytes this ECU sent for pid (the value
+ * the tester should decode); returns 0 if the PID was never sent */
+int SimEcu_LastSent(uint8_t index, uint8_t pid, double *value);
+
+/* Supported-PID bitmaps as the ECU reports them (service 0x01 or 0x02) */
+void SimEcu_GetSupported(uint8_t index, uint8_t service, uint32_t supported[8]);
+uint16_t SimEcu_FreezeDtc(uint8_t index);
+
+const SimEcu_Stats *SimEcu_GetStats(uint8_t index);
+
+#endif /* SIM_ECU_H_ */
@@ -0,0 +1,433 @@
+/******************************************************************************
+ *
+ * Tool: Simulated MCP2515
+ *
+ * File Name: sim_mcp2515.c
+ *
+ * Description: Register-file model of the MCP2515 behind the spi.h API
+ *
+ *******************************************************************************/
+
+#include <string.h>
+
+#include "sim_mcp2515.h"
+#include "host_port.h"
+#include "spi.h"
+
+#define REG_TXB0CTRL    0x30
+#define REG_RXB0SIDH    0x61
+#define REG_RXB1SIDH    0x71
+#define TXB_STRIDE      0x10
+#define TXREQ           0x08
+#define RXB0CTRL_BUKT   0x04
+#define INT_TX0         0x04
+
+typedef enum {
+    SPI_IDLE, SPI_CMD, SPI_ADDR, SPI_READ, SPI_WRITE,
+    SPI_MODIFY_MASK, SPI_MODIFY_DATA, SPI_STATUS, SPI_DONE
+} SpiState;
+
+static uint8 regs[128];
+static uint64_t rxTime[2];
+static uint64_t lastRxTime;
+
+static SpiState spiState = SPI_IDLE;
+static uint8 spiCmd;
+static uint8 spiPtr;
+static uint8 spiMask;
+static int rxReadBuffer = -1;
+
+static SimMcp_SourceFn sourceFn = 0;
+static void *sourceCtx = 0;
+static SimMcp_TxFn txFn = 0;
+static void *txCtx = 0;
+static int paced = 0;
+
+static SimCan_Frame pending;
+static int havePending = 0;
+static int sourceDone = 1;
+
+static SimMcp_Stats stats;
+
+/*******************************************************************************
+ * Registers
+ *******************************************************************************/
+
+static uint8 Sim_Mode(void)
+{
+    return regs[MCP2515_REG_CANSTAT] & 0xE0;
+}
+
+static void Sim_WriteReg(uint8 addr, uint8 value)
+{
+    addr &= 0x7F;
+
+    /* CANSTAT is read-only and mirrored at every xE address */
+    if((addr & 0x0F) == 0x0E) return;
+
+    if((addr & 0x0F) == 0x0F)
+    {
+        regs[MCP2515_REG_CANCTRL] = value;
+        regs[MCP2515_REG_CANSTAT] = (regs[MCP2515_REG_CANSTAT] & 0x1F) | (value & 0xE0);
+        return;
+    }
+    regs[addr] = value;
+}
+
+static uint8 Sim_ReadReg(uint8 addr)
+{
+    addr &= 0x7F;
+    if((addr & 0x0F) == 0x0E) return regs[MCP2515_REG_CANSTAT];
+    if((addr & 0x0F) == 0x0F) return regs[MCP2515_REG_CANCTRL];
+    return regs[addr];
+}
+
+static uint8 Sim_ReadStatus(void)
+{
+    uint8 intf = regs[MCP2515_REG_CANINTF];
+    uint8 status = intf & (MCP2515_INT_RX0 | MCP2515_INT_RX1);
+    uint8 n;
+
+    for(n = 0; n < 3; n++)
+    {
+        if(regs[REG_TXB0CTRL + n * TXB_STRIDE] & TXREQ) status |= (uint8)(0x04 << (2 * n));
+        if(intf & (INT_TX0 << n)) status |= (uint8)(0x08 << (2 * n));
+    }
+    return status;
+}
+
+static void Sim_ResetRegs(void)
+{
+    memset(regs, 0, sizeof(regs));
+    regs[MCP2515_REG_CANSTAT] = MCP2515_MODE_CONFIG;
+    regs[MCP2515_REG_CANCTRL] = 0x87;
+}
+
+/*******************************************************************************
+ * Frames
+ *******************************************************************************/
+
+static void Sim_StoreFrame(uint8 base, const MCP2515_Message *msg)
+{
+    uint8 i;
+
+    if(msg->idType == MCP2515_FRAME_EXT)
+    {
+        regs[base]     = (uint8)(msg->id >> 21);
+        regs[base + 1] = (uint8)(((msg->id >> 13) & 0xE0) | 0x08 | ((msg->id >> 16) & 0x03));
+        regs[base + 2] = (uint8)(msg->id >> 8);
+        regs[base + 3] = (uint8)msg->id;
+    }
+    else
+    {
+        regs[base]     = (uint8)(msg->id >> 3);
+        regs[base + 1] = (uint8)((msg->id & 0x07) << 5);
+        regs[base + 2] = 0;
+        regs[base + 3] = 0;
+    }
+    regs[base + 4] = msg->dlc & 0x0F;
+    for(i = 0; i < 8; i++) regs[base + 5 + i] = (i < msg->dlc) ? msg->data[i] : 0;
+}
+
+static void Sim_LoadFrame(uint8 base, MCP2515_Message *msg)
+{
+    uint8 sidh = regs[base], sidl = regs[base + 1];
+    uint8 i;
+
+    if(sidl & 0x08)
+    {
+        msg->id = ((uint32)sidh << 21) | ((uint32)(sidl & 0xE0) << 13) |
+                  ((uint32)(sidl & 0x03) << 16) | ((uint32)regs[base + 2] << 8) | regs[base + 3];
+        msg->idType = MCP2515_FRAME_EXT;
+    }
+    else
+    {
+        msg->id = ((uint32)sidh << 3) | (sidl >> 5);
+        msg->idType = MCP2515_FRAME_STD;
+    }
+    msg->dlc = regs[base + 4] & 0x0F;
+    if(msg->dlc > 8) msg->dlc = 8;
+    for(i = 0; i < msg->dlc; i++) msg->data[i] = regs[base + 5 + i];
+}
+
+/* Place one frame in RXB0, or RXB1 via rollover; returns 0 if both are full */
+static int Sim_Deliver(const MCP2515_Message *msg, uint64_t timeUs)
+{
+    uint8 *intf = &regs[MCP2515_REG_CANINTF];
+
+    if(!(*intf & MCP2515_INT_RX0))
+    {
+        Sim_StoreFrame(REG_RXB0SIDH, msg);
+        rxTime[0] = timeUs;
+        *intf |= MCP2515_INT_RX0;
+    }
+    else if((regs[MCP2515_REG_RXB0CTRL] & RXB0CTRL_BUKT) && !(*intf & MCP2515_INT_RX1))
+    {
+        Sim_StoreFrame(REG_RXB1SIDH, msg);
+        rxTime[1] = timeUs;
+        *intf |= MCP2515_INT_RX1;
+    }
+    else
+    {
+        regs[MCP2515_REG_EFLG] |= (regs[MCP2515_REG_RXB0CTRL] & RXB0CTRL_BUKT) ? MCP2515_EFLG_RX1OVR
+                                                                               : MCP2515_EFLG_RX0OVR;
+        *intf |= MCP2515_INT_ERR;
+        stats.overruns++;
+        return 0;
+    }
+    stats.framesDelivered++;
+    return 1;
+}
+
+static int Sim_BuffersFull(void)
+{
+    uint8 intf = regs[MCP2515_REG_CANINTF];
+    if(!(intf & MCP2515_INT_RX0)) return 0;
+    if((regs[MCP2515_REG_RXB0CTRL] & RXB0CTRL_BUKT) && !(intf & MCP2515_INT_RX1)) return 0;
+    return 1;
+}
+
+static int Sim_Listening(void)
+{
+    uint8 mode = Sim_Mode();
+    return mode == MCP2515_MODE_NORMAL || mode == MCP2515_MODE_LISTEN_ONLY;
+}
+
+/* Move due bus frames into the receive buffers; runs at every CS assert */
+static void Sim_PumpBus(void)
+{
+    uint64_t now = Host_NowUs();
+    int result;
+
+    for(;;)
+    {
+        if(!havePending)
+        {
+            if(sourceDone || sourceFn == 0) return;
+            result = sourceFn(sourceCtx, &pending);
+            if(result == SIMMCP_SOURCE_WAIT) return;
+            if(result == 0)
+            {
+                sourceDone = 1;
+                return;
+            }
+            havePending = 1;
+            stats.framesIn++;
+        }
+
+        if(paced)
+        {
+            if(pending.timeUs > now) return;
+        }
+        else if(Sim_BuffersFull())
+        {
+            return;
+        }
+
+        /* Off-bus modes (config, loopback, sleep) simply miss the frame */
+        if(Sim_Listening()) Sim_Deliver(&pending.msg, pending.timeUs);
+        havePending = 0;
+    }
+}
+
+static void Sim_RequestToSend(uint8 mask)
+{
+    MCP2515_Message msg;
+    uint8 n;
+
+    for(n = 0; n < 3; n++)
+    {
+        if(!(mask & (1u << n))) continue;
+        regs[REG_TXB0CTRL + n * TXB_STRIDE] |= TXREQ;
+
+        /* Listen-only and config never transmit: TXREQ stays pending */
+        if(Sim_Mode() != MCP2515_MODE_NORMAL && Sim_Mode() != MCP2515_MODE_LOOPBACK) continue;
+
+        Sim_LoadFrame((uint8)(REG_TXB0CTRL + n * TXB_STRIDE + 1), &msg);
+        regs[REG_TXB0CTRL + n * TXB_STRIDE] &= (uint8)~TXREQ;
+        regs[MCP2515_REG_CANINTF] |= (uint8)(INT_TX0 << n);
+        stats.framesTx++;
+
+        if(Sim_Mode() == MCP2515_MODE_LOOPBACK) Sim_Deliver(&msg, Host_NowUs());
+        else if(txFn != 0) txFn(txCtx, &msg);
+    }
+}
+
+/*******************************************************************************
+ * spi.h
+ *******************************************************************************/
+
+void SPI_Init(void)
+{
+    spiState = SPI_IDLE;
+}
+
+void SPI_CS_Assert(void)
+{
+    Sim_PumpBus();
+    spiState = SPI_CMD;
+    rxReadBuffer = -1;
+    stats.spiTransactions++;
+}
+
+void SPI_CS_Deassert(void)
+{
+    if(rxReadBuffer >= 0)
+    {
+        regs[MCP2515_REG_CANINTF] &= (uint8)~(MCP2515_INT_RX0 << rxReadBuffer);
+        lastRxTime = rxTime[rxReadBuffer];
+        stats.framesRead++;
+    }
+    if(spiState == SPI_CMD || spiState == SPI_IDLE)
+    {
+        spiState = SPI_IDLE;
+        return;
+    }
+    if(spiCmd == MCP2515_CMD_RESET) Sim_ResetRegs();
+    spiState = SPI_IDLE;
+}
+
+uint8 SPI_Transfer(uint8 data)
+{
+    uint8 out = 0xFF;
+
+    stats.spiBytes++;
+    switch(spiState)
+    {
+        case SPI_CMD:
+            spiCmd = data;
+            spiState = SPI_DONE;
+            if(data == MCP2515_CMD_READ || data == MCP2515_CMD_WRITE || data == MCP2515_CMD_BIT_MODIFY)
+            {
+                spiState = SPI_ADDR;
+            }
+            else if(data == MCP2515_CMD_READ_STATUS)
+            {
+                spiState = SPI_STATUS;
+            }
+            else if((data & 0xF9) == 0x90)
+            {
+                /* READ RX BUFFER: bit 2 selects RXB1, bit 1 starts at D0 */
+                rxReadBuffer = (data & 0x04) ? 1 : 0;
+                spiPtr = (uint8)((rxReadBuffer ? REG_RXB1SIDH : REG_RXB0SIDH) + ((data & 0x02) ? 5 : 0));
+                spiState = SPI_READ;
+            }
+            else if((data & 0xF8) == 0x40 && (data & 0x07) <= 5)
+            {
+                /* LOAD TX BUFFER: abc = buffer * 2 + (start at D0) */
+                spiPtr = (uint8)(REG_TXB0CTRL + ((data & 0x07) >> 1) * TXB_STRIDE + 1 + ((data & 0x01) ? 5 : 0));
+                spiState = SPI_WRITE;
+            }
+            else if((data & 0xF8) == 0x80)
+            {
+                Sim_RequestToSend(data & 0x07);
+            }
+            break;
+
+        case SPI_ADDR:
+            spiPtr = data & 0x7F;
+            if(spiCmd == MCP2515_CMD_READ) spiState = SPI_READ;
+            else if(spiCmd == MCP2515_CMD_WRITE) spiState = SPI_WRITE;
+            else spiState = SPI_MODIFY_MASK;
+            break;
+
+        case SPI_READ:
+            out = Sim_ReadReg(spiPtr);
+            spiPtr = (spiPtr + 1) & 0x7F;
+            break;
+
+        case SPI_WRITE:
+            Sim_WriteReg(spiPtr, data);
+            spiPtr = (spiPtr + 1) & 0x7F;
+            break;
+
+        case SPI_MODIFY_MASK:
+            spiMask = data;
+            spiState = SPI_MODIFY_DATA;
+            break;
+
+        case SPI_MODIFY_DATA:
+            Sim_WriteReg(spiPtr, (uint8)((Sim_ReadReg(spiPtr) & ~spiMask) | (data & spiMask)));
+            spiState = SPI_DONE;
+            break;
+
+        case SPI_STATUS:
+            out = Sim_ReadStatus();
+            break;
+
+        default:
+            break;
+    }
+    return out;
+}
+
+void SPI_Write(uint8 data)
+{
+    (void)SPI_Transfer(data);
+}
+
+uint8 SPI_Read(void)
+{
+    return SPI_Transfer(0xFF);
+}
+
+void SPI_TransferBuffer(const uint8 *txBuffer, uint8 *rxBuffer, uint16 length)
+{
+    uint16 i;
+    uint8 rx;
+
+    for(i = 0; i < length; i++)
+    {
+        rx = SPI_Transfer((txBuffer != NULL_PTR) ? txBuffer[i] : 0xFF);
+        if(rxBuffer != NULL_PTR) rxBuffer[i] = rx;
+    }
+}
+
+/*******************************************************************************
+ * Simulation control
+ *******************************************************************************/
+
+void SimMcp_Reset(void)
+{
+    Sim_ResetRegs();
+    memset(&stats, 0, sizeof(stats));
+    spiState = SPI_IDLE;
+    havePending = 0;
+    sourceDone = (sourceFn == 0);
+    lastRxTime = 0;
+}
+
+void SimMcp_SetSource(SimMcp_SourceFn source, void *ctx)
+{
+    sourceFn = source;
+    sourceCtx = ctx;
+    havePending = 0;
+    sourceDone = (source == 0);
+}
+
+void SimMcp_SetTxHook(SimMcp_TxFn hook, void *ctx)
+{
+    txFn = hook;
+    txCtx = ctx;
+}
+
+void SimMcp_SetPaced(int enable)
+{
+    paced = enable;
+}
+
+int SimMcp_Idle(void)
+{
+    return sourceDone && !havePending &&
+           !(regs[MCP2515_REG_CANINTF] & (MCP2515_INT_RX0 | MCP2515_INT_RX1));
+}
+
+uint64_t SimMcp_LastRxTimeUs(void)
+{
+    return lastRxTime;
+}
+
+const SimMcp_Stats *SimMcp_GetStats(void)
+{
+    return &stats;
+}
@@ -0,0 +1,65 @@
+/******************************************************************************
+ *
+ * Tool: Simulated MCP2515
+ *
+ * File Name: sim_mcp2515.h
+ *
+ * Description: SPI-level model of the MCP2515 for host builds. sim_mcp2515.c
+ * implements spi.h, so the unmodified mcp2515.c (and everything above it)
+ * talks to this model instead of the bit-banged bus on PA2-PA5.
+ *
+ * Modelled: RESET, READ, WRITE, BIT MODIFY, READ STATUS, READ RX BUFFER
+ * (with flag clear on CS release), LOAD TX BUFFER, RTS, REQOP -> OPMOD mode
+ * changes, RXB0 -> RXB1 rollover (BUKT) and RXnOVR overflow flags.
+ * Not modelled: acceptance masks/filters (everything is accepted, as with
+ * the firmware's stub ConfigureMask/ConfigureFilter), bit timing, errors.
+ *
+ * Bus frames come from a source callback (trace file, virtual ECU) and are
+ * delivered either when the host clock reaches their timestamp (paced) or
+ * as soon as a receive buffer is free (unpaced). Frames sent with RTS in
+ * Normal mode go to the TX hook; in Loopback mode they come straight back.
+ *
+ *******************************************************************************/
+
+#ifndef SIM_MCP2515_H_
+#define SIM_MCP2515_H_
+
+#include <stdint.h>
+
+#include "mcp2515.h"
+
+typedef struct {
+    uint64_t timeUs;            /* Bus time the frame completes */
+    MCP2515_Message msg;
+} SimCan_Frame;
+
+/* Returns 1 and fills *frame, 0 when the source is exhausted, or
+ * SIMMCP_SOURCE_WAIT when nothing is ready yet (asked again later) */
+#define SIMMCP_SOURCE_WAIT  (-1)
+typedef int (*SimMcp_SourceFn)(void *ctx, SimCan_Frame *frame);
+typedef void (*SimMcp_TxFn)(void *ctx, const MCP2515_Message *msg);
+
+typedef struct {
+    unsigned long framesIn;         /* Taken from the source */
+    unsigned long framesDelivered;  /* Placed in RXB0/RXB1 */
+    unsigned long framesRead;       /* Read out with READ RX BUFFER */
+    unsigned long overruns;         /* Both buffers full on arrival */
+    unsigned long framesTx;         /* Completed RTS requests */
+    unsigned long spiTransactions;  /* CS assert/deassert pairs */
+    unsigned long spiBytes;
+} SimMcp_Stats;
+
+void SimMcp_Reset(void);
+void SimMcp_SetSource(SimMcp_SourceFn source, void *ctx);
+void SimMcp_SetTxHook(SimMcp_TxFn hook, void *ctx);
+void SimMcp_SetPaced(int paced);
+
+/* Source exhausted and nothing left in the receive buffers */
+int SimMcp_Idle(void);
+
+/* Timestamp of the frame most recently read out of RXB0/RXB1 */
+uint64_t SimMcp_LastRxTimeUs(void);
+
+const SimMcp_Stats *SimMcp_GetStats(void);
+
+#endif /* SIM_MCP2515_H_ */
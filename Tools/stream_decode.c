@@ -0,0 +1,311 @@
+/******************************************************************************
+ *
+ * Tool: Stream Decoder (Linux host)
+ *
+ * File Name: stream_decode.c
+ *
+ * Description: Converts the binary UART0 stream (see stream.h) to candump
+ * log format or CSV. Reads a serial device (configured raw at the given
+ * baud rate), a capture file, or stdin ("-").
+ *
+ * Build:  gcc -O2 -I../OBD-II_Diagnostics -o stream_decode \
+ *             stream_decode.c ../OBD-II_Diagnostics/crc16.c \
+ *             ../OBD-II_Diagnostics/codec.c
+ *
+ * Usage:  stream_decode [-f candump|csv] [-b baud] [-i ifname] <device|file|->
+ *
+ *******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "stream.h"
+#include "crc16.h"
+#include "codec.h"
+
+typedef enum { FORMAT_CANDUMP, FORMAT_CSV } OutputFormat;
+
+static OutputFormat outFormat = FORMAT_CANDUMP;
+static const char *ifName = "can0";
+
+/* 32-bit device microseconds unwrapped into 64 bits */
+static unsigned long long tsHigh = 0;
+static unsigned int tsLast = 0;
+
+/* Packed-record decoder state, one channel per signal ID */
+static Codec_Channel packChannels[256];
+static unsigned long packedSamples = 0;
+
+static unsigned long recordsOk = 0;
+static unsigned long recordsLost = 0;
+static unsigned long crcErrors = 0;
+
+static unsigned int get16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+static unsigned int get32(const unsigned char *p)
+{
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+           ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long unwrapTimestamp(unsigned int ts)
+{
+    if(ts < tsLast) tsHigh += 0x100000000ULL;
+    tsLast = ts;
+    return tsHigh + ts;
+}
+
+static speed_t baudToSpeed(long baud)
+{
+    switch(baud)
+    {
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default:     return 0;
+    }
+}
+
+static int openInput(const char *path, long baud)
+{
+    struct termios tio;
+    int fd;
+
+    if(strcmp(path, "-") == 0) return STDIN_FILENO;
+
+    fd = open(path, O_RDONLY | O_NOCTTY);
+    if(fd < 0) { perror(path); return -1; }
+
+    if(isatty(fd))
+    {
+        if(baudToSpeed(baud) == 0) { fprintf(stderr, "unsupported baud %ld\n", baud); return -1; }
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baudToSpeed(baud));
+        cfsetospeed(&tio, baudToSpeed(baud));
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIFLUSH);
+    }
+    return fd;
+}
+
+static void printCan(unsigned long long ts, unsigned int id, int ext, const unsigned char *data, int dlc)
+{
+    int i;
+
+    if(outFormat == FORMAT_CANDUMP)
+    {
+        printf("(%llu.%06llu) %s ", ts / 1000000ULL, ts % 1000000ULL, ifName);
+        printf(ext ? "%08X#" : "%03X#", id);
+        for(i = 0; i < dlc; i++) printf("%02X", data[i]);
+        printf("\n");
+    }
+    else
+    {
+        printf("%llu.%06llu,can,%s,%X,%d,", ts / 1000000ULL, ts % 1000000ULL, ext ? "ext" : "std", id, dlc);
+        for(i = 0; i < dlc; i++) printf("%02X", data[i]);
+        printf("\n");
+    }
+}
+
+static void printPacked(unsigned int timeMs, unsigned int signal, int value)
+{
+    if(outFormat == FORMAT_CSV)
+    {
+        printf("%u.%03u,packed,%u,%d\n", timeMs / 1000u, timeMs % 1000u, signal, value);
+    }
+    else
+    {
+        printf("# (%u.%03u) signal 0x%02X = %d\n", timeMs / 1000u, timeMs % 1000u, signal, value);
+    }
+    packedSamples++;
+}
+
+/* Tokens until the end of the record; a malformed one ends it. Signals
+ * print nothing until their first key frame */
+static void handlePacked(const unsigned char *p, int len)
+{
+    Codec_Group group;
+    Codec_Channel *ch;
+    unsigned int base = get32(p);
+    int pos = 4, used, i;
+
+    while(pos + 1 < len)
+    {
+        ch = &packChannels[p[pos]];
+        used = Codec_Decode(ch, p + pos + 1, (uint16)(len - pos - 1), base, &group);
+        if(used == 0) return;
+
+        if(ch->synced)
+        {
+            for(i = 0; i < group.run; i++)
+            {
+                printPacked(group.runStartMs + (unsigned int)i * group.periodMs, p[pos], group.runValue);
+            }
+            printPacked(group.timeMs, p[pos], group.value);
+        }
+        pos += 1 + used;
+    }
+}
+
+static void handleRecord(unsigned char type, const unsigned char *p, int len)
+{
+    unsigned long long ts;
+    int value, decimals;
+
+    switch(type)
+    {
+        case STREAM_REC_CAN_STD:
+            if(len < 6 || len > 14) return;
+            printCan(unwrapTimestamp(get32(p)), get16(p + 4), 0, p + 6, len - 6);
+            break;
+
+        case STREAM_REC_CAN_EXT:
+            if(len < 8 || len > 16) return;
+            printCan(unwrapTimestamp(get32(p)), get32(p + 4) & 0x1FFFFFFF, 1, p + 8, len - 8);
+            break;
+
+        case STREAM_REC_SAMPLE:
+            if(len != 11) return;
+            ts = unwrapTimestamp(get32(p));
+            value = (int)get32(p + 6);
+            decimals = p[10];
+            if(outFormat == FORMAT_CSV)
+            {
+                printf("%llu.%06llu,sample,%u,%d,%d\n", ts / 1000000ULL, ts % 1000000ULL,
+                       get16(p + 4), value, decimals);
+            }
+            else
+            {
+                printf("# (%llu.%06llu) signal 0x%04X = %d e-%d\n", ts / 1000000ULL, ts % 1000000ULL,
+                       get16(p + 4), value, decimals);
+            }
+            break;
+
+        case STREAM_REC_STATS:
+            if(len != 22) return;
+            fprintf(stderr, "stats: frames=%u ringDrops=%u hwOverruns=%u fps=%u peak=%u load=%u.%u%% streamDrops=%u\n",
+                    get32(p), get32(p + 4), get32(p + 8), get16(p + 12), get16(p + 14),
+                    get16(p + 16) / 10, get16(p + 16) % 10, get32(p + 18));
+            break;
+
+        case STREAM_REC_TEXT:
+            if(len < 4) return;
+            ts = unwrapTimestamp(get32(p));
+            if(outFormat == FORMAT_CSV)
+            {
+                printf("%llu.%06llu,text,%.*s\n", ts / 1000000ULL, ts % 1000000ULL, len - 4, (const char *)(p + 4));
+            }
+            else
+            {
+                printf("# (%llu.%06llu) %.*s\n", ts / 1000000ULL, ts % 1000000ULL, len - 4, (const char *)(p + 4));
+            }
+            break;
+
+        case STREAM_REC_PACKED:
+            if(len < 4) return;
+            handlePacked(p, len);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Byte-wise record parser: hunt SYNC, collect header, payload and CRC */
+static unsigned char rec[STREAM_MAX_RECORD];
+static int recLen = 0;
+static int haveSeq = 0;
+static unsigned char lastSeq = 0;
+
+static void feedByte(unsigned char b)
+{
+    unsigned char pending[STREAM_MAX_RECORD];
+    unsigned int crc;
+    int payloadLen, count, j;
+
+    if(recLen == 0 && b != STREAM_SYNC) return;
+    rec[recLen++] = b;
+
+    if(recLen == STREAM_HEADER_LEN && rec[1] > STREAM_MAX_PAYLOAD)
+    {
+        recLen = 0;
+        return;
+    }
+    if(recLen < STREAM_HEADER_LEN) return;
+
+    payloadLen = rec[1];
+    if(recLen < STREAM_HEADER_LEN + payloadLen + STREAM_CRC_LEN) return;
+
+    crc = CRC16_Update(CRC16_INIT, &rec[1], (uint16)(STREAM_HEADER_LEN - 1 + payloadLen));
+    if(crc != get16(&rec[STREAM_HEADER_LEN + payloadLen]))
+    {
+        /* False SYNC or corruption: re-scan everything after this SYNC */
+        crcErrors++;
+        count = recLen - 1;
+        memcpy(pending, &rec[1], (size_t)count);
+        recLen = 0;
+        for(j = 0; j < count; j++) feedByte(pending[j]);
+        return;
+    }
+
+    if(haveSeq && (unsigned char)(rec[3] - lastSeq - 1) != 0)
+    {
+        /* Packed state went with the lost records: wait for key frames */
+        recordsLost += (unsigned char)(rec[3] - lastSeq - 1);
+        for(j = 0; j < 256; j++) Codec_Reset(&packChannels[j]);
+    }
+    lastSeq = rec[3];
+    haveSeq = 1;
+    recordsOk++;
+
+    handleRecord(rec[2], &rec[STREAM_HEADER_LEN], payloadLen);
+    recLen = 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char buf[4096];
+    long baud = 921600;
+    ssize_t n;
+    int fd, opt, i;
+
+    while((opt = getopt(argc, argv, "f:b:i:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'f': outFormat = (strcmp(optarg, "csv") == 0) ? FORMAT_CSV : FORMAT_CANDUMP; break;
+            case 'b': baud = strtol(optarg, NULL, 10); break;
+            case 'i': ifName = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-f candump|csv] [-b baud] [-i ifname] <device|file|->\n", argv[0]);
+                return 1;
+        }
+    }
+    if(optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-f candump|csv] [-b baud] [-i ifname] <device|file|->\n", argv[0]);
+        return 1;
+    }
+
+    fd = openInput(argv[optind], baud);
+    if(fd < 0) return 1;
+
+    if(outFormat == FORMAT_CSV) printf("time_s,kind,type_or_signal,id_or_value,dlc_or_decimals,data\n");
+
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        for(i = 0; i < n; i++) feedByte(buf[i]);
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "records=%lu lost=%lu crcErrors=%lu packedSamples=%lu\n", recordsOk, recordsLost, crcErrors, packedSamples);
+    if(fd != STDIN_FILENO) close(fd);
+    return 0;
+}
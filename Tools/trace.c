@@ -0,0 +1,240 @@
+/******************************************************************************
+ *
+ * Tool: CAN Trace Reader
+ *
+ * File Name: trace.c
+ *
+ * Description: candump / Vector ASC line parsers
+ *
+ *******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "trace.h"
+
+#define TRACE_MAX_TOKENS    32
+
+static int splitTokens(char *line, char **tok)
+{
+    int n = 0;
+    char *p = line;
+
+    while(*p && n < TRACE_MAX_TOKENS)
+    {
+        while(*p && isspace((unsigned char)*p)) p++;
+        if(!*p) break;
+        tok[n++] = p;
+        while(*p && !isspace((unsigned char)*p)) p++;
+        if(*p) *p++ = '\0';
+    }
+    return n;
+}
+
+static int isNumber(const char *s)
+{
+    if(!*s) return 0;
+    for(; *s; s++) if(!isdigit((unsigned char)*s) && *s != '.') return 0;
+    return 1;
+}
+
+static int parseHexByte(const char *s, uint8 *out)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 16);
+    if(end == s || v > 0xFF) return 0;
+    *out = (uint8)v;
+    return 1;
+}
+
+/* Hex ID with 3-digit = standard, longer = extended (candump convention) */
+static int parseCandumpId(const char *s, size_t len, MCP2515_Message *msg)
+{
+    char buf[16];
+    char *end;
+
+    if(len == 0 || len >= sizeof(buf)) return 0;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    msg->id = strtoul(buf, &end, 16);
+    if(*end) return 0;
+    msg->idType = (len > 3) ? MCP2515_FRAME_EXT : MCP2515_FRAME_STD;
+    if(msg->idType == MCP2515_FRAME_STD && msg->id > 0x7FF) return 0;
+    msg->id &= 0x1FFFFFFF;
+    return 1;
+}
+
+/* "(ts)" -> seconds */
+static int parseParenTime(const char *s, double *t)
+{
+    char *end;
+    if(*s != '(') return 0;
+    *t = strtod(s + 1, &end);
+    return end != s + 1 && *end == ')';
+}
+
+/* candump -l:  ID#DATA */
+static int parseCompact(const char *tok, MCP2515_Message *msg)
+{
+    const char *hash = strchr(tok, '#');
+    const char *p;
+    uint8 i = 0;
+    char byte[3];
+
+    if(hash == NULL || hash[1] == '#' || hash[1] == 'R') return 0;  /* FD / remote */
+    if(!parseCandumpId(tok, (size_t)(hash - tok), msg)) return 0;
+
+    for(p = hash + 1; p[0] && p[1]; p += 2)
+    {
+        if(p[0] == '.') { p--; continue; }      /* optional byte separators */
+        if(i == 8) return 0;
+        byte[0] = p[0]; byte[1] = p[1]; byte[2] = '\0';
+        if(!parseHexByte(byte, &msg->data[i])) return 0;
+        i++;
+    }
+    if(*p) return 0;
+    msg->dlc = i;
+    return 1;
+}
+
+/* candump:  ID  [n]  b0 b1 ... */
+static int parseSpaced(char **tok, int n, MCP2515_Message *msg)
+{
+    int dlc, i;
+
+    if(n < 2 || tok[1][0] != '[') return 0;
+    if(!parseCandumpId(tok[0], strlen(tok[0]), msg)) return 0;
+    dlc = atoi(tok[1] + 1);
+    if(dlc < 0 || dlc > 8 || n < 2 + dlc) return 0;
+    if(n > 2 && strcmp(tok[2], "remote") == 0) return 0;
+    for(i = 0; i < dlc; i++)
+    {
+        if(!parseHexByte(tok[2 + i], &msg->data[i])) return 0;
+    }
+    msg->dlc = (uint8)dlc;
+    return 1;
+}
+
+/* ASC:  ts chan ID[x] Rx|Tx d dlc b0 b1 ... */
+static int parseAsc(Trace_Reader *tr, char **tok, int n, MCP2515_Message *msg)
+{
+    size_t len = strlen(tok[2]);
+    char *end;
+    int dlc, i;
+
+    if(n < 6 || tok[4][0] != 'd') return 0;
+    msg->idType = MCP2515_FRAME_STD;
+    if(len > 1 && (tok[2][len - 1] == 'x' || tok[2][len - 1] == 'X'))
+    {
+        msg->idType = MCP2515_FRAME_EXT;
+        tok[2][len - 1] = '\0';
+    }
+    msg->id = strtoul(tok[2], &end, tr->ascDecimal ? 10 : 16);
+    if(*end) return 0;
+    if(msg->idType == MCP2515_FRAME_STD && msg->id > 0x7FF) return 0;
+    msg->id &= 0x1FFFFFFF;
+
+    dlc = (int)strtol(tok[5], &end, 16);
+    if(*end || dlc < 0 || dlc > 8 || n < 6 + dlc) return 0;
+    for(i = 0; i < dlc; i++)
+    {
+        if(!parseHexByte(tok[6 + i], &msg->data[i])) return 0;
+    }
+    msg->dlc = (uint8)dlc;
+    return 1;
+}
+
+int Trace_Open(Trace_Reader *tr, const char *path)
+{
+    memset(tr, 0, sizeof(*tr));
+    tr->path = path;
+    tr->fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    return tr->fp != NULL;
+}
+
+void Trace_Close(Trace_Reader *tr)
+{
+    if(tr->fp != NULL && tr->fp != stdin) fclose(tr->fp);
+    tr->fp = NULL;
+}
+
+uint64_t Trace_LastTimeUs(const Trace_Reader *tr)
+{
+    if(!tr->haveT0) return tr->offsetUs;
+    return tr->offsetUs + (uint64_t)((tr->tLast - tr->t0) * 1e6 + 0.5);
+}
+
+int Trace_Next(void *reader, SimCan_Frame *frame)
+{
+    Trace_Reader *tr = (Trace_Reader *)reader;
+    char line[512];
+    char *tok[TRACE_MAX_TOKENS];
+    double t;
+    int n, ok, haveTime;
+
+    while(fgets(line, sizeof(line), tr->fp) != NULL)
+    {
+        tr->line++;
+        n = splitTokens(line, tok);
+        if(n == 0 || tok[0][0] == '#' || strncmp(tok[0], "//", 2) == 0) continue;
+
+        /* ASC header */
+        if(strcmp(tok[0], "base") == 0)
+        {
+            tr->ascDecimal = (n > 1 && strcmp(tok[1], "dec") == 0);
+            tr->ascRelative = (n > 3 && strcmp(tok[3], "relative") == 0);
+            continue;
+        }
+
+        memset(&frame->msg, 0, sizeof(frame->msg));
+        ok = 0;
+        haveTime = 0;
+        t = 0.0;
+
+        if(parseParenTime(tok[0], &t))
+        {
+            haveTime = 1;
+            if(n >= 3 && strchr(tok[2], '#') != NULL) ok = parseCompact(tok[2], &frame->msg);
+            else if(n >= 3) ok = parseSpaced(&tok[2], n - 2, &frame->msg);
+        }
+        else if(n >= 3 && isNumber(tok[0]) && strchr(tok[0], '.') != NULL)
+        {
+            /* ASC body; non-frame events (Start of measurement, ...) are ignored */
+            if(!isNumber(tok[1])) continue;
+            if(strcmp(tok[2], "ErrorFrame") == 0) { tr->skipped++; continue; }
+            t = strtod(tok[0], NULL);
+            if(tr->ascRelative) t += tr->haveT0 ? tr->tLast : 0.0;
+            haveTime = 1;
+            ok = parseAsc(tr, tok, n, &frame->msg);
+        }
+        else if(n >= 3 && tok[2][0] == '[')
+        {
+            ok = parseSpaced(&tok[1], n - 1, &frame->msg);
+        }
+        else if(strcmp(tok[0], "date") == 0 || strcmp(tok[0], "Begin") == 0 ||
+                strcmp(tok[0], "End") == 0 || strcmp(tok[0], "internal") == 0 ||
+                strcmp(tok[0], "no") == 0)
+        {
+            continue;
+        }
+
+        if(!ok)
+        {
+            tr->skipped++;
+            continue;
+        }
+
+        if(!haveTime) t = tr->haveT0 ? tr->tLast : 0.0;
+        if(!tr->haveT0)
+        {
+            tr->t0 = t;
+            tr->haveT0 = 1;
+        }
+        tr->tLast = t;
+        tr->frames++;
+        frame->timeUs = Trace_LastTimeUs(tr);
+        return 1;
+    }
+    return 0;
+}
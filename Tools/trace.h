@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ * Tool: CAN Trace Reader
+ *
+ * File Name: trace.h
+ *
+ * Description: Streaming reader for recorded CAN traces, one frame at a
+ * time so multi-gigabyte logs replay in constant memory. Formats are
+ * detected per line:
+ *
+ *   candump -l     (1436509052.249713) can0 7E8#0641000BE0000000
+ *   candump        (1436509052.249713)  can0  7E8   [8]  06 41 00 ...
+ *                  can0  18DAF110   [8]  06 41 00 ...   (no timestamp)
+ *   Vector ASC     0.012345 1  7E8   Rx   d 8 06 41 00 ...
+ *                  (extended IDs end in 'x'; "base dec" and
+ *                   "timestamps relative" headers are honoured)
+ *
+ * Timestamps are rebased so the first frame is at t = 0. CAN FD, remote
+ * and error frames are skipped and counted.
+ *
+ *******************************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+
+#include "sim_mcp2515.h"
+
+typedef struct {
+    FILE *fp;
+    const char *path;
+    unsigned long line;
+    unsigned long frames;
+    unsigned long skipped;      /* Unparseable, FD, RTR or error frames */
+    double t0;                  /* First timestamp, seconds */
+    double tLast;
+    int haveT0;
+    int ascDecimal;             /* "base dec" */
+    int ascRelative;            /* "timestamps relative" */
+    uint64_t offsetUs;          /* Added to every frame (looped replays) */
+} Trace_Reader;
+
+int Trace_Open(Trace_Reader *tr, const char *path);
+void Trace_Close(Trace_Reader *tr);
+
+/* Next frame, or 0 at end of file; usable directly as a SimMcp_SourceFn */
+int Trace_Next(void *reader, SimCan_Frame *frame);
+
+/* Timestamp of the last frame returned, relative to the first one */
+uint64_t Trace_LastTimeUs(const Trace_Reader *tr);
+
+#endif /* TRACE_H_ */